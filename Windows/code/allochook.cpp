@@ -0,0 +1,136 @@
+﻿#include "allochook.h"
+
+// ASan / TSan 自己接管了 malloc，与这里的替换冲突，开启时自动关闭计数
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#undef PLAYER_ALLOC_HOOK
+#endif
+
+#if defined(PLAYER_ALLOC_HOOK) && defined(__GLIBC__) && !defined(_WIN32)
+#define ALLOC_HOOK_ENABLED 1
+#include <cstddef>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+struct AllocCounters {
+    std::atomic<int64_t> own{ 0 };      // 本仓库代码的分配
+    std::atomic<int64_t> library{ 0 };  // LibraryAllocScope 内的分配
+    int library_depth = 0;              // LibraryAllocScope 嵌套层数（只有本线程访问）
+};
+
+// 常量初始化的线程局部变量：访问时不会触发分配，可以在 malloc 内部使用
+thread_local AllocCounters t_allocs;
+
+inline void CountAlloc()
+{
+    // 只有本线程写，采样线程读：relaxed 的 load + store 即可，不需要原子加
+    std::atomic<int64_t>& counter = t_allocs.library_depth > 0 ? t_allocs.library : t_allocs.own;
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+};
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    CountAlloc();
+    return __libc_malloc(size);
+};
+
+void* calloc(size_t count, size_t size)
+{
+    CountAlloc();
+    return __libc_calloc(count, size);
+};
+
+void* realloc(void* ptr, size_t size)
+{
+    CountAlloc();
+    return __libc_realloc(ptr, size);
+};
+
+void* memalign(size_t alignment, size_t size)
+{
+    CountAlloc();
+    return __libc_memalign(alignment, size);
+};
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    CountAlloc();
+    return __libc_memalign(alignment, size);
+};
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    // 与 glibc 相同的参数检查：对齐必须是 sizeof(void*) 的 2 的幂次倍
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return 22;  // EINVAL
+
+    CountAlloc();
+    void* mem = __libc_memalign(alignment, size);
+    if (!mem)
+        return 12;  // ENOMEM
+    *ptr = mem;
+    return 0;
+};
+
+} // extern "C"
+#endif
+
+bool HeapAllocHookEnabled()
+{
+#ifdef ALLOC_HOOK_ENABLED
+    return true;
+#else
+    return false;
+#endif
+};
+
+int64_t ThreadHeapAllocs()
+{
+#ifdef ALLOC_HOOK_ENABLED
+    return t_allocs.own.load(std::memory_order_relaxed);
+#else
+    return -1;
+#endif
+};
+
+const std::atomic<int64_t>* ThreadHeapAllocCounter()
+{
+#ifdef ALLOC_HOOK_ENABLED
+    return &t_allocs.own;
+#else
+    return nullptr;
+#endif
+};
+
+const std::atomic<int64_t>* ThreadLibraryAllocCounter()
+{
+#ifdef ALLOC_HOOK_ENABLED
+    return &t_allocs.library;
+#else
+    return nullptr;
+#endif
+};
+
+void EnterLibraryAlloc()
+{
+#ifdef ALLOC_HOOK_ENABLED
+    t_allocs.library_depth++;
+#endif
+};
+
+void LeaveLibraryAlloc()
+{
+#ifdef ALLOC_HOOK_ENABLED
+    t_allocs.library_depth--;
+#endif
+};
@@ -0,0 +1,65 @@
+﻿#ifndef ALLOCHOOK_H
+#define ALLOCHOOK_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * 堆分配计数（性能测试构建用）
+ *
+ * 定义 PLAYER_ALLOC_HOOK 编译时，glibc 平台上替换 malloc / calloc / realloc / memalign 系列函数，
+ * 转调 glibc 内部实现，同时给调用线程的计数器加一（线程局部变量，无锁、无共享缓存行）。
+ * operator new 与 FFmpeg 的 av_malloc 最终都走这里，所以能统计到所有堆分配。
+ * 用于验证稳定播放时本仓库代码每帧零分配（--bench --assert-no-alloc）。
+ *
+ * 默认不替换：正式构建的每次分配不经过这里。Windows 没有等价的替换方式，
+ * ASan / TSan 构建自己接管 malloc，这两种情况下即使定义了也不启用，接口返回 -1 / nullptr。
+ *
+ * 已知例外：下列 FFmpeg 调用每帧 / 每包必然在库内部分配，用 LibraryAllocScope 包住，
+ * 单独计数（lib/frm），不算作本仓库代码的分配：
+ *   - av_read_frame：包负载与 AVBufferRef
+ *   - avcodec_send_packet / avcodec_receive_frame：解码器内部的包引用、输出帧的
+ *     AVBufferPool 缓冲区引用（av_buffer_pool_get 每次分配一个 AVBufferRef）和 side data
+ *   - av_buffer_pool_get / av_buffer_create：本仓库缓冲池（FrameConverter、PacketArena）交出缓冲区时的 AVBufferRef
+ *   - av_frame_ref：帧订阅者（FrameTap）取得的每个平面引用
+ *   - av_buffersrc_add_frame / av_buffersink_get_frame：音频倍速滤镜图（atempo）内部的帧
+ */
+
+/**
+ * @brief 当前构建是否启用了分配计数
+ */
+bool HeapAllocHookEnabled();
+
+/**
+ * @brief 调用线程累计的堆分配次数（不含 LibraryAllocScope 内的分配），未启用时返回 -1
+ */
+int64_t ThreadHeapAllocs();
+
+/**
+ * @brief 调用线程的分配计数器，供其他线程采样（线程退出后失效），未启用时返回 nullptr
+ */
+const std::atomic<int64_t>* ThreadHeapAllocCounter();
+
+/**
+ * @brief 调用线程在 LibraryAllocScope 内的分配计数器（已知的库内部分配），未启用时返回 nullptr
+ */
+const std::atomic<int64_t>* ThreadLibraryAllocCounter();
+
+// LibraryAllocScope 的实现（未启用计数时为空函数）
+void EnterLibraryAlloc();
+void LeaveLibraryAlloc();
+
+/**
+ * @brief 作用域内调用线程的分配记为库内部分配（见上面的已知例外），可以嵌套
+ */
+class LibraryAllocScope
+{
+public:
+    LibraryAllocScope() { EnterLibraryAlloc(); };
+    ~LibraryAllocScope() { LeaveLibraryAlloc(); };
+
+    LibraryAllocScope(const LibraryAllocScope&) = delete;
+    LibraryAllocScope& operator=(const LibraryAllocScope&) = delete;
+};
+
+#endif // ALLOCHOOK_H
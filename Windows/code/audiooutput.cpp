@@ -1,4 +1,8 @@
 ﻿#include "audiooutput.h"
+#include "allochook.h"
+#include "threadutil.h"
+#include "tracing.h"
+#include "syncprobe.h"
 #include <cstring>
 #include <cstdio>
 
@@ -12,6 +16,15 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
 {
     AudioOutput* audio_output = (AudioOutput*)userdata;
 
+    SetCurrentThreadName("sdl audio");
+    TraceScope trace("audio callback");
+
+    // 同步精度测试：本次写入的数据在设备当前缓冲播放完后才开始播放
+    const int stream_len = len;
+    SyncProbe& probe = SyncProbe::Instance();
+    double play_start = probe.Enabled() ?
+        audio_output->avsync_->SourceNowSec() + audio_output->device_latency_ : 0.0;
+
     // 循环填充，直到满足 SDL 要求的长度
     while (len > 0) {
         // ---- 暂停时输出静音 ----
@@ -30,22 +43,36 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
             AVFrame* filt_frame = nullptr;
 
             if (frame) {
-                // 送入输入滤镜（原始音频帧）
-                if (av_buffersrc_add_frame(audio_output->abuffer_ctx_, frame) < 0) {
-                    // 添加失败，释放帧并继续
-                    av_frame_free(&frame);
+                TraceScope trace_filter("audio filter");
+                audio_output->starved_ = false;
+
+                // 送入输入滤镜（原始音频帧）；滤镜图内部每帧分配，是已知例外（见 allochook.h）
+                int filter_ret;
+                {
+                    LibraryAllocScope lib;
+                    filter_ret = av_buffersrc_add_frame(audio_output->abuffer_ctx_, frame);
+                }
+                if (filter_ret < 0) {
+                    // 添加失败，归还帧并继续
+                    audio_output->frame_queue_->Recycle(frame);
                     continue;
                 }
-                // 立即释放原始帧，滤镜内部已复制数据
-                av_frame_free(&frame);
+                // 立即归还原始帧，滤镜内部已引用数据
+                audio_output->frame_queue_->Recycle(frame);
 
                 // 从滤镜输出端取出处理后的帧（倍速处理）
-                filt_frame = av_frame_alloc();
-                if (av_buffersink_get_frame(audio_output->abuffersink_ctx_, filt_frame) < 0) {
+                filt_frame = audio_output->filt_frame_;
+                {
+                    LibraryAllocScope lib;
+                    filter_ret = av_buffersink_get_frame(audio_output->abuffersink_ctx_, filt_frame);
+                }
+                if (filter_ret < 0) {
                     // 获取失败，可能是滤镜内部缓冲不足
-                    av_frame_free(&filt_frame);
+                    av_frame_unref(filt_frame);
                     audio_output->audio_buf_ = nullptr;
                     audio_output->audio_buf_size = 512;  // 设置默认静音长度
+                    audio_output->silence_insertions_->Add(1);
+                    audio_output->silence_bytes_->Add(512);
                     continue;
                 }
 
@@ -77,7 +104,7 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
                         printf("swr_init failed\n");
                         if (audio_output->swr_ctx_)
                             swr_free(&audio_output->swr_ctx_);
-                        av_frame_free(&filt_frame);
+                        av_frame_unref(filt_frame);
                         return;  // 重采样初始化失败，直接返回
                     }
                 }
@@ -103,7 +130,7 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
                     );
 
                     if (out_bytes < 0) {
-                        av_frame_free(&filt_frame);
+                        av_frame_unref(filt_frame);
                         return;
                     }
 
@@ -113,12 +140,16 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
                         out_bytes);
 
                     // 执行重采样
-                    int len2 = swr_convert(audio_output->swr_ctx_,
-                        out, out_samples,      // 输出缓冲区
-                        in, filt_frame->nb_samples); // 输入样本数
+                    int len2 = 0;
+                    {
+                        TraceScope trace_resample("audio resample");
+                        len2 = swr_convert(audio_output->swr_ctx_,
+                            out, out_samples,      // 输出缓冲区
+                            in, filt_frame->nb_samples); // 输入样本数
+                    }
 
                     if (len2 < 0) {
-                        av_frame_free(&filt_frame);
+                        av_frame_unref(filt_frame);
                         return;
                     }
 
@@ -130,6 +161,7 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
                         audio_output->dst_tgt_.fmt, 0);
 
                     audio_output->audio_buf_ = audio_output->audio_buf1_;
+                    audio_output->samples_played_ += len2;
                 }
                 else {
                     // 无需重采样，直接复制 PCM 数据
@@ -150,15 +182,23 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
                     memcpy(audio_output->audio_buf_,
                         filt_frame->extended_data[0],
                         out_bytes);
+                    audio_output->samples_played_ += filt_frame->nb_samples;
                 }
 
-                av_frame_free(&filt_frame);
+                av_frame_unref(filt_frame);
             }
             else {
                 // ---- 无帧时输出静音 ----
                 // 队列为空，可能是解码较慢或文件结束
                 audio_output->audio_buf_ = nullptr;
                 audio_output->audio_buf_size = 512;  // 静音数据长度
+                // 连续为空只算一次欠载（文件播完后持续输出静音不计入）
+                if (!audio_output->starved_) {
+                    audio_output->underruns_->Add(1);
+                    audio_output->starved_ = true;
+                }
+                audio_output->silence_insertions_->Add(1);
+                audio_output->silence_bytes_->Add(512);
             }
         }
 
@@ -171,6 +211,14 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
         else
             memcpy(stream, audio_output->audio_buf_ + audio_output->audio_buf_index, len3);
 
+        if (audio_output->audio_buf_ && probe.Enabled()) {
+            int channels = audio_output->dst_tgt_.ch_layout.nb_channels;
+            double period = 1.0 / audio_output->dst_tgt_.freq;
+            probe.OnAudioS16((const int16_t*)(audio_output->audio_buf_ + audio_output->audio_buf_index),
+                len3 / (2 * channels), channels,
+                play_start + (stream_len - len) / (2 * channels) * period, period);
+        }
+
         // 更新指针和剩余长度
         len -= len3;
         stream += len3;
@@ -180,6 +228,9 @@ static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
     // ---- 更新音频时钟用于同步 ----
     // 每次回调都更新时钟，确保视频同步准确
     audio_output->avsync_->SetClock(audio_output->pts);
+
+    // 回调线程 CPU 时间（每个回调周期采样一次）
+    audio_output->cpu_time_us_ = CurrentThreadCpuTimeUs();
 };
 
 // ============================================================================
@@ -193,10 +244,16 @@ AudioOutput::AudioOutput(AVSync* avsync, const AudioParams& audio_params,
     frame_queue_(frame_queue),
     time_base_(time_base)
 {
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    underruns_ = registry.GetCounter("audio.underruns");
+    silence_insertions_ = registry.GetCounter("audio.silence_insertions");
+    silence_bytes_ = registry.GetCounter("audio.silence_bytes");
+
     swr_ctx_ = nullptr;
 
     audio_buf1_ = nullptr;
     audio_buf1_size = 0;
+    filt_frame_ = av_frame_alloc();
 
     audio_buf_ = nullptr;
     audio_buf_size = 0;
@@ -214,6 +271,9 @@ AudioOutput::AudioOutput(AVSync* avsync, const AudioParams& audio_params,
 
 AudioOutput::~AudioOutput()
 {
+    // 先关闭设备，确保回调不再访问下面释放的资源
+    DeInit();
+
     if (swr_ctx_) {
         swr_free(&swr_ctx_);
         swr_ctx_ = nullptr;
@@ -224,13 +284,9 @@ AudioOutput::~AudioOutput()
         audio_buf1_ = nullptr;
         audio_buf1_size = 0;
     }
+    av_frame_free(&filt_frame_);
 
-    if (filter_graph_) {
-        avfilter_graph_free(&filter_graph_);
-        filter_graph_ = nullptr;
-    }
-
-    DeInit();
+    FreeFilterGraph();
 };
 
 // ============================================================================
@@ -245,7 +301,105 @@ int AudioOutput::Init()
         return -1;
     }
 
-    // 2. 配置 SDL 音频参数
+    // 2. 打开 SDL 音频设备
+    if (OpenDevice() < 0) {
+        return -1;
+    }
+
+    // 3. 构建滤镜图（abuffer -> atempo -> abuffersink）
+    if (BuildFilterGraph() < 0) {
+        return -1;
+    }
+
+    // 4. 启动音频播放（SDL_PauseAudio(0) 开始播放）
+    SDL_PauseAudio(0);
+
+    return 0;
+};
+
+int AudioOutput::InitOffline(float speed)
+{
+    // 与 OpenDevice 设置的输出参数一致
+    av_channel_layout_default(&dst_tgt_.ch_layout, 2);
+    dst_tgt_.fmt = AV_SAMPLE_FMT_S16;
+    dst_tgt_.freq = src_tgt_.freq;
+    original_freq_ = src_tgt_.freq;
+    device_latency_ = (double)AUDIO_DEVICE_SAMPLES / src_tgt_.freq;
+    speed_ = speed;
+
+    return BuildFilterGraph();
+};
+
+void AudioOutput::FillBuffer(Uint8* stream, int len)
+{
+    sdl_audio_callback(this, stream, len);
+};
+
+int AudioOutput::DeInit()
+{
+    if (device_opened_) {
+        SDL_PauseAudio(1);
+        SDL_CloseAudio();
+        device_opened_ = false;
+    }
+    return 0;
+};
+
+/**
+ * @brief 切换到新的音频流（播放下一个文件时调用）
+ *
+ * 只有输出采样率变化时才关闭并重新打开 SDL 设备；
+ * 滤镜图总是重建，因为 atempo 内部缓存着上一个文件的尾部样本。
+ */
+int AudioOutput::Reconfigure(const AudioParams& audio_params,
+    AVFrameQueue* frame_queue, AVRational time_base)
+{
+    // 1. 停止回调（SDL_PauseAudio 返回后回调不会再运行）
+    SDL_PauseAudio(1);
+
+    bool reopen = !device_opened_ || audio_params.freq != original_freq_;
+
+    // 2. 更新源参数与队列
+    src_tgt_ = audio_params;
+    frame_queue_ = frame_queue;
+    time_base_ = time_base;
+    pts = 0;
+    paused_ = false;
+
+    // 3. 丢弃上一个文件的残留状态
+    if (swr_ctx_) {
+        swr_free(&swr_ctx_);
+        swr_ctx_ = nullptr;
+    }
+    audio_buf_index = 0;
+    audio_buf_size = 0;
+    audio_buf_ = nullptr;
+    starved_ = true;
+
+    // 4. 采样率变化才重新打开设备
+    if (reopen) {
+        DeInit();
+        if (OpenDevice() < 0) {
+            return -1;
+        }
+    }
+
+    // 5. 重建滤镜图
+    if (BuildFilterGraph() < 0) {
+        return -1;
+    }
+
+    SDL_PauseAudio(0);
+
+    return 0;
+};
+
+/**
+ * @brief 按 src_tgt_ 打开 SDL 音频设备，并记录实际输出参数
+ */
+int AudioOutput::OpenDevice()
+{
+    // 1. 配置 SDL 音频参数
     SDL_AudioSpec wanted_spec;
     wanted_spec.channels = 2;                    // 固定为立体声
     wanted_spec.freq = src_tgt_.freq;            // 采样率（与源相同）
@@ -253,22 +407,41 @@ int AudioOutput::Init()
     wanted_spec.silence = 0;                     // 静音值
     wanted_spec.callback = sdl_audio_callback;   // 回调函数
     wanted_spec.userdata = this;                 // 用户数据（this指针）
-    wanted_spec.samples = 512;                   // 缓冲区样本数（越大延迟越大）
+    wanted_spec.samples = AUDIO_DEVICE_SAMPLES;  // 缓冲区样本数（越大延迟越大）
 
     // 打开音频设备
     if (SDL_OpenAudio(&wanted_spec, nullptr) != 0) {
         printf("SDL_OpenAudio failed\n");
         return -1;
     }
+    device_opened_ = true;
 
-    // 3. 设置目标音频参数（SDL 实际输出格式）
+    // 2. 设置目标音频参数（SDL 实际输出格式）
     av_channel_layout_default(&dst_tgt_.ch_layout, wanted_spec.channels);
     dst_tgt_.fmt = AV_SAMPLE_FMT_S16;           // SDL 使用 S16 格式
     dst_tgt_.freq = wanted_spec.freq;           // SDL 采样率
     original_freq_ = wanted_spec.freq;          // 保存原始采样率（倍速时不变）
+    device_latency_ = (double)wanted_spec.samples / wanted_spec.freq;
+
+    return 0;
+};
 
-    // 4. 构建滤镜图（abuffer -> atempo -> abuffersink）
+/**
+ * @brief 构建滤镜图：abuffer -> atempo -> abuffersink
+ *
+ * 调用前必须保证音频回调没有在运行（SDL_PauseAudio(1) 或设备未启动）
+ */
+int AudioOutput::BuildFilterGraph()
+{
+    // 1. 销毁旧滤镜图
+    FreeFilterGraph();
+
+    // 2. 创建新的滤镜图
     filter_graph_ = avfilter_graph_alloc();
+    if (!filter_graph_) {
+        printf("avfilter_graph_alloc failed\n");
+        return -1;
+    }
 
     // 构建 abuffer 滤镜参数
     char args[512];
@@ -281,36 +454,57 @@ int AudioOutput::Init()
 
     // 创建 abuffer 滤镜（输入源）
     const AVFilter* abuffer = avfilter_get_by_name("abuffer");
-    avfilter_graph_create_filter(&abuffer_ctx_, abuffer, "src", args, nullptr, filter_graph_);
+    if (avfilter_graph_create_filter(&abuffer_ctx_, abuffer, "src", args, nullptr, filter_graph_) < 0) {
+        printf("create abuffer filter failed\n");
+        FreeFilterGraph();
+        return -1;
+    }
 
     // 创建 atempo 滤镜（倍速处理）
     char atempo_args[32];
     snprintf(atempo_args, sizeof(atempo_args), "tempo=%f", speed_);
     const AVFilter* atempo = avfilter_get_by_name("atempo");
-    avfilter_graph_create_filter(&atempo_ctx_, atempo, "atempo", atempo_args, nullptr, filter_graph_);
+    if (avfilter_graph_create_filter(&atempo_ctx_, atempo, "atempo", atempo_args, nullptr, filter_graph_) < 0) {
+        printf("create atempo filter failed\n");
+        FreeFilterGraph();
+        return -1;
+    }
 
     // 创建 abuffersink 滤镜（输出）
     const AVFilter* abuffersink = avfilter_get_by_name("abuffersink");
-    avfilter_graph_create_filter(&abuffersink_ctx_, abuffersink, "sink", nullptr, nullptr, filter_graph_);
+    if (avfilter_graph_create_filter(&abuffersink_ctx_, abuffersink, "sink", nullptr, nullptr, filter_graph_) < 0) {
+        printf("create abuffersink filter failed\n");
+        FreeFilterGraph();
+        return -1;
+    }
 
     // 连接滤镜：abuffer -> atempo -> abuffersink
-    avfilter_link(abuffer_ctx_, 0, atempo_ctx_, 0);
-    avfilter_link(atempo_ctx_, 0, abuffersink_ctx_, 0);
+    if (avfilter_link(abuffer_ctx_, 0, atempo_ctx_, 0) < 0 ||
+        avfilter_link(atempo_ctx_, 0, abuffersink_ctx_, 0) < 0) {
+        printf("link filters failed\n");
+        FreeFilterGraph();
+        return -1;
+    }
 
     // 配置滤镜图
-    avfilter_graph_config(filter_graph_, nullptr);
-
-    // 5. 启动音频播放（SDL_PauseAudio(0) 开始播放）
-    SDL_PauseAudio(0);
+    if (avfilter_graph_config(filter_graph_, nullptr) < 0) {
+        printf("config filter graph failed\n");
+        FreeFilterGraph();
+        return -1;
+    }
 
     return 0;
 };
 
-int AudioOutput::DeInit()
+void AudioOutput::FreeFilterGraph()
 {
-    SDL_PauseAudio(1);
-    SDL_CloseAudio();
-    return 0;
+    if (filter_graph_) {
+        avfilter_graph_free(&filter_graph_);
+        filter_graph_ = nullptr;
+    }
+    abuffer_ctx_ = nullptr;
+    atempo_ctx_ = nullptr;
+    abuffersink_ctx_ = nullptr;
 };
 
 // ============================================================================
@@ -344,84 +538,19 @@ void AudioOutput::SetSpeed(float s)
     // 2. 暂停音频播放（安全操作）
     SDL_PauseAudio(1);
 
-    // 3. 销毁旧滤镜图
-    if (filter_graph_) {
-        avfilter_graph_free(&filter_graph_);
-        filter_graph_ = nullptr;
-        abuffer_ctx_ = nullptr;
-        atempo_ctx_ = nullptr;
-        abuffersink_ctx_ = nullptr;
-    }
-
-    // 4. 创建新的滤镜图
-    filter_graph_ = avfilter_graph_alloc();
-    if (!filter_graph_) {
-        printf("avfilter_graph_alloc failed\n");
+    // 3. 重建滤镜图（使用新的倍速参数）
+    if (BuildFilterGraph() < 0) {
         SDL_PauseAudio(0);  // 恢复播放（尽管失败了）
         return;
     }
 
-    // 重建 abuffer 滤镜（参数不变）
-    char args[512];
-    snprintf(args, sizeof(args),
-        "sample_rate=%d:sample_fmt=%s:channel_layout=%" PRId64 ":time_base=1/%d",
-        src_tgt_.freq,
-        av_get_sample_fmt_name(src_tgt_.fmt),
-        src_tgt_.ch_layout.u.mask,
-        src_tgt_.freq);
-
-    const AVFilter* abuffer = avfilter_get_by_name("abuffer");
-    if (avfilter_graph_create_filter(&abuffer_ctx_, abuffer, "src", args, nullptr, filter_graph_) < 0) {
-        printf("create abuffer filter failed\n");
-        avfilter_graph_free(&filter_graph_);
-        SDL_PauseAudio(0);
-        return;
-    }
-
-    // 重建 atempo 滤镜（使用新的倍速参数）
-    char atempo_args[32];
-    snprintf(atempo_args, sizeof(atempo_args), "tempo=%f", speed_);
-    const AVFilter* atempo = avfilter_get_by_name("atempo");
-    if (avfilter_graph_create_filter(&atempo_ctx_, atempo, "atempo", atempo_args, nullptr, filter_graph_) < 0) {
-        printf("create atempo filter failed\n");
-        avfilter_graph_free(&filter_graph_);
-        SDL_PauseAudio(0);
-        return;
-    }
-
-    // 重建 abuffersink 滤镜
-    const AVFilter* abuffersink = avfilter_get_by_name("abuffersink");
-    if (avfilter_graph_create_filter(&abuffersink_ctx_, abuffersink, "sink", nullptr, nullptr, filter_graph_) < 0) {
-        printf("create abuffersink filter failed\n");
-        avfilter_graph_free(&filter_graph_);
-        SDL_PauseAudio(0);
-        return;
-    }
-
-    // 连接滤镜
-    if (avfilter_link(abuffer_ctx_, 0, atempo_ctx_, 0) < 0 ||
-        avfilter_link(atempo_ctx_, 0, abuffersink_ctx_, 0) < 0) {
-        printf("link filters failed\n");
-        avfilter_graph_free(&filter_graph_);
-        SDL_PauseAudio(0);
-        return;
-    }
-
-    // 配置滤镜图
-    if (avfilter_graph_config(filter_graph_, nullptr) < 0) {
-        printf("config filter graph failed\n");
-        avfilter_graph_free(&filter_graph_);
-        SDL_PauseAudio(0);
-        return;
-    }
-
-    // 5. 重置音频缓冲区状态（避免使用旧数据）
+    // 4. 重置音频缓冲区状态（避免使用旧数据）
     audio_buf_index = 0;
     audio_buf_size = 0;
     audio_buf_ = nullptr;
 
     printf("Filter graph rebuilt for speed: %fx\n", speed_);
 
-    // 6. 恢复音频播放
+    // 5. 恢复音频播放
     SDL_PauseAudio(0);
 };
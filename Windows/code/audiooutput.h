@@ -3,6 +3,8 @@
 
 #include "avframequeue.h"
 #include "avsync.h"
+#include "outputsink.h"
+#include <atomic>
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,15 +19,8 @@ extern "C" {
 }
 #endif
 
-/**
- * @brief 音频参数结构体（包含采样率 / 声道布局 / 采样格式）
- *        此结构由解析器或解码器初始化后传入。
- */
-typedef struct _AudioParams {
-    int freq;                   // 采样率
-    AVChannelLayout ch_layout;  // 声道布局
-    enum AVSampleFormat fmt;    // 采样格式
-} AudioParams;
+// SDL 音频设备缓冲区样本数
+#define AUDIO_DEVICE_SAMPLES 512
 
 /**
  * @brief 音频输出模块（负责音频重采样、ATempo、SDL 播放）
@@ -36,21 +31,39 @@ typedef struct _AudioParams {
  * - 使用 SwrContext 进行格式转换（如需要）
  * - 从 AVFrameQueue 中连续取出音频帧播放
  */
-class AudioOutput {
+class AudioOutput : public AudioSink {
 public:
     AudioOutput(AVSync* avsync, const AudioParams& audio_params,
         AVFrameQueue* frame_queue, AVRational time_base);
     ~AudioOutput();
 
-    int Init();        // 初始化 SDL 和滤镜图
-    int DeInit();      // 反初始化（关闭 SDL）
+    int Init() override;        // 初始化 SDL 和滤镜图
+    int DeInit() override;      // 反初始化（关闭 SDL）
+
+    // 切换到新的音频流：设备参数不变时保留已打开的 SDL 音频设备，
+    // 只重建滤镜图并重置缓冲区
+    int Reconfigure(const AudioParams& audio_params,
+        AVFrameQueue* frame_queue, AVRational time_base) override;
+
+    void Pause() override;      // 暂停播放
+    void Resume() override;     // 恢复播放
+    bool isPaused() override;   // 是否处于暂停
 
-    void Pause();      // 暂停播放
-    void Resume();     // 恢复播放
-    bool isPaused();   // 是否处于暂停
+    void SetSpeed(float s) override;     // 设置倍速
+    float GetSpeed() const override { return speed_; } // 获取当前倍速
 
-    void SetSpeed(float s);     // 设置倍速
-    float GetSpeed() const { return speed_; } // 获取当前倍速
+    int64_t SamplesPlayed() const override { return samples_played_; } // 已播放样本数
+    int64_t CpuTimeUs() const override { return cpu_time_us_; }         // 音频回调线程 CPU 时间
+
+    // 不打开 SDL 设备，按 S16 立体声、源采样率的输出参数构建滤镜图，
+    // 之后用 FillBuffer 直接驱动回调（微基准测试用）
+    int InitOffline(float speed);
+    void FillBuffer(Uint8* stream, int len);  // 执行一次音频回调，写出 len 字节 PCM
+
+private:
+    int OpenDevice();           // 按 src_tgt_ 打开 SDL 音频设备并设置 dst_tgt_
+    int BuildFilterGraph();     // 按 src_tgt_ 和 speed_ 构建 abuffer -> atempo -> abuffersink
+    void FreeFilterGraph();     // 释放滤镜图
 
 public:
     AVFrameQueue* frame_queue_ = nullptr; // 音频帧队列（由外部提供）
@@ -62,6 +75,7 @@ public:
 
     uint8_t* audio_buf1_ = nullptr; // 转换后的 PCM 缓冲区
     uint32_t audio_buf1_size = 0;
+    AVFrame* filt_frame_ = nullptr; // 接收滤镜输出的帧（常驻复用，回调中不再分配）
     uint8_t* audio_buf_ = nullptr;  // 当前正在播放的缓冲区
     uint32_t audio_buf_size = 0;
     uint32_t audio_buf_index = 0;   // 当前播放位置在 audio_buf_ 中的偏移
@@ -74,6 +88,16 @@ public:
 
     float speed_ = 1.0f;       // 当前倍速
     int original_freq_ = 0;    // SDL 输出采样率
+    bool device_opened_ = false; // SDL 音频设备是否已打开
+    double device_latency_ = 0.0; // 设备缓冲区时长（秒）：回调写入的数据要等这么久才开始播放
+
+    std::atomic<int64_t> samples_played_{ 0 }; // 已送入设备的样本数（每声道）
+    std::atomic<int64_t> cpu_time_us_{ 0 };    // 回调线程 CPU 时间（每次回调结束时采样）
+
+    bool starved_ = true;                         // 上一次取帧时队列为空（开始播放前视为已空）
+    MetricCounter* underruns_ = nullptr;          // 指标：播放中帧队列由有数据变为空的次数
+    MetricCounter* silence_insertions_ = nullptr; // 指标：填充静音的次数
+    MetricCounter* silence_bytes_ = nullptr;      // 指标：填充静音的字节数
 
     // FFmpeg 滤镜图相关
     AVFilterGraph* filter_graph_ = nullptr;
@@ -1,9 +1,67 @@
 ﻿#include "avframequeue.h"
+#include "framelatency.h"
+
+// 空闲链表上限：超过时归还的空壳直接释放，避免一次突发后长期占用内存
+static const size_t kFreeListCap = 256;
+
+int64_t FrameBytes(const AVFrame* frame)
+{
+    int64_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++)
+        bytes += frame->buf[i]->size;
+    for (int i = 0; i < frame->nb_extended_buf; i++)
+        bytes += frame->extended_buf[i]->size;
+
+    return bytes;
+};
+
+/**
+ * @brief 计算帧的显示时长（微秒）
+ *
+ * 音频按样本数与采样率计算；视频优先用解码器带出的 frame->duration，没有时按帧率估算
+ */
+int64_t AVFrameQueue::FrameDurationUs(const AVFrame* frame)
+{
+    if (frame->nb_samples > 0 && frame->sample_rate > 0)
+        return (int64_t)frame->nb_samples * 1000000 / frame->sample_rate;
+
+    if (frame->duration > 0 && time_base_.num > 0)
+        return av_rescale_q(frame->duration, time_base_, AVRational{ 1, 1000000 });
+
+    return default_duration_us_;
+};
+
+/**
+ * @brief 入队（sign = 1）/ 出队（sign = -1）时更新字节数、时长、共享预算与指标
+ */
+void AVFrameQueue::Account(const AVFrame* frame, int sign)
+{
+    int64_t bytes = FrameBytes(frame) * sign;
+    int64_t duration = FrameDurationUs(frame) * sign;
+
+    queued_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    queued_us_.fetch_add(duration, std::memory_order_relaxed);
+    if (budget_)
+        budget_->Add(bytes);
+
+    depth_->Add(sign);
+    bytes_->Add(bytes);
+    duration_->Add(duration);
+};
 
 /**
- * @brief 构造函数，初始化AVFrameQueue对象
+ * @brief 构造函数，初始化AVFrameQueue对象并注册队列指标
  */
-AVFrameQueue::AVFrameQueue() {};
+AVFrameQueue::AVFrameQueue(const char* name)
+{
+    std::string prefix = std::string("queue.") + name;
+    depth_ = MetricsRegistry::Instance().GetGauge(prefix + ".depth");
+    bytes_ = MetricsRegistry::Instance().GetGauge(prefix + ".bytes");
+    dropped_ = MetricsRegistry::Instance().GetCounter(prefix + ".dropped");
+    duration_ = MetricsRegistry::Instance().GetGauge(prefix + ".duration_us");
+    allocs_ = MetricsRegistry::Instance().GetCounter("alloc.frames");
+    free_.reserve(kFreeListCap);
+};
 
 /**
  * @brief 析构函数，释放队列中的资源
@@ -11,6 +69,8 @@ AVFrameQueue::AVFrameQueue() {};
 AVFrameQueue::~AVFrameQueue()
 {
     Abort();
+    for (AVFrame* item : free_)
+        av_frame_free(&item);
 };
 
 /**
@@ -25,6 +85,17 @@ void AVFrameQueue::Abort()
     queue_.Abort();
 };
 
+/**
+ * @brief 重新启用已终止的队列
+ * 清空残留的帧并清除终止标志，用于切换文件时复用队列
+ */
+void AVFrameQueue::Reset()
+{
+    // 先清除终止标志，否则 release() 无法从已终止的队列中取出残留元素
+    queue_.Reset();
+    release();
+};
+
 /**
  * @brief 获取队列中当前的帧数量
  * @return 队列中的帧数量
@@ -34,6 +105,64 @@ int AVFrameQueue::Size()
     return queue_.Size();
 };
 
+/**
+ * @brief 获取队列中帧引用的缓冲区总字节数
+ */
+int64_t AVFrameQueue::Bytes()
+{
+    return queued_bytes_.load(std::memory_order_relaxed);
+};
+
+/**
+ * @brief 获取队列中帧的总时长（微秒）
+ */
+int64_t AVFrameQueue::DurationUs()
+{
+    return queued_us_.load(std::memory_order_relaxed);
+};
+
+/**
+ * @brief 设置容量限制与共享预算
+ */
+void AVFrameQueue::SetLimits(const FrameQueueLimits& limits, FrameMemoryBudget* budget)
+{
+    limits_ = limits;
+    budget_ = budget;
+};
+
+/**
+ * @brief 设置视频帧时长的换算参数
+ */
+void AVFrameQueue::SetStreamInfo(AVRational time_base, AVRational frame_rate)
+{
+    time_base_ = time_base;
+    default_duration_us_ = (frame_rate.num > 0 && frame_rate.den > 0)
+        ? av_rescale_q(1, av_inv_q(frame_rate), AVRational{ 1, 1000000 }) : 40000;
+};
+
+/**
+ * @brief 队列是否已满
+ *
+ * 先保证最少帧数与最小时长（音频的提前量），再检查本队列上限和共享预算。
+ * 共享预算被另一个队列用完时本队列也会停下，但最少帧数保证了双方都不会饿死
+ */
+bool AVFrameQueue::Full()
+{
+    if (Size() < limits_.min_frames)
+        return false;
+
+    int64_t duration = DurationUs();
+    if (duration < limits_.min_duration_us)
+        return false;
+
+    if (limits_.max_bytes > 0 && Bytes() > limits_.max_bytes)
+        return true;
+    if (limits_.max_duration_us > 0 && duration > limits_.max_duration_us)
+        return true;
+
+    return budget_ && budget_->Exceeded();
+};
+
 /**
  * @brief 将一个AVFrame放入队列
  * @param val 要放入队列的AVFrame指针
@@ -44,12 +173,32 @@ int AVFrameQueue::Size()
  */
 int AVFrameQueue::Push(AVFrame* val)
 {
-    // 分配一个新的AVFrame
-    AVFrame* tmp_frame = av_frame_alloc();
+    // 取一个空壳（优先复用已归还的）
+    AVFrame* tmp_frame = Obtain();
     // 移动引用，将val的内容移动到tmp_frame，val的引用计数会被重置为0
     av_frame_move_ref(tmp_frame, val);
+    StampEnqueue(tmp_frame);
+
+    // 先计入指标，避免消费者先取出导致长度短暂为负
+    Account(tmp_frame, 1);
+
     // 将新帧放入队列
-    return queue_.Push(tmp_frame);
+    if (queue_.Push(tmp_frame) < 0) {
+        // 队列已终止：帧不会再被取出，直接释放
+        Account(tmp_frame, -1);
+        Recycle(tmp_frame);
+        return -1;
+    }
+
+    if (push_listener_)
+        push_listener_();
+
+    return 0;
+};
+
+void AVFrameQueue::SetPushListener(std::function<void()> listener)
+{
+    push_listener_ = std::move(listener);
 };
 
 /**
@@ -57,7 +206,7 @@ int AVFrameQueue::Push(AVFrame* val)
  * @param timeout 等待超时时间，单位为毫秒，0表示不等待
  * @return 成功返回AVFrame指针，失败返回NULL
  *
- * 调用方负责释放返回的AVFrame
+ * 用完后调用 Recycle() 归还（也可以直接 av_frame_free）
  */
 AVFrame* AVFrameQueue::Pop(const int timeout)
 {
@@ -71,6 +220,7 @@ AVFrame* AVFrameQueue::Pop(const int timeout)
         // 队列已终止或出错，返回NULL
         return NULL;
     }
+    Account(tmp_frame, -1);
     // 返回队列中的帧
     return tmp_frame;
 };
@@ -113,8 +263,45 @@ void AVFrameQueue::release()
         }
         else {
             // 释放帧资源
-            av_frame_free(&tmp_frame);
+            Account(tmp_frame, -1);
+            dropped_->Add(1);
+            Recycle(tmp_frame);
             continue;
         }
     }
 };
+
+/**
+ * @brief 从空闲链表取一个AVFrame空壳，链表为空时才新分配并计数
+ */
+AVFrame* AVFrameQueue::Obtain()
+{
+    {
+        std::lock_guard<std::mutex> lock(free_mtx_);
+        if (!free_.empty()) {
+            AVFrame* tmp_frame = free_.back();
+            free_.pop_back();
+            return tmp_frame;
+        }
+    }
+    allocs_->Add(1);
+    return av_frame_alloc();
+};
+
+/**
+ * @brief 归还帧：释放数据引用后放回空闲链表，超过上限的直接释放
+ */
+void AVFrameQueue::Recycle(AVFrame* val)
+{
+    if (!val)
+        return;
+    av_frame_unref(val);
+    {
+        std::lock_guard<std::mutex> lock(free_mtx_);
+        if (free_.size() < kFreeListCap) {
+            free_.push_back(val);
+            return;
+        }
+    }
+    av_frame_free(&val);
+};
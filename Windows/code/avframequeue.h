@@ -1,6 +1,9 @@
 ﻿#ifndef AVFRAMEQUEUE_H
 #define AVFRAMEQUEUE_H
 #include "queue.h"
+#include "metrics.h"
+#include <atomic>
+#include <functional>
 #ifdef __cplusplus
 extern "C" { 
 #include "libavcodec/avcodec.h"
@@ -8,21 +11,111 @@ extern "C" {
 }
 #endif
 
+/**
+ * @brief 计算帧引用的数据缓冲区总大小（字节）
+ */
+int64_t FrameBytes(const AVFrame* frame);
+
+/**
+ * @brief 帧队列的容量限制（AVFrameQueue::SetLimits）
+ *
+ * 队列中少于 min_frames 帧或不足 min_duration_us 时长时总是允许继续解码（保证前进和最小提前量）；
+ * 超过之后，字节数或时长任一超出上限、或共享预算用完时 Full() 返回 true
+ */
+struct FrameQueueLimits {
+    int min_frames = 3;             // 最少保留的帧数
+    int64_t min_duration_us = 0;    // 最少保留的时长（微秒）
+    int64_t max_bytes = 0;          // 队列字节上限，0 表示只受共享预算限制
+    int64_t max_duration_us = 0;    // 队列时长上限（微秒），0 表示不限
+};
+
+/**
+ * @brief 多个帧队列共享的内存预算（字节），按帧实际引用的缓冲区大小计算
+ */
+class FrameMemoryBudget
+{
+public:
+    void SetLimit(int64_t bytes) { limit_.store(bytes, std::memory_order_relaxed); };
+    int64_t Limit() const { return limit_.load(std::memory_order_relaxed); };
+    int64_t Used() const { return used_.load(std::memory_order_relaxed); };
+    void Add(int64_t bytes) { used_.fetch_add(bytes, std::memory_order_relaxed); };
+    bool Exceeded() const { return Limit() > 0 && Used() > Limit(); };
+
+private:
+    std::atomic<int64_t> limit_{ 0 };   // 上限，0 表示不限
+    std::atomic<int64_t> used_{ 0 };    // 所有共享队列中的帧占用的字节数
+};
+
 class AVFrameQueue
 {
 public:
-    AVFrameQueue();
+    /**
+     * @param name 队列名，用于注册指标 queue.<name>.depth / .bytes / .dropped
+     */
+    explicit AVFrameQueue(const char* name);
     ~AVFrameQueue();
 
     void Abort();
+    void Reset();
     int Size();
+    int64_t Bytes();        // 队列中帧引用的缓冲区总字节数
+    int64_t DurationUs();   // 队列中帧的总时长（微秒）
+
+    /**
+     * @brief 设置容量限制与共享预算（budget 可为空），应在解码线程启动前调用
+     */
+    void SetLimits(const FrameQueueLimits& limits, FrameMemoryBudget* budget);
+
+    /**
+     * @brief 设置视频帧时长的换算参数：frame->duration 按 time_base 换算，
+     *        没有 duration 的帧按 frame_rate 估算（音频帧由样本数计算，不需要调用）
+     */
+    void SetStreamInfo(AVRational time_base, AVRational frame_rate);
+
+    /**
+     * @brief 队列是否已满（见 FrameQueueLimits），解码线程据此暂停解码
+     */
+    bool Full();
+
+    /**
+     * @brief 设置入队通知：每次 Push 成功后在 Push 的线程上调用（应尽快返回）
+     * 在解码线程启动前设置，传空函数取消；渲染端用它在队列由空变为非空时被唤醒
+     */
+    void SetPushListener(std::function<void()> listener);
+
     int Push(AVFrame *val);
     AVFrame *Pop(const int timeout);
     AVFrame *Front();
 
+    /**
+     * @brief 归还 Pop 取出的帧：释放其引用的数据，空壳放回空闲链表供下次 Push 复用
+     * 可在任意线程调用；传入 NULL 时什么也不做
+     */
+    void Recycle(AVFrame *val);
+
 private:
     void release();// 释放队列中所有 AVFrame 资源（内部使用）
+    AVFrame *Obtain();// 从空闲链表取一个空壳，链表为空时才分配
+    int64_t FrameDurationUs(const AVFrame *frame);// 帧的显示时长（微秒）
+    void Account(const AVFrame *frame, int sign);// 入队（+1）/ 出队（-1）时更新字节数、时长与指标
     Queue<AVFrame *> queue_;// 底层线程安全队列，存储 AVFrame 指针
+
+    MetricGauge* depth_ = nullptr;      // 队列长度
+    MetricGauge* bytes_ = nullptr;      // 队列中数据占用的字节数
+    MetricGauge* duration_ = nullptr;   // 队列中帧的总时长（微秒）
+    MetricCounter* dropped_ = nullptr;  // 未被取出就被清空的元素数
+    MetricCounter* allocs_ = nullptr;   // 空闲链表为空、入队时新分配的 AVFrame 个数（所有同类队列共用）
+
+    std::atomic<int64_t> queued_bytes_{ 0 };    // 队列中帧引用的字节数
+    std::atomic<int64_t> queued_us_{ 0 };       // 队列中帧的总时长（微秒）
+    FrameQueueLimits limits_;                   // 容量限制
+    FrameMemoryBudget* budget_ = nullptr;       // 共享预算（可为空）
+    std::function<void()> push_listener_;       // 入队通知（可为空）
+    AVRational time_base_{ 0, 1 };              // 视频帧 duration 的时间基
+    int64_t default_duration_us_ = 40000;       // 没有 duration 的视频帧按此估算
+
+    std::mutex free_mtx_;               // 保护空闲链表
+    std::vector<AVFrame *> free_;         // 已归还的空壳（容量预留，归还时不分配内存）
 };
 
 #endif // AVFRAMEQUEUE_H
@@ -1,9 +1,20 @@
 ﻿#include "avpacketqueue.h"
 
+// 空闲链表上限：超过时归还的空壳直接释放，避免一次突发后长期占用内存
+static const size_t kFreeListCap = 256;
+
 /**
- * @brief 构造函数，初始化AVPacketQueue对象
+ * @brief 构造函数，初始化AVPacketQueue对象并注册队列指标
  */
-AVPacketQueue::AVPacketQueue() {};
+AVPacketQueue::AVPacketQueue(const char* name)
+{
+    std::string prefix = std::string("queue.") + name;
+    depth_ = MetricsRegistry::Instance().GetGauge(prefix + ".depth");
+    bytes_ = MetricsRegistry::Instance().GetGauge(prefix + ".bytes");
+    dropped_ = MetricsRegistry::Instance().GetCounter(prefix + ".dropped");
+    allocs_ = MetricsRegistry::Instance().GetCounter("alloc.packets");
+    free_.reserve(kFreeListCap);
+};
 
 /**
  * @brief 析构函数，释放队列中的资源
@@ -11,6 +22,8 @@ AVPacketQueue::AVPacketQueue() {};
 AVPacketQueue::~AVPacketQueue()
 {
     Abort();
+    for (AVPacket* item : free_)
+        av_packet_free(&item);
 };
 
 /**
@@ -25,6 +38,17 @@ void AVPacketQueue::Abort()
     queue_.Abort();
 };
 
+/**
+ * @brief 重新启用已终止的队列
+ * 清空残留的数据包并清除终止标志，用于切换文件时复用队列
+ */
+void AVPacketQueue::Reset()
+{
+    // 先清除终止标志，否则 release() 无法从已终止的队列中取出残留元素
+    queue_.Reset();
+    release();
+};
+
 /**
  * @brief 获取队列中当前的数据包数量
  * @return 队列中的数据包数量
@@ -34,6 +58,14 @@ int AVPacketQueue::Size()
     return queue_.Size();
 };
 
+/**
+ * @brief 获取队列中数据包负载的总字节数
+ */
+int64_t AVPacketQueue::Bytes()
+{
+    return bytes_->Get();
+};
+
 /**
  * @brief 将一个AVPacket放入队列
  * @param val 要放入队列的AVPacket指针
@@ -44,12 +76,26 @@ int AVPacketQueue::Size()
  */
 int AVPacketQueue::Push(AVPacket* val)
 {
-    // 分配一个新的AVPacket
-    AVPacket* tmp_pkt = av_packet_alloc();
+    // 取一个空壳（优先复用已归还的）
+    AVPacket* tmp_pkt = Obtain();
     // 移动引用，将val的内容移动到tmp_pkt，val的引用计数会被重置为0
     av_packet_move_ref(tmp_pkt, val);
+
+    // 先计入指标，避免消费者先取出导致长度短暂为负
+    int size = tmp_pkt->size;
+    depth_->Add(1);
+    bytes_->Add(size);
+
     // 将新数据包放入队列
-    return queue_.Push(tmp_pkt);
+    if (queue_.Push(tmp_pkt) < 0) {
+        // 队列已终止：数据包不会再被取出，直接释放
+        depth_->Add(-1);
+        bytes_->Add(-size);
+        Recycle(tmp_pkt);
+        return -1;
+    }
+
+    return 0;
 };
 
 /**
@@ -57,7 +103,7 @@ int AVPacketQueue::Push(AVPacket* val)
  * @param timeout 等待超时时间，单位为毫秒，0表示不等待
  * @return 成功返回AVPacket指针，失败返回NULL
  *
- * 调用方负责释放返回的AVPacket
+ * 用完后调用 Recycle() 归还（也可以直接 av_packet_free）
  */
 AVPacket* AVPacketQueue::Pop(const int timeout)
 {
@@ -71,6 +117,8 @@ AVPacket* AVPacketQueue::Pop(const int timeout)
         // 队列已终止或出错，返回NULL
         return NULL;
     }
+    depth_->Add(-1);
+    bytes_->Add(-tmp_pkt->size);
     // 返回队列中的数据包
     return tmp_pkt;
 };
@@ -91,8 +139,46 @@ void AVPacketQueue::release()
         }
         else {
             // 释放数据包资源
-            av_packet_free(&tmp_pkt);
+            depth_->Add(-1);
+            bytes_->Add(-tmp_pkt->size);
+            dropped_->Add(1);
+            Recycle(tmp_pkt);
             continue;
         }
     }
 };
+
+/**
+ * @brief 从空闲链表取一个AVPacket空壳，链表为空时才新分配并计数
+ */
+AVPacket* AVPacketQueue::Obtain()
+{
+    {
+        std::lock_guard<std::mutex> lock(free_mtx_);
+        if (!free_.empty()) {
+            AVPacket* tmp_pkt = free_.back();
+            free_.pop_back();
+            return tmp_pkt;
+        }
+    }
+    allocs_->Add(1);
+    return av_packet_alloc();
+};
+
+/**
+ * @brief 归还数据包：释放数据引用后放回空闲链表，超过上限的直接释放
+ */
+void AVPacketQueue::Recycle(AVPacket* val)
+{
+    if (!val)
+        return;
+    av_packet_unref(val);
+    {
+        std::lock_guard<std::mutex> lock(free_mtx_);
+        if (free_.size() < kFreeListCap) {
+            free_.push_back(val);
+            return;
+        }
+    }
+    av_packet_free(&val);
+};
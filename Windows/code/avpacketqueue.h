@@ -1,6 +1,7 @@
 ﻿#ifndef AVPACKETQUEUE_H
 #define AVPACKETQUEUE_H
 #include "queue.h"
+#include "metrics.h"
 #ifdef __cplusplus
 extern "C" {
 #include "libavcodec/avcodec.h"
@@ -10,17 +11,37 @@ extern "C" {
 class AVPacketQueue
 {
 public:
-    AVPacketQueue();
+    /**
+     * @param name 队列名，用于注册指标 queue.<name>.depth / .bytes / .dropped
+     */
+    explicit AVPacketQueue(const char* name);
     ~AVPacketQueue();
 
     void Abort();
+    void Reset();
     int Size();
+    int64_t Bytes();// 队列中数据包负载的总字节数
     int Push(AVPacket *val);
     AVPacket *Pop(const int timeout);
 
+    /**
+     * @brief 归还 Pop 取出的数据包：释放其引用的数据，空壳放回空闲链表供下次 Push 复用
+     * 可在任意线程调用；传入 NULL 时什么也不做
+     */
+    void Recycle(AVPacket *val);
+
 private:
     void release();// 释放队列中所有 AVPacket 资源（内部使用）
+    AVPacket *Obtain();// 从空闲链表取一个空壳，链表为空时才分配
     Queue<AVPacket *> queue_;// 底层线程安全队列，存储 AVPacket 指针
+
+    MetricGauge* depth_ = nullptr;      // 队列长度
+    MetricGauge* bytes_ = nullptr;      // 队列中数据占用的字节数
+    MetricCounter* dropped_ = nullptr;  // 未被取出就被清空的元素数
+    MetricCounter* allocs_ = nullptr;   // 空闲链表为空、入队时新分配的 AVPacket 个数（所有同类队列共用）
+
+    std::mutex free_mtx_;               // 保护空闲链表
+    std::vector<AVPacket *> free_;         // 已归还的空壳（容量预留，归还时不分配内存）
 };
 
 #endif // AVPACKETQUEUE_H
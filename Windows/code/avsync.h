@@ -1,10 +1,7 @@
 ﻿#ifndef AVSYNC_H
 #define AVSYNC_H
 
-extern "C" {
-#include <libavutil/time.h>    
-}
-
+#include "clocksource.h"
 #include <mutex>
 
 /**
@@ -16,8 +13,13 @@ extern "C" {
  *   - 视频刷新线程通过 GetClock 获取当前时钟并决定是否显示帧
  *
  * 时钟原理：
- *   主时钟 = 系统时间 NowSec() + 偏移量 pts_drift_
- *   音频回调每次播放 PCM 时会调用 SetClock(pts)，驱动主时钟前进。
+ *   主时钟 = 最近一次 SetClock 的 pts_ + 之后经过的系统时间 x 倍速 speed_
+ *   音频回调每次播放 PCM 时会调用 SetClock(pts)，驱动主时钟前进；
+ *   两次回调之间按倍速外推，视频据此算出下一帧精确的到期时间。
+ *   暂停时时钟停在当前值，恢复后从该值继续。
+ *
+ * 时间源默认为系统时间，可通过 SetClockSource 换成 VirtualClock，
+ * 使整条流水线以超过实时的速度运行，同步判断不变。
  */
 class AVSync
 {
@@ -30,9 +32,23 @@ public:
      */
     void InitClock()
     {
+        {
+            std::lock_guard<std::mutex> lk(clock_mtx_);
+            paused_ = false;
+        }
         ResetClock(0.0);
     };
 
+    /**
+     * @brief 更换时间源（在输出端开始工作前调用）
+     * @param source 时间源，传 nullptr 恢复系统时间；调用方保证其生命周期
+     */
+    void SetClockSource(ClockSource* source)
+    {
+        std::lock_guard<std::mutex> lk(clock_mtx_);
+        source_ = source ? source : &real_clock_;
+    };
+
     /**
      * @brief 设置主时钟值（通常由音频线程调用）
      * @param pts 当前音频播放进度（单位：秒）
@@ -43,8 +59,8 @@ public:
     void SetClock(double pts)
     {
         std::lock_guard<std::mutex> lk(clock_mtx_);
-        double now = NowSec();
-        pts_drift_ = pts - now;
+        pts_ = pts;
+        anchor_ = NowSec();
     };
 
     /**
@@ -54,8 +70,8 @@ public:
     void ResetClock(double pts)
     {
         std::lock_guard<std::mutex> lk(clock_mtx_);
-        double now = NowSec();
-        pts_drift_ = pts - now;
+        pts_ = pts;
+        anchor_ = NowSec();
     };
 
     /**
@@ -63,24 +79,86 @@ public:
      * @return 当前主时钟（秒）
      */
     double GetClock()
+    {
+        std::lock_guard<std::mutex> lk(clock_mtx_);
+        return ClockAt(NowSec());
+    };
+
+    /**
+     * @brief 设置时钟的外推速度（与音频倍速一致），从当前时钟值开始生效
+     */
+    void SetSpeed(double speed)
+    {
+        std::lock_guard<std::mutex> lk(clock_mtx_);
+        double now = NowSec();
+        pts_ = ClockAt(now);
+        anchor_ = now;
+        speed_ = speed > 0.0 ? speed : 1.0;
+    };
+
+    /**
+     * @brief 当前倍速：媒体时间 diff 秒对应 diff / Speed() 秒系统时间
+     */
+    double Speed()
+    {
+        std::lock_guard<std::mutex> lk(clock_mtx_);
+        return speed_;
+    };
+
+    /**
+     * @brief 暂停 / 恢复：暂停期间 GetClock 保持不变
+     */
+    void Pause()
     {
         std::lock_guard<std::mutex> lk(clock_mtx_);
         double now = NowSec();
+        pts_ = ClockAt(now);
+        anchor_ = now;
+        paused_ = true;
+    };
+
+    void Resume()
+    {
+        std::lock_guard<std::mutex> lk(clock_mtx_);
+        anchor_ = NowSec();
+        paused_ = false;
+    };
 
-        return pts_drift_ + now;
+    /**
+     * @brief 获取时间源的当前时间（秒）
+     *
+     * 与主时钟使用同一时间源（系统时间或虚拟时钟），用于记录帧实际显示 / 声音实际播放的时刻
+     */
+    double SourceNowSec()
+    {
+        std::lock_guard<std::mutex> lk(clock_mtx_);
+        return NowSec();
     };
 
 private:
     /**
-     * @brief 获取当前系统相对时间（秒）
+     * @brief 获取时间源的当前时间（秒）
      */
     inline double NowSec() const
     {
-        return av_gettime_relative() / 1000000.0;
+        return source_->NowSec();
+    };
+
+    /**
+     * @brief now 时刻的主时钟值（调用方持有锁）
+     */
+    inline double ClockAt(double now) const
+    {
+        return paused_ ? pts_ : pts_ + (now - anchor_) * speed_;
     };
 
 private:
-    double pts_drift_ = 0.0;          // 主时钟偏移量（秒）
+    RealClock real_clock_;            // 默认时间源
+    ClockSource* source_ = &real_clock_; // 当前时间源
+    double pts_ = 0.0;                // 最近一次设置的时钟值（秒）
+    double anchor_ = 0.0;             // 设置时的时间源时间（秒）
+    double speed_ = 1.0;              // 外推速度（倍速）
+    bool paused_ = false;             // 暂停时时钟不前进
     mutable std::mutex clock_mtx_;    // 保护时钟的互斥锁
 };
 
@@ -0,0 +1,189 @@
+﻿#include "benchmark.h"
+#include "maincontroller.h"
+#include "framelatency.h"
+#include "framepacing.h"
+#include "shmexport.h"
+#include "threadutil.h"
+#include "synthmedia.h"
+#include "allochook.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <thread>
+
+// 队列长度采样间隔（毫秒）
+#define BENCH_SAMPLE_INTERVAL 10
+
+// 预热帧数：之后本仓库代码的堆分配次数应不再增长（稳定播放零分配，见 allochook.h）
+#define BENCH_WARMUP_FRAMES 60
+
+/**
+ * @brief 单个队列的长度统计
+ */
+struct QueueOccupancy {
+    int64_t sum = 0;    // 采样值之和
+    int max = 0;        // 最大值
+
+    void Add(int size)
+    {
+        sum += size;
+        if (size > max)
+            max = size;
+    };
+};
+
+int RunPipelineBenchmark(const char* url, SinkType type, const char* shm_name, bool assert_no_alloc)
+{
+    using clock = std::chrono::steady_clock;
+
+    const char* mode = "fast";
+    if (type == SinkType::NullPaced)
+        mode = "paced";
+    else if (type == SinkType::NullVirtual)
+        mode = "virtual";
+
+    if (assert_no_alloc && !HeapAllocHookEnabled()) {
+        printf("bench: --assert-no-alloc needs a glibc build with PLAYER_ALLOC_HOOK defined\n");
+        return -1;
+    }
+
+    // lavfi: / synth: 输入先转换为实际路径（synth: 首次使用时生成片段）
+    std::string input_url, format_name;
+    if (ResolveMediaInput(url, input_url, format_name) < 0)
+        return -1;
+
+    MainController controller;
+    controller.setSinkType(type);
+    controller.setUrl(input_url.c_str(), format_name.c_str());
+
+    // 可选：视频帧导出到共享内存（先于 controller 析构，停止时关闭订阅）
+    ShmFrameExporter exporter;
+    if (shm_name) {
+        TapOptions tap_options;
+        tap_options.capacity = 2;
+        if (exporter.Start(shm_name, controller.subscribeFrames(AVMEDIA_TYPE_VIDEO, "shm", tap_options)) < 0)
+            return -1;
+    }
+
+    QueueOccupancy audio_packets, video_packets, audio_frames, video_frames;
+    int64_t samples = 0;
+
+    // 预热结束时各线程的堆分配次数与已输出帧数
+    std::map<std::string, ThreadUsage> warm_usage;
+    int64_t warm_frames = -1;
+
+    FrameLatency::Instance().Reset();
+    FramePacing::Instance().Reset();
+
+    clock::time_point start = clock::now();
+    controller.start();
+
+    // 1. 等待播放结束，期间采样队列长度
+    //    （初始化失败时播放线程会把 started 复位）
+    while (controller.isStarted() && !controller.isFinished()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_SAMPLE_INTERVAL));
+
+        PipelineStats stats = controller.GetPipelineStats();
+        audio_packets.Add(stats.audio_packet_queue_size);
+        video_packets.Add(stats.video_packet_queue_size);
+        audio_frames.Add(stats.audio_frame_queue_size);
+        video_frames.Add(stats.video_frame_queue_size);
+        samples++;
+
+        if (warm_frames < 0 && stats.video_frames_presented >= BENCH_WARMUP_FRAMES) {
+            warm_frames = stats.video_frames_presented;
+            for (const ThreadUsage& t : SampleThreadUsage())
+                warm_usage[t.name] = t;
+        }
+    }
+
+    double wall = std::chrono::duration<double>(clock::now() - start).count();
+
+    if (!controller.isStarted()) {
+        printf("bench: failed to play %s\n", url);
+        return -1;
+    }
+
+    // 2. 停止前取最终统计（停止后解复用器会被释放，线程退出后的分配会混入结果）
+    PipelineStats stats = controller.GetPipelineStats();
+    std::vector<ThreadUsage> threads = SampleThreadUsage();
+    controller.stop();
+
+    if (samples == 0)
+        samples = 1;
+
+    // 3. 输出结果
+    printf("bench: %s (%s)\n", url, mode);
+    printf("wall time          : %.3f s\n", wall);
+    printf("media time         : %.3f s (%.1fx real time)\n",
+        stats.master_clock, stats.master_clock / wall);
+    printf("packets read       : %lld\n", (long long)stats.packets_read);
+    printf("video frames       : %lld decoded, %lld presented, %.1f frames/s\n",
+        (long long)stats.video_frames_decoded, (long long)stats.video_frames_presented,
+        stats.video_frames_presented / wall);
+    printf("audio samples      : %lld decoded, %lld played, %.0f samples/s\n",
+        (long long)stats.audio_samples_decoded, (long long)stats.audio_samples_played,
+        stats.audio_samples_played / wall);
+    printf("queue avg/max      : audio pkt %.1f/%d, video pkt %.1f/%d, audio frm %.1f/%d, video frm %.1f/%d\n",
+        audio_packets.sum / (double)samples, audio_packets.max,
+        video_packets.sum / (double)samples, video_packets.max,
+        audio_frames.sum / (double)samples, audio_frames.max,
+        video_frames.sum / (double)samples, video_frames.max);
+    printf("cpu time (s)       : demux %.3f, audio decode %.3f, video decode %.3f, audio sink %.3f, video sink %.3f\n",
+        stats.demux_cpu_us / 1e6,
+        stats.audio_decode_cpu_us / 1e6,
+        stats.video_decode_cpu_us / 1e6,
+        stats.audio_sink_cpu_us / 1e6,
+        stats.video_sink_cpu_us / 1e6);
+    FrameLatency::Instance().Dump(stdout);
+    FramePacing::Instance().Dump(stdout);
+
+    // 各线程资源使用：CPU 占比高的是瓶颈，队列等待多的是饥饿，轮询唤醒多说明休眠循环在空转
+    printf("threads:\n");
+    // allocs/frm：预热后本仓库代码每输出一帧的堆分配次数，稳定播放时应为 0；
+    // lib/frm：已知的 FFmpeg 内部分配（读包、解码器输出帧的缓冲区引用、音频滤镜图等，见 allochook.h）
+    int64_t steady_frames = warm_frames < 0 ? 0 : stats.video_frames_presented - warm_frames;
+    int alloc_failures = 0;
+    printf("  %-16s %9s %6s %10s %10s %10s %9s %10s %8s\n",
+        "name", "cpu s", "cpu%", "vol cs", "invol cs", "q wait s", "sleeps/s", "allocs/frm", "lib/frm");
+    for (const ThreadUsage& t : threads) {
+        printf("  %-16s %9.3f %5.1f%% %10lld %10lld %10.3f %9.1f",
+            t.name.c_str(), t.cpu_us / 1e6, t.cpu_us / 1e4 / wall,
+            (long long)t.voluntary_switches, (long long)t.involuntary_switches,
+            t.queue_wait_us / 1e6, t.sleeps / wall);
+        auto warm = warm_usage.find(t.name);
+        if (t.heap_allocs >= 0 && steady_frames > 0 && warm != warm_usage.end()) {
+            int64_t own = t.heap_allocs - warm->second.heap_allocs;
+            int64_t lib = t.library_allocs - warm->second.library_allocs;
+            printf(" %10.2f %8.2f\n", own / (double)steady_frames, lib / (double)steady_frames);
+            if (own > 0)
+                alloc_failures++;
+        }
+        else {
+            printf(" %10s %8s\n", "-", "-");
+        }
+    }
+    if (!HeapAllocHookEnabled())
+        printf("  (heap allocation counting is not available in this build, see allochook.h)\n");
+
+    printf("metrics:\n");
+    for (const MetricValue& metric : controller.GetStats())
+        printf("  %-40s %lld\n", metric.name.c_str(), (long long)metric.value);
+
+    // 4. --assert-no-alloc：预热后本仓库代码有任何分配即失败
+    if (assert_no_alloc) {
+        if (steady_frames <= 0) {
+            printf("bench: assert-no-alloc FAILED: fewer than %d frames presented, nothing to check\n",
+                BENCH_WARMUP_FRAMES);
+            return -1;
+        }
+        if (alloc_failures > 0) {
+            printf("bench: assert-no-alloc FAILED: %d thread(s) allocate after warm-up (allocs/frm > 0)\n",
+                alloc_failures);
+            return -1;
+        }
+        printf("bench: assert-no-alloc passed (%lld steady frames)\n", (long long)steady_frames);
+    }
+
+    return 0;
+};
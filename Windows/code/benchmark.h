@@ -0,0 +1,31 @@
+﻿#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "outputsink.h"
+
+/**
+ * @brief 无界面流水线性能测试（--bench）
+ *
+ * 使用空输出端播放一个文件直到结束，期间每 10ms 采样一次队列长度，
+ * 结束后输出：
+ *   - 视频 帧/秒、音频 样本/秒（按墙上时间）
+ *   - 播放的媒体时长及其与墙上时间之比（虚拟时钟模式下远大于 1）
+ *   - 四个队列的平均 / 最大长度
+ *   - 解复用、音视频解码、音视频输出各线程的 CPU 时间
+ *   - 启用分配计数的构建（见 allochook.h）：预热后各线程每帧的堆分配次数
+ *
+ * 不需要显示器和声卡，可在 Linux CI 上运行。
+ *
+ * @param url  媒体文件路径，或 lavfi: / synth: 合成输入（见 synthmedia.h），无需准备媒体文件
+ * @param type 空输出类型：NullFast 尽可能快地消费（测最大吞吐）；NullPaced 按实时节奏消费；
+ *             NullVirtual 按虚拟时钟消费（同步行为与 NullPaced 相同，但不等待墙上时间）
+ * @param shm_name 不为空时同时把视频帧导出到该名字的共享内存帧环（见 shmexport.h），
+ *                 可另开进程用 --shm-read 读取，测量导出的开销
+ * @param assert_no_alloc 为 true 时预热后任一线程的本仓库代码还有堆分配（allocs/frm > 0）即返回失败，
+ *                        已知的 FFmpeg 内部分配不计；构建未启用分配计数时直接失败
+ * @return 成功返回0，失败返回-1
+ */
+int RunPipelineBenchmark(const char* url, SinkType type, const char* shm_name = nullptr,
+    bool assert_no_alloc = false);
+
+#endif // BENCHMARK_H
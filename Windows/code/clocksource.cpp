@@ -0,0 +1,105 @@
+﻿#include "clocksource.h"
+
+// 参与者“忙”超过该时长（墙上时间，毫秒）视为停滞，不再阻挡虚拟时间前进
+#define VIRTUAL_CLOCK_STALL_MS 200
+
+double VirtualClock::NowSec() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return now_;
+};
+
+void VirtualClock::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    now_ = 0.0;
+    for (Participant& p : participants_) {
+        p.sleeping = false;
+        p.busy_since = WallClock::now();
+    }
+    cond_.notify_all();
+};
+
+int VirtualClock::AddParticipant()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 复用已注销的位置
+    size_t id = 0;
+    while (id < participants_.size() && participants_[id].active)
+        id++;
+    if (id == participants_.size())
+        participants_.push_back(Participant());
+
+    Participant& p = participants_[id];
+    p.active = true;
+    p.sleeping = false;
+    p.busy_since = WallClock::now();
+
+    return (int)id;
+};
+
+void VirtualClock::RemoveParticipant(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id < 0 || id >= (int)participants_.size())
+        return;
+
+    participants_[id].active = false;
+    // 剩余的参与者可能都在等它
+    TryAdvance();
+};
+
+int VirtualClock::SleepUntil(int id, double target, int timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // 等待期间 participants_ 可能扩容，不能持有元素引用
+    if (target > now_) {
+        participants_[id].sleeping = true;
+        participants_[id].target = target;
+        TryAdvance();
+
+        // 等待时间被推进；超时后重新检查一次停滞的参与者
+        cond_.wait_for(lock, std::chrono::milliseconds(timeout), [this, target] {
+            return now_ >= target;
+            });
+        if (now_ < target) {
+            TryAdvance();
+            if (now_ < target)
+                return -2;
+        }
+    }
+
+    participants_[id].sleeping = false;
+    participants_[id].busy_since = WallClock::now();
+
+    return 0;
+};
+
+void VirtualClock::TryAdvance()
+{
+    WallClock::time_point wall = WallClock::now();
+    bool found = false;
+    double next = 0.0;
+
+    for (const Participant& p : participants_) {
+        if (!p.active)
+            continue;
+
+        if (p.sleeping) {
+            if (!found || p.target < next)
+                next = p.target;
+            found = true;
+        }
+        else if (wall - p.busy_since < std::chrono::milliseconds(VIRTUAL_CLOCK_STALL_MS)) {
+            // 有参与者正在处理数据，时间不能前进
+            return;
+        }
+    }
+
+    if (found && next > now_) {
+        now_ = next;
+        cond_.notify_all();
+    }
+};
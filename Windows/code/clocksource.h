@@ -0,0 +1,99 @@
+﻿#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief 时间源接口：AVSync 通过它读取“当前时间”（秒）
+ */
+class ClockSource
+{
+public:
+    virtual ~ClockSource() {};
+    virtual double NowSec() const = 0;
+};
+
+/**
+ * @brief 系统时间源（默认）：av_gettime_relative()
+ */
+class RealClock : public ClockSource
+{
+public:
+    double NowSec() const override
+    {
+        return av_gettime_relative() / 1000000.0;
+    };
+};
+
+/**
+ * @brief 虚拟时间源：时间只在所有输出端都在“等待”时才前进
+ *
+ * 原理（离散事件）：
+ *   - 每个输出端注册为一个参与者，本来要 sleep 的地方改为 SleepUntil(目标虚拟时间)
+ *   - 当所有参与者都在 SleepUntil 中时，虚拟时间直接跳到最早的目标，唤醒对应的参与者
+ *   - 参与者在处理数据或等待输入（队列为空）时视为“忙”，此时时间不前进，
+ *     相当于假设解码总能跟上实时播放，于是同步判断与实时播放完全一致
+ *   - 参与者“忙”超过 VIRTUAL_CLOCK_STALL_MS（墙上时间）仍未再次等待时视为停滞，
+ *     暂时不再阻挡时间前进（文件结束、暂停或解码确实跟不上时），下次等待时自动恢复
+ */
+class VirtualClock : public ClockSource
+{
+public:
+    VirtualClock() {};
+    ~VirtualClock() {};
+
+    double NowSec() const override;
+
+    /**
+     * @brief 时间归零，所有参与者置为“忙”（每个文件开始播放前调用）
+     */
+    void Reset();
+
+    /**
+     * @brief 注册参与者
+     * @return 参与者编号，用于 SleepUntil / RemoveParticipant
+     */
+    int AddParticipant();
+
+    /**
+     * @brief 注销参与者，不再阻挡时间前进
+     */
+    void RemoveParticipant(int id);
+
+    /**
+     * @brief 等待虚拟时间到达 target（秒）
+     * @param timeout 最长等待的墙上时间（毫秒），便于调用方检查退出标志
+     * @return 到达返回0，超时返回-2（调用方可再次调用继续等待）
+     */
+    int SleepUntil(int id, double target, int timeout);
+
+private:
+    /**
+     * @brief 如果所有参与者都在等待（或已停滞），把时间推进到最早的目标（需持锁调用）
+     */
+    void TryAdvance();
+
+private:
+    using WallClock = std::chrono::steady_clock;
+
+    struct Participant {
+        bool active = false;            // 是否已注册
+        bool sleeping = false;          // 是否在 SleepUntil 中
+        double target = 0.0;            // 等待的目标虚拟时间
+        WallClock::time_point busy_since; // 最近一次转为“忙”的墙上时间
+    };
+
+    double now_ = 0.0;                  // 当前虚拟时间（秒）
+    std::vector<Participant> participants_;
+    mutable std::mutex mutex_;          // 保护以上成员
+    std::condition_variable cond_;      // 时间前进时唤醒等待者
+};
+
+#endif // CLOCKSOURCE_H
@@ -1,5 +1,16 @@
 ﻿#include "decodethread.h"
+#include "allochook.h"
 #include "maincontroller.h"
+#include "threadutil.h"
+#include "framelatency.h"
+#include "tracing.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/time.h>
+}
 
 /**
  * @brief 构造函数
@@ -25,6 +36,57 @@ DecodeThread::~DecodeThread()
         avcodec_free_context(&codec_ctx_);
         codec_ctx_ = nullptr;
     }
+    if (par_) {
+        avcodec_parameters_free(&par_);
+    }
+};
+
+/**
+ * @brief 判断两组流参数是否可以共用同一个已打开的解码器
+ *
+ * 编码类型、extradata（SPS/PPS、AudioSpecificConfig 等）、
+ * 分辨率/像素格式、采样率/采样格式/声道布局全部一致时才认为兼容
+ */
+bool DecodeThread::IsCompatible(const AVCodecParameters* a, const AVCodecParameters* b)
+{
+    if (a->codec_type != b->codec_type || a->codec_id != b->codec_id)
+        return false;
+
+    if (a->extradata_size != b->extradata_size)
+        return false;
+    if (a->extradata_size > 0 &&
+        memcmp(a->extradata, b->extradata, a->extradata_size) != 0)
+        return false;
+
+    if (a->codec_type == AVMEDIA_TYPE_VIDEO) {
+        return a->width == b->width
+            && a->height == b->height
+            && a->format == b->format;
+    }
+
+    if (a->codec_type == AVMEDIA_TYPE_AUDIO) {
+        return a->sample_rate == b->sample_rate
+            && a->format == b->format
+            && av_channel_layout_compare(&a->ch_layout, &b->ch_layout) == 0;
+    }
+
+    return false;
+};
+
+/**
+ * @brief 解码器直接输出缩小图像的级数（lowres = n 时宽高各缩小 2^n 倍）
+ *
+ * 只有部分解码器（MJPEG 等）支持 lowres，H.264 / HEVC 的 max_lowres 为 0，由解码后下采样处理
+ */
+int DecodeThread::ChooseLowres(const AVCodec* codec, const AVCodecParameters* par) const
+{
+    if (!codec || par->codec_type != AVMEDIA_TYPE_VIDEO || target_w_ <= 0 || target_h_ <= 0)
+        return 0;
+
+    int factor = DownscaleFactor(par->width, par->height, target_w_, target_h_);
+    int lowres = factor >= 4 ? 2 : (factor >= 2 ? 1 : 0);
+
+    return std::min(lowres, (int)codec->max_lowres);
 };
 
 /**
@@ -39,10 +101,26 @@ int DecodeThread::Init(AVCodecParameters* par)
         return -1;
     }
 
-    // 2. 分配解码器上下文
+    // 2. 复用：上一个文件的解码器与新流兼容时，只清空内部缓存即可，
+    //    省去 avcodec_open2（硬件/多线程解码器的打开开销较大）
+    if (codec_ctx_ && par_ && IsCompatible(par_, par)
+        && codec_ctx_->lowres == ChooseLowres(codec_ctx_->codec, par)) {
+        avcodec_flush_buffers(codec_ctx_);
+        return 0;
+    }
+
+    // 不兼容：释放旧的解码器，重新创建
+    if (codec_ctx_) {
+        avcodec_free_context(&codec_ctx_);
+    }
+    if (par_) {
+        avcodec_parameters_free(&par_);
+    }
+
+    // 3. 分配解码器上下文
     codec_ctx_ = avcodec_alloc_context3(NULL);
 
-    // 3. 将流参数复制到解码器上下文
+    // 4. 将流参数复制到解码器上下文
     int ret = avcodec_parameters_to_context(codec_ctx_, par);
     if (ret < 0) {
         // FFmpeg 错误码转换为可读字符串
@@ -52,7 +130,7 @@ int DecodeThread::Init(AVCodecParameters* par)
         return -1;
     }
 
-    // 4. 查找解码器（根据编解码ID）
+    // 5. 查找解码器（根据编解码ID）
     const AVCodec* codec = avcodec_find_decoder(codec_ctx_->codec_id);
     if (!codec) {
         printf("avcodec_find_decoder failed\n");
@@ -60,7 +138,11 @@ int DecodeThread::Init(AVCodecParameters* par)
         return -1;
     }
 
-    // 5. 打开解码器
+    // 6. 打开解码器
+    // 让解码器把包的 opaque（延迟时间戳槽序号）带到输出帧上
+    codec_ctx_->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+    // 显示区域远小于视频时让解码器直接输出缩小的图像
+    codec_ctx_->lowres = ChooseLowres(codec, par);
     ret = avcodec_open2(codec_ctx_, codec, NULL);
     if (ret < 0) {
         av_strerror(ret, err2str, sizeof(err2str));
@@ -69,6 +151,12 @@ int DecodeThread::Init(AVCodecParameters* par)
         return -1;
     }
 
+    // 7. 保存流参数副本，供下一次 Init 判断能否复用
+    par_ = avcodec_parameters_alloc();
+    if (par_) {
+        avcodec_parameters_copy(par_, par);
+    }
+
     return 0;  // 初始化成功
 };
 
@@ -77,6 +165,10 @@ int DecodeThread::Init(AVCodecParameters* par)
  */
 int DecodeThread::Start()
 {
+    // 清除上一次 Stop() 留下的终止标志（线程对象会在多个文件间复用）
+    abort_ = 0;
+    finished_ = false;
+
     // 创建新线程，执行 Run() 方法
     thread_ = new std::thread(&DecodeThread::Run, this);
     if (!thread_) {
@@ -103,8 +195,24 @@ int DecodeThread::Stop()
 void DecodeThread::Run()
 {
     int ret = 0;
+    int64_t packets = 0;  // 已送入解码器的包数，用于控制 CPU 时间采样频率
     // 预分配一个 AVFrame 用于接收解码结果
     AVFrame* frame = av_frame_alloc();
+    // 像素格式转换的输出帧（只有显示端不支持解码输出格式时使用）
+    AVFrame* converted = av_frame_alloc();
+    // 下采样的输出帧（只有视频远大于显示区域时使用）
+    AVFrame* scaled = av_frame_alloc();
+
+    bool is_audio = codec_ctx_->codec_type == AVMEDIA_TYPE_AUDIO;
+    SetCurrentThreadName(is_audio ? "audio decode" : "video decode");
+
+    // 每帧解码耗时：自上一帧输出以来 send / receive 调用的累计时间
+    LatencyHistogram* frame_time = MetricsRegistry::Instance().GetHistogram(
+        is_audio ? "decode.audio.frame_time_us" : "decode.video.frame_time_us");
+    int64_t decode_us = 0;
+    LatencyHistogram* convert_time = MetricsRegistry::Instance().GetHistogram("video.convert_us");
+    LatencyHistogram* downscale_time = MetricsRegistry::Instance().GetHistogram("video.downscale_us");
+    MetricGauge* downscale_factor = MetricsRegistry::Instance().GetGauge("video.downscale_factor");
 
     // 主循环：持续解码直到终止
     while (1) {
@@ -119,9 +227,10 @@ void DecodeThread::Run()
         }
 
         // ===== 背压控制 =====
-        // 输出队列过多时，等待消费者处理，避免内存占用过高
-        if (frame_queue_->Size() > 10) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // 输出队列的字节数 / 时长超出限制或共享内存预算用完时，等待消费者处理（见 FrameQueueLimits）
+        if (frame_queue_->Full()) {
+            TraceScope trace("decode backpressure");
+            ThreadSleepMs(10);
             continue;
         }
 
@@ -130,9 +239,17 @@ void DecodeThread::Run()
         AVPacket* packet = packet_queue_->Pop(10);
         if (packet) {
             // 有数据包，送入解码器
-            ret = avcodec_send_packet(codec_ctx_, packet);
-            // 立即释放数据包，解码器内部会复制数据
-            av_packet_free(&packet);
+            // 空包表示文件结束：解码器进入冲刷模式，之后 receive 会依次返回剩余帧和 AVERROR_EOF
+            StampDecodeStart(packet);
+            {
+                TraceScope trace("avcodec_send_packet");
+                LibraryAllocScope lib;  // 解码器内部的包引用（见 allochook.h）
+                int64_t t0 = av_gettime_relative();
+                ret = avcodec_send_packet(codec_ctx_, packet);
+                decode_us += av_gettime_relative() - t0;
+            }
+            // 立即归还数据包，解码器内部会复制数据
+            packet_queue_->Recycle(packet);
 
             if (ret < 0) {
                 // 解码错误处理
@@ -144,19 +261,76 @@ void DecodeThread::Run()
             // ===== 接收解码帧 =====
             // 一个 packet 可能产生多个 frame（如B帧场景）
             while (true) {
-                ret = avcodec_receive_frame(codec_ctx_, frame);
+                {
+                    TraceScope trace("avcodec_receive_frame");
+                    LibraryAllocScope lib;  // 输出帧的缓冲区引用与 side data
+                    int64_t t0 = av_gettime_relative();
+                    ret = avcodec_receive_frame(codec_ctx_, frame);
+                    decode_us += av_gettime_relative() - t0;
+                }
                 if (ret == 0) {
+                    frame_time->Record(decode_us);
+                    decode_us = 0;
+                    frames_decoded_++;
+                    samples_decoded_ += frame->nb_samples;
+                    StampDecodeEnd(frame);
+
+                    // 显示端不支持该像素格式时，在这里转换（不占用渲染线程）
+                    AVFrame* output = frame;
+                    if (!is_audio && !display_formats_.empty()) {
+                        AVPixelFormat target = FrameConverter::ChooseFormat(
+                            (AVPixelFormat)frame->format, display_formats_);
+                        if (target != frame->format) {
+                            TraceScope trace("pixel convert");
+                            int64_t t0 = av_gettime_relative();
+                            if (converter_.Convert(frame, converted, target) == 0) {
+                                av_frame_unref(frame);
+                                output = converted;
+                            }
+                            convert_time->Record(av_gettime_relative() - t0);
+                        }
+                    }
+
+                    // 视频远大于显示区域时下采样，纹理上传和渲染缩放都按接近显示尺寸的图像进行
+                    if (!is_audio && target_w_ > 0) {
+                        int factor = DownscaleFactor(output->width, output->height, target_w_, target_h_);
+                        if (factor > 1 && DownscaleSupported(output->format)) {
+                            TraceScope trace("downscale");
+                            int64_t t0 = av_gettime_relative();
+                            if (scaler_.Downscale(output, scaled, factor) == 0) {
+                                av_frame_unref(output);
+                                output = scaled;
+                            }
+                            else {
+                                factor = 1;
+                            }
+                            downscale_time->Record(av_gettime_relative() - t0);
+                        }
+                        else {
+                            factor = 1;
+                        }
+                        downscale_factor->Set(factor << codec_ctx_->lowres);
+                    }
+
+                    // 订阅者拿到的是将要入队的帧（只取引用）
+                    if (tap_)
+                        tap_->Publish(output);
+
                     // 成功解码一帧，推入输出队列
-                    frame_queue_->Push(frame);
-                    // 注意：frame_queue_->Push() 会移动 frame 的引用
-                    // 所以 frame 变为空，需要重新分配
-                    frame = av_frame_alloc();  // 为下一次接收分配新frame
+                    frame_queue_->Push(output);
+                    // 注意：frame_queue_->Push() 会移动 frame 的引用，
+                    // frame 变为空帧，可以直接用于下一次接收
                     continue;
                 }
                 else if (ret == AVERROR(EAGAIN)) {
                     // 解码器需要更多输入，跳出接收循环
                     break;
                 }
+                else if (ret == AVERROR_EOF) {
+                    // 冲刷完成，所有帧都已输出
+                    abort_ = 1;
+                    break;
+                }
                 else {
                     // 其他错误（如解码器内部错误、流结束等）
                     abort_ = 1;  // 设置终止标志
@@ -165,10 +339,15 @@ void DecodeThread::Run()
                     break;
                 }
             }
+
+            // 每 16 个包采样一次线程 CPU 时间
+            if ((++packets & 15) == 0) {
+                cpu_time_us_ = CurrentThreadCpuTimeUs();
+            }
         }
         else {
             // 队列为空，短暂休眠避免CPU空转
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ThreadSleepMs(5);
         }
     }
 
@@ -177,6 +356,11 @@ void DecodeThread::Run()
     if (frame) {
         av_frame_free(&frame);
     }
+    av_frame_free(&converted);
+    av_frame_free(&scaled);
+
+    cpu_time_us_ = CurrentThreadCpuTimeUs();
+    finished_ = true;
 };
 
 /**
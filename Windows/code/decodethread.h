@@ -4,6 +4,10 @@
 #include "thread.h"
 #include "avpacketqueue.h"
 #include "avframequeue.h"
+#include "frameconvert.h"
+#include "frametap.h"
+#include <atomic>
+#include <vector>
 
 class MainController; // 前向声明
 
@@ -14,6 +18,10 @@ class MainController; // 前向声明
  *   1. 从 AVPacketQueue 获取压缩数据包 AVPacket
  *   2. 调用 FFmpeg 解码为 AVFrame
  *   3. 将解码后的帧压入 AVFrameQueue
+ *   4. 收到空包（文件结束）时冲刷解码器，取完剩余帧后结束线程
+ *   5. 视频帧的像素格式不能直接显示时，在本线程转换后再入队（见 SetDisplayFormats）
+ *   6. 视频远大于显示区域时，用解码器 lowres 或盒式下采样缩小后再入队（见 SetTargetSize）
+ *   7. 入队之前把帧的引用交给订阅者（见 SetFrameTap）
  *
  * 支持功能：
  *   - 视频/音频统一解码流程
@@ -27,24 +35,70 @@ public:
         MainController* controller);
     ~DecodeThread();
 
-    int Init(AVCodecParameters* par);   // 初始化解码器
+    int Init(AVCodecParameters* par);   // 初始化解码器（参数兼容时复用已有上下文）
     int Start();                         // 启动解码线程
     int Stop();                          // 停止线程
     void Run() override;                 // 线程主循环
 
     void Flush();                        // Flush 解码器缓冲区
 
+    /**
+     * @brief 设置显示端能直接显示的像素格式（视频，在 Start 之前调用）
+     * @param formats 为空表示不转换；否则不在列表中的帧先转换为列表中损失最小的格式
+     */
+    void SetDisplayFormats(const std::vector<AVPixelFormat>& formats) { display_formats_ = formats; }
+
+    /**
+     * @brief 设置视频在屏幕上的显示尺寸（视频，在 Init 之前调用）
+     * @param w, h 显示区域大小，0 表示不缩小
+     * 视频宽高都至少是显示尺寸的 2 倍时，解码器支持 lowres 的用 lowres 直接解出小图，
+     * 否则解码后按 2:1 / 4:1 盒式下采样，纹理上传量随之减为 1/4 或 1/16
+     */
+    void SetTargetSize(int w, int h) { target_w_ = w; target_h_ = h; }
+
+    /**
+     * @brief 设置输出帧的订阅点（在 Start 之前调用，tap 比线程活得久）
+     * 每一帧入队之前交给 tap 的订阅者（只取引用），订阅者处理慢时在各自队列里丢帧，不影响解码
+     */
+    void SetFrameTap(FrameTap* tap) { tap_ = tap; }
+    FrameTap* Tap() const { return tap_; }
+
     AVCodecContext* GetAVCodecContext(); // 获取 FFmpeg 解码上下文
 
+    // ===== 统计 =====
+    bool IsFinished() const { return finished_; }              // 线程已结束（解码到结尾或出错）
+    int64_t FramesDecoded() const { return frames_decoded_; }  // 已解码帧数
+    int64_t SamplesDecoded() const { return samples_decoded_; }// 已解码样本数（音频，每声道）
+    int64_t CpuTimeUs() const { return cpu_time_us_; }         // 解码线程 CPU 时间（微秒）
+
+private:
+    static bool IsCompatible(const AVCodecParameters* a,
+        const AVCodecParameters* b);     // 判断两组流参数能否共用一个解码器
+    int ChooseLowres(const AVCodec* codec,
+        const AVCodecParameters* par) const; // 按显示尺寸和解码器能力选择 lowres
+
 private:
     char err2str[256] = { 0 };            // 错误信息字符串缓冲
     AVCodecContext* codec_ctx_ = nullptr; // FFmpeg 解码器上下文
+    AVCodecParameters* par_ = nullptr;    // 打开 codec_ctx_ 时使用的流参数副本
 
     // ===== 队列 =====
     AVPacketQueue* packet_queue_ = nullptr; // 输入数据包队列
     AVFrameQueue* frame_queue_ = nullptr;   // 解码输出帧队列
 
     MainController* controller_ = nullptr;  // 主控制器，用于暂停/恢复判断
+
+    std::vector<AVPixelFormat> display_formats_; // 显示端支持的像素格式（空表示不转换）
+    FrameConverter converter_;                    // 像素格式转换（只在本线程使用）
+    FrameConverter scaler_;                       // 盒式下采样（只在本线程使用）
+    int target_w_ = 0;                            // 显示尺寸（0 表示不缩小）
+    int target_h_ = 0;
+    FrameTap* tap_ = nullptr;                     // 输出帧订阅点（可为空）
+
+    std::atomic<bool> finished_{ false };       // Run() 已退出
+    std::atomic<int64_t> frames_decoded_{ 0 };  // 已解码帧数
+    std::atomic<int64_t> samples_decoded_{ 0 }; // 已解码样本数
+    std::atomic<int64_t> cpu_time_us_{ 0 };     // 线程 CPU 时间（定期采样）
 };
 
 #endif // DECODETHREAD_H
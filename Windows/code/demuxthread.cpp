@@ -1,11 +1,21 @@
 ﻿#include "demuxthread.h"
+#include "allochook.h"
 #include "maincontroller.h"
+#include "threadutil.h"
+#include "framelatency.h"
+#include "tracing.h"
+#include "packetarena.h"
 #include <cstdio>
 
 extern "C" {
 #include <libavutil/error.h>
 }
 
+// 每个包队列最多缓存的包数
+#define DEMUX_MAX_PACKETS 100
+// 音视频包队列合计的字节预算（与 ffplay 的 MAX_QUEUE_SIZE 相同），同时作为包缓冲池的缓存上限
+#define DEMUX_MAX_BYTES (15 * 1024 * 1024)
+
 /*
  * 备用空构造函数：
  * 用于先创建对象，再通过其它方式设置队列和 controller
@@ -43,7 +53,7 @@ DemuxThread::~DemuxThread()
 /*
  * Init —— 打开媒体文件，查找音/视频流
  */
-int DemuxThread::Init(const char* url)
+int DemuxThread::Init(const char* url, const char* format_name)
 {
     // 1. 参数检查：确保url不为空
     if (!url) {
@@ -61,7 +71,12 @@ int DemuxThread::Init(const char* url)
     }
 
     // 3. 打开输入媒体文件
-    int ret = avformat_open_input(&ifmt_ctx_, url, NULL, NULL);
+    // 已知容器格式时直接指定，省去读取文件头逐个匹配 demuxer 的探测过程
+    const AVInputFormat* ifmt = nullptr;
+    if (format_name && format_name[0]) {
+        ifmt = av_find_input_format(format_name);
+    }
+    int ret = avformat_open_input(&ifmt_ctx_, url, ifmt, NULL);
     if (ret < 0) {
         // 将FFmpeg错误码转换为可读字符串
         av_strerror(ret, err2str_, sizeof(err2str_));
@@ -109,6 +124,7 @@ int DemuxThread::Start()
 {
     // 重置终止标志为false（确保线程可以运行）
     abort_.store(false);
+    eof_.store(false);
 
     // 创建线程，将Run()方法作为线程函数
     // &DemuxThread::Run - 成员函数指针
@@ -192,15 +208,22 @@ AVRational DemuxThread::VideoStreamTimebase()
  *
  * 逻辑：
  *   1. 等待暂停解除（controller 控制）
- *   2. 检查队列容量，避免堆积过多（>100）
+ *   2. 检查队列容量，避免堆积过多（包数或字节数超出预算）
  *   3. 调用 av_read_frame 读取 AVPacket
  *   4. 根据流索引分发到 audio/video 队列
+ *   5. 读到结尾后向两个队列各放入一个空包，通知解码线程冲刷解码器
  */
 void DemuxThread::Run()
 {
     AVPacket packet;  // 本地AVPacket变量（在栈上分配）
     int ret = 0;      // 返回值变量
 
+    SetCurrentThreadName("demux");
+
+    // 包缓冲池的缓存上限与队列字节预算一致：池占用的内存最多约为两倍预算
+    PacketArena& arena = PacketArena::Instance();
+    arena.SetCacheLimit(DEMUX_MAX_BYTES);
+
     // 主循环：持续运行直到终止标志被设置
     while (!abort_.load()) {
 
@@ -225,31 +248,59 @@ void DemuxThread::Run()
         // 检查队列指针是否有效
         if (!local_aq || !local_vq) {
             // 队列指针无效，短暂休眠后重试
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ThreadSleepMs(5);
             continue;
         }
 
         // ====== 流量控制：避免队列积压太大 ======
         // 如果队列中已有大量未处理的数据包，等待消费者处理
-        if (local_aq->Size() > 100 || local_vq->Size() > 100) {
+        if (local_aq->Size() > DEMUX_MAX_PACKETS || local_vq->Size() > DEMUX_MAX_PACKETS
+            || local_aq->Bytes() + local_vq->Bytes() > DEMUX_MAX_BYTES) {
             // 队列较满，短暂休眠避免内存过度占用
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            TraceScope trace("demux backpressure");
+            ThreadSleepMs(10);
             continue;
         }
 
         // ====== 读取AVPacket ======
         // av_read_frame从媒体文件中读取下一个数据包
         // 返回0表示成功，<0表示错误或文件结束
-        ret = av_read_frame(ifmt_ctx_, &packet);
+        {
+            TraceScope trace("av_read_frame");
+            LibraryAllocScope lib;  // 包负载与 AVBufferRef（见 allochook.h）
+            ret = av_read_frame(ifmt_ctx_, &packet);
+        }
         if (ret < 0) {
             // 读取失败：可能是文件结束（AVERROR_EOF）或其他错误
             char ebuf[128];
             av_strerror(ret, ebuf, sizeof(ebuf));
-            printf("%s(%d) av_read_frame failed:%d, %s\n",
-                __FUNCTION__, __LINE__, ret, ebuf);
+            if (ret != AVERROR_EOF) {
+                printf("%s(%d) av_read_frame failed:%d, %s\n",
+                    __FUNCTION__, __LINE__, ret, ebuf);
+            }
+
+            // 空包（data == NULL, size == 0）作为结束标记，
+            // 解码线程收到后取出解码器内缓存的剩余帧
+            // （av_read_frame 失败时 packet 已是空包，Push 移走引用后仍为空包）
+            local_aq->Push(&packet);
+            local_vq->Push(&packet);
+
+            eof_.store(true);
             break;  // 退出主循环
         }
 
+        // 音视频包的负载搬进缓冲池，避免长时间运行后堆碎片化（见 packetarena.h）
+        if (packet.stream_index == audio_stream_ || packet.stream_index == video_stream_)
+            arena.Adopt(&packet);
+
+        // 记录读取时间，时间戳随包 / 帧一直传到显示（见 framelatency.h）
+        StampPacketRead(&packet);
+
+        // 每 64 个包采样一次线程 CPU 时间
+        if ((++packets_read_ & 63) == 0) {
+            cpu_time_us_ = CurrentThreadCpuTimeUs();
+        }
+
         // ====== 分发数据包到相应队列 ======
         // 根据数据包所属的流索引分发到对应的队列
         if (packet.stream_index == audio_stream_) {
@@ -265,4 +316,6 @@ void DemuxThread::Run()
             av_packet_unref(&packet);
         }
     }
+
+    cpu_time_us_ = CurrentThreadCpuTimeUs();
 };
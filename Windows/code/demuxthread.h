@@ -35,7 +35,8 @@ public:
     ~DemuxThread();
 
     // 初始化输入媒体（打开文件 + 找到音视频流）
-    int Init(const char* url);
+    // format_name 为已知的容器格式短名（来自探测缓存），非空时跳过格式探测
+    int Init(const char* url, const char* format_name = nullptr);
 
     // 启动/停止线程
     int Start();
@@ -52,12 +53,21 @@ public:
     AVRational AudioStreamTimebase();// 获取音频流时间基
     AVRational VideoStreamTimebase();// 获取视频流时间基
 
+    // ===== 统计 =====
+    bool IsEof() const { return eof_; }             // 是否已读到文件结尾（或读取出错）
+    int64_t PacketsRead() const { return packets_read_; } // 已读取的数据包数
+    int64_t CpuTimeUs() const { return cpu_time_us_; }    // 解复用线程 CPU 时间（微秒）
+
 private:
     void Run();                            // 线程主循环
 
 private:
     std::thread thread_;                   // demux 后台线程
     std::atomic<bool> abort_{ false };     // 退出标志
+    std::atomic<bool> eof_{ false };       // 读到文件结尾标志
+
+    std::atomic<int64_t> packets_read_{ 0 }; // 已读取的数据包数
+    std::atomic<int64_t> cpu_time_us_{ 0 };  // 线程 CPU 时间（定期采样）
 
     AVFormatContext* ifmt_ctx_ = nullptr;  // 输入媒体上下文
 
@@ -0,0 +1,298 @@
+﻿#include "depthconvert.h"
+
+extern "C" {
+#include "libavutil/cpu.h"
+}
+
+// x86：x64 和开启 /arch:SSE2 的 32 位目标一定有 SSE2；AVX2 按函数单独编译，运行时检测后才调用
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEPTH_HAVE_SSE2 1
+#define DEPTH_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// ARM：aarch64 一定有 NEON，32 位 ARM 需要编译时开启
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define DEPTH_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC / Clang 需要给 AVX2 函数单独指定目标指令集，MSVC 不需要
+#if defined(__GNUC__) || defined(__clang__)
+#define DEPTH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DEPTH_TARGET_AVX2
+#endif
+
+namespace {
+
+/**
+ * 支持的高位深格式：shift 为转换到 8 位需要右移的位数
+ * p010 / p016 的样本在 16 位的高位（p010 低 6 位为 0），都右移 8 位
+ */
+const struct DepthFormat {
+    AVPixelFormat src;
+    AVPixelFormat dst;
+    int shift;
+} kDepthFormats[] = {
+    { AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P, 2 },
+    { AV_PIX_FMT_YUV420P12LE, AV_PIX_FMT_YUV420P, 4 },
+    { AV_PIX_FMT_P010LE,      AV_PIX_FMT_NV12,    8 },
+    { AV_PIX_FMT_P016LE,      AV_PIX_FMT_NV12,    8 },
+};
+
+/**
+ * 8x8 Bayer 有序抖动矩阵（0 ~ 63）
+ */
+const uint8_t kBayer8[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+const DepthFormat* FindDepthFormat(int src_format)
+{
+    for (const auto& entry : kDepthFormats) {
+        if (entry.src == src_format)
+            return &entry;
+    }
+
+    return nullptr;
+};
+
+// ============================================================================
+//                                  行内核
+// 各内核转换 [start, count) 中的样本，SIMD 内核把放不满一个向量的尾部交给标量内核
+// ============================================================================
+
+void RowScalar(const uint16_t* src, uint8_t* dst, int start, int count, int shift, const uint16_t bias[8])
+{
+    for (int i = start; i < count; i++) {
+        uint32_t v = ((uint32_t)src[i] + bias[i & 7]) >> shift;
+        dst[i] = (uint8_t)(v > 255 ? 255 : v);
+    }
+};
+
+#if DEPTH_HAVE_SSE2
+/**
+ * 每次 16 个样本：饱和加偏置、右移、有符号饱和打包
+ * （shift >= 2，右移后不超过 16383，按有符号数打包也不会出错）
+ */
+void RowSse2(const uint16_t* src, uint8_t* dst, int start, int count, int shift, const uint16_t bias[8])
+{
+    const __m128i b = _mm_loadu_si128((const __m128i*)bias);
+    const __m128i s = _mm_cvtsi32_si128(shift);
+
+    int i = start;
+    for (; i + 16 <= count; i += 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        lo = _mm_srl_epi16(_mm_adds_epu16(lo, b), s);
+        hi = _mm_srl_epi16(_mm_adds_epu16(hi, b), s);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    RowScalar(src, dst, i, count, shift, bias);
+};
+#endif
+
+#if DEPTH_HAVE_AVX2
+/**
+ * 每次 32 个样本；_mm256_packus_epi16 在两个 128 位通道内分别打包，结果要按 64 位重排
+ */
+DEPTH_TARGET_AVX2
+void RowAvx2(const uint16_t* src, uint8_t* dst, int start, int count, int shift, const uint16_t bias[8])
+{
+    const __m256i b = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)bias));
+    const __m128i s = _mm_cvtsi32_si128(shift);
+
+    int i = start;
+    for (; i + 32 <= count; i += 32) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+        lo = _mm256_srl_epi16(_mm256_adds_epu16(lo, b), s);
+        hi = _mm256_srl_epi16(_mm256_adds_epu16(hi, b), s);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    RowSse2(src, dst, i, count, shift, bias);
+};
+#endif
+
+#if DEPTH_HAVE_NEON
+/**
+ * 每次 16 个样本：饱和加偏置、右移（左移负数位）、无符号饱和收窄
+ */
+void RowNeon(const uint16_t* src, uint8_t* dst, int start, int count, int shift, const uint16_t bias[8])
+{
+    const uint16x8_t b = vld1q_u16(bias);
+    const int16x8_t s = vdupq_n_s16((int16_t)-shift);
+
+    int i = start;
+    for (; i + 16 <= count; i += 16) {
+        uint16x8_t lo = vshlq_u16(vqaddq_u16(vld1q_u16(src + i), b), s);
+        uint16x8_t hi = vshlq_u16(vqaddq_u16(vld1q_u16(src + i + 8), b), s);
+        vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+    }
+    RowScalar(src, dst, i, count, shift, bias);
+};
+#endif
+
+/**
+ * Auto 和不可用的内核换成实际使用的内核
+ */
+DepthKernel ResolveKernel(DepthKernel kernel)
+{
+    if (kernel == DepthKernel::Auto) {
+        static const DepthKernel best =
+            DepthKernelAvailable(DepthKernel::Avx2) ? DepthKernel::Avx2 :
+            DepthKernelAvailable(DepthKernel::Sse2) ? DepthKernel::Sse2 :
+            DepthKernelAvailable(DepthKernel::Neon) ? DepthKernel::Neon : DepthKernel::Scalar;
+        return best;
+    }
+
+    return DepthKernelAvailable(kernel) ? kernel : DepthKernel::Scalar;
+};
+
+/**
+ * 单个平面的转换描述
+ */
+struct DepthPlane {
+    const uint8_t* src;
+    int src_stride;     // 字节
+    uint8_t* dst;
+    int dst_stride;
+    int samples;        // 每行样本数（nv12 的 UV 平面为两倍色度宽度）
+    int rows;
+};
+
+} // namespace
+
+const char* DepthKernelName(DepthKernel kernel)
+{
+    switch (ResolveKernel(kernel)) {
+    case DepthKernel::Sse2: return "sse2";
+    case DepthKernel::Avx2: return "avx2";
+    case DepthKernel::Neon: return "neon";
+    default: return "scalar";
+    }
+};
+
+bool DepthKernelAvailable(DepthKernel kernel)
+{
+    switch (kernel) {
+    case DepthKernel::Auto:
+    case DepthKernel::Scalar:
+        return true;
+#if DEPTH_HAVE_SSE2
+    case DepthKernel::Sse2:
+        return true;
+#endif
+#if DEPTH_HAVE_AVX2
+    case DepthKernel::Avx2: {
+        // av_get_cpu_flags 同时检查了操作系统是否保存 YMM 寄存器
+        static const bool avx2 = (av_get_cpu_flags() & AV_CPU_FLAG_AVX2) != 0;
+        return avx2;
+    }
+#endif
+#if DEPTH_HAVE_NEON
+    case DepthKernel::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+};
+
+AVPixelFormat DepthConvertTarget(AVPixelFormat src_format)
+{
+    const DepthFormat* format = FindDepthFormat(src_format);
+    return format ? format->dst : AV_PIX_FMT_NONE;
+};
+
+void DepthConvertRow(const uint16_t* src, uint8_t* dst, int count, int shift,
+    const uint16_t bias[8], DepthKernel kernel)
+{
+    switch (ResolveKernel(kernel)) {
+#if DEPTH_HAVE_AVX2
+    case DepthKernel::Avx2:
+        RowAvx2(src, dst, 0, count, shift, bias);
+        break;
+#endif
+#if DEPTH_HAVE_SSE2
+    case DepthKernel::Sse2:
+        RowSse2(src, dst, 0, count, shift, bias);
+        break;
+#endif
+#if DEPTH_HAVE_NEON
+    case DepthKernel::Neon:
+        RowNeon(src, dst, 0, count, shift, bias);
+        break;
+#endif
+    default:
+        RowScalar(src, dst, 0, count, shift, bias);
+        break;
+    }
+};
+
+int DepthConvertFrame(const AVFrame* src, AVFrame* dst, bool dither, ThreadPool* pool,
+    DepthKernel kernel)
+{
+    const DepthFormat* format = FindDepthFormat(src->format);
+    if (!format || dst->format != format->dst || dst->width != src->width || dst->height != src->height)
+        return -1;
+
+    kernel = ResolveKernel(kernel);
+    int shift = format->shift;
+
+    // 1. 每行的偏置：抖动时取 Bayer 矩阵对应行并缩放到 [0, 1 << shift)，否则为四舍五入
+    uint16_t bias[8][8];
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++)
+            bias[y][x] = dither ? (uint16_t)((kBayer8[y][x] << shift) >> 6) : (uint16_t)(1 << (shift - 1));
+    }
+
+    // 2. 平面：亮度 + 两个色度平面（yuv420p）或一个交织的 UV 平面（nv12）
+    int w = src->width;
+    int h = src->height;
+    int cw = (w + 1) >> 1;
+    int ch = (h + 1) >> 1;
+    DepthPlane planes[3];
+    int count = 0;
+    planes[count++] = { src->data[0], src->linesize[0], dst->data[0], dst->linesize[0], w, h };
+    if (format->dst == AV_PIX_FMT_NV12) {
+        planes[count++] = { src->data[1], src->linesize[1], dst->data[1], dst->linesize[1], cw * 2, ch };
+    }
+    else {
+        planes[count++] = { src->data[1], src->linesize[1], dst->data[1], dst->linesize[1], cw, ch };
+        planes[count++] = { src->data[2], src->linesize[2], dst->data[2], dst->linesize[2], cw, ch };
+    }
+
+    // 3. 转换：每段处理各平面中相同比例的行
+    auto convert = [&](int band, int bands) {
+        for (int i = 0; i < count; i++) {
+            const DepthPlane& plane = planes[i];
+            int begin = (int)((int64_t)plane.rows * band / bands);
+            int end = (int)((int64_t)plane.rows * (band + 1) / bands);
+            for (int row = begin; row < end; row++) {
+                DepthConvertRow((const uint16_t*)(plane.src + (int64_t)row * plane.src_stride),
+                    plane.dst + (int64_t)row * plane.dst_stride,
+                    plane.samples, shift, bias[row & 7], kernel);
+            }
+        }
+    };
+
+    if (!pool || (int64_t)w * h < DEPTH_PARALLEL_PIXELS) {
+        convert(0, 1);
+        return 0;
+    }
+
+    int bands = pool->ThreadCount() + 1;
+    pool->ParallelFor(bands, [&](int band) { convert(band, bands); });
+
+    return 0;
+};
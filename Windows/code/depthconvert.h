@@ -0,0 +1,65 @@
+﻿#ifndef DEPTHCONVERT_H
+#define DEPTHCONVERT_H
+
+#include "threadpool.h"
+#include <cstdint>
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+}
+
+// 达到该像素数（4K）时才把位深转换分给线程池
+#define DEPTH_PARALLEL_PIXELS (3840 * 2160)
+
+/**
+ * @brief 位深转换使用的行内核
+ *
+ * Auto 在运行时选择当前 CPU 上最快的一个（AVX2 > SSE2 / NEON > 标量），
+ * 其他值用于基准测试和结果比对；编译目标不支持的内核退回标量实现
+ */
+enum class DepthKernel {
+    Auto,
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon,
+};
+
+const char* DepthKernelName(DepthKernel kernel);
+
+/**
+ * @brief 内核在当前编译目标和 CPU 上是否可用（Auto / Scalar 总是可用）
+ */
+bool DepthKernelAvailable(DepthKernel kernel);
+
+/**
+ * @brief 高位深 4:2:0 格式对应的 8 位格式
+ *
+ * yuv420p10le / yuv420p12le 转为 yuv420p，p010le / p016le 转为 nv12；
+ * 其他格式返回 AV_PIX_FMT_NONE（交给 sws_scale）
+ */
+AVPixelFormat DepthConvertTarget(AVPixelFormat src_format);
+
+/**
+ * @brief 转换一行 16 位样本：dst[i] = min(255, (src[i] + bias[i % 8]) >> shift)
+ *
+ * bias 为 1 << (shift - 1) 时是四舍五入，为有序抖动矩阵的一行时是抖动；
+ * 加法饱和到 65535，p016 的高端样本不会回绕
+ */
+void DepthConvertRow(const uint16_t* src, uint8_t* dst, int count, int shift,
+    const uint16_t bias[8], DepthKernel kernel = DepthKernel::Auto);
+
+/**
+ * @brief 把高位深帧的像素数据转换到 dst（只写像素，不处理帧属性）
+ *
+ * @param src    yuv420p10le / yuv420p12le / p010le / p016le 帧
+ * @param dst    已分配好缓冲区的 DepthConvertTarget(src->format) 帧，尺寸与 src 相同
+ * @param dither true 使用 8x8 有序抖动（Bayer 矩阵），false 四舍五入
+ * @param pool   线程池，可为空；帧达到 DEPTH_PARALLEL_PIXELS 时按行分段并行
+ * @return 成功返回0，格式不支持返回-1
+ */
+int DepthConvertFrame(const AVFrame* src, AVFrame* dst, bool dither, ThreadPool* pool,
+    DepthKernel kernel = DepthKernel::Auto);
+
+#endif // DEPTHCONVERT_H
@@ -0,0 +1,239 @@
+﻿#include "downscale.h"
+
+extern "C" {
+#include "libavutil/pixfmt.h"
+}
+
+// 与 depthconvert.cpp 相同的指令集判断：x64 / SSE2 目标用 SSE2，ARM 用 NEON
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DOWNSCALE_HAVE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define DOWNSCALE_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// ============================================================================
+//                                  行内核
+// rows 为参与平均的 factor 个源行，输出 [start, count) 个样本；
+// SIMD 内核只处理单通道平面，放不满一个向量的尾部交给标量内核
+// ============================================================================
+
+/**
+ * 通用实现：channels 为交织的通道数（nv12 的 UV 平面为 2）
+ */
+void BoxRowScalar(const uint8_t* const* rows, int factor, int channels, uint8_t* dst, int start, int count)
+{
+    int shift = factor == 4 ? 4 : 2;
+    int round = 1 << (shift - 1);
+    for (int o = start; o < count; o++) {
+        int x = o / channels;
+        int c = o - x * channels;
+        int sum = round;
+        for (int i = 0; i < factor; i++) {
+            const uint8_t* p = rows[i] + (x * factor) * channels + c;
+            for (int j = 0; j < factor; j++)
+                sum += p[j * channels];
+        }
+        dst[o] = (uint8_t)(sum >> shift);
+    }
+};
+
+#if DOWNSCALE_HAVE_SSE2
+/**
+ * 2:1，每次 16 个输出：16 位通道里低字节 + 高字节即相邻两个像素之和
+ */
+void Box2RowSse2(const uint8_t* const* rows, uint8_t* dst, int count)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    const __m128i round = _mm_set1_epi16(2);
+
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(rows[0] + 2 * x));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(rows[0] + 2 * x + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(rows[1] + 2 * x));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(rows[1] + 2 * x + 16));
+        __m128i lo = _mm_add_epi16(
+            _mm_add_epi16(_mm_and_si128(a0, mask), _mm_srli_epi16(a0, 8)),
+            _mm_add_epi16(_mm_and_si128(b0, mask), _mm_srli_epi16(b0, 8)));
+        __m128i hi = _mm_add_epi16(
+            _mm_add_epi16(_mm_and_si128(a1, mask), _mm_srli_epi16(a1, 8)),
+            _mm_add_epi16(_mm_and_si128(b1, mask), _mm_srli_epi16(b1, 8)));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 2);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    BoxRowScalar(rows, 2, 1, dst, x, count);
+};
+
+/**
+ * 4:1，每次 8 个输出：先按 2:1 的方法得到四行的两两之和，再用 madd 把相邻两个通道相加
+ */
+void Box4RowSse2(const uint8_t* const* rows, uint8_t* dst, int count)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i round = _mm_set1_epi16(8);
+
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        for (int i = 0; i < 4; i++) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(rows[i] + 4 * x));
+            __m128i b = _mm_loadu_si128((const __m128i*)(rows[i] + 4 * x + 16));
+            lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)));
+            hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+        }
+        __m128i sum = _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 4);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(sum, sum));
+    }
+    BoxRowScalar(rows, 4, 1, dst, x, count);
+};
+#endif
+
+#if DOWNSCALE_HAVE_NEON
+/**
+ * 2:1，每次 16 个输出：vpaddl / vpadal 相邻两个字节求和并累加，vrshrn 四舍五入收窄
+ */
+void Box2RowNeon(const uint8_t* const* rows, uint8_t* dst, int count)
+{
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        uint16x8_t lo = vpaddlq_u8(vld1q_u8(rows[0] + 2 * x));
+        uint16x8_t hi = vpaddlq_u8(vld1q_u8(rows[0] + 2 * x + 16));
+        lo = vpadalq_u8(lo, vld1q_u8(rows[1] + 2 * x));
+        hi = vpadalq_u8(hi, vld1q_u8(rows[1] + 2 * x + 16));
+        vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+    BoxRowScalar(rows, 2, 1, dst, x, count);
+};
+
+/**
+ * 4:1，每次 8 个输出：四行两两之和累加后，vpadd 再把相邻两个通道相加
+ */
+void Box4RowNeon(const uint8_t* const* rows, uint8_t* dst, int count)
+{
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        uint16x8_t lo = vdupq_n_u16(0);
+        uint16x8_t hi = vdupq_n_u16(0);
+        for (int i = 0; i < 4; i++) {
+            lo = vpadalq_u8(lo, vld1q_u8(rows[i] + 4 * x));
+            hi = vpadalq_u8(hi, vld1q_u8(rows[i] + 4 * x + 16));
+        }
+        uint16x8_t sum = vcombine_u16(vpadd_u16(vget_low_u16(lo), vget_high_u16(lo)),
+            vpadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+        vst1_u8(dst + x, vrshrn_n_u16(sum, 4));
+    }
+    BoxRowScalar(rows, 4, 1, dst, x, count);
+};
+#endif
+
+void BoxRow(const uint8_t* const* rows, int factor, int channels, uint8_t* dst, int count)
+{
+#if DOWNSCALE_HAVE_SSE2
+    if (channels == 1) {
+        factor == 2 ? Box2RowSse2(rows, dst, count) : Box4RowSse2(rows, dst, count);
+        return;
+    }
+#elif DOWNSCALE_HAVE_NEON
+    if (channels == 1) {
+        factor == 2 ? Box2RowNeon(rows, dst, count) : Box4RowNeon(rows, dst, count);
+        return;
+    }
+#endif
+    BoxRowScalar(rows, factor, channels, dst, 0, count);
+};
+
+/**
+ * 单个平面的下采样描述
+ */
+struct BoxPlane {
+    const uint8_t* src;
+    int src_stride;
+    uint8_t* dst;
+    int dst_stride;
+    int channels;   // 交织的通道数
+    int width;      // 输出宽度（像素）
+    int rows;       // 输出行数
+};
+
+} // namespace
+
+int DownscaleFactor(int src_w, int src_h, int dst_w, int dst_h)
+{
+    if (dst_w <= 0 || dst_h <= 0)
+        return 1;
+
+    for (int factor = 4; factor > 1; factor /= 2) {
+        if (src_w / factor >= dst_w && src_h / factor >= dst_h)
+            return factor;
+    }
+
+    return 1;
+};
+
+bool DownscaleSupported(int format)
+{
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P
+        || format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_NV21;
+};
+
+void DownscaleSize(int src_w, int src_h, int factor, int* w, int* h)
+{
+    *w = (src_w / factor) & ~1;
+    *h = (src_h / factor) & ~1;
+};
+
+int DownscaleFrame(const AVFrame* src, AVFrame* dst, int factor, ThreadPool* pool)
+{
+    int w = 0;
+    int h = 0;
+    DownscaleSize(src->width, src->height, factor, &w, &h);
+    if ((factor != 2 && factor != 4) || !DownscaleSupported(src->format) || dst->format != src->format
+        || dst->width != w || dst->height != h || w <= 0 || h <= 0)
+        return -1;
+
+    // 1. 平面：亮度 + 两个色度平面（yuv420p）或一个交织的 UV 平面（nv12 / nv21）
+    BoxPlane planes[3];
+    int count = 0;
+    planes[count++] = { src->data[0], src->linesize[0], dst->data[0], dst->linesize[0], 1, w, h };
+    if (src->format == AV_PIX_FMT_NV12 || src->format == AV_PIX_FMT_NV21) {
+        planes[count++] = { src->data[1], src->linesize[1], dst->data[1], dst->linesize[1], 2, w / 2, h / 2 };
+    }
+    else {
+        planes[count++] = { src->data[1], src->linesize[1], dst->data[1], dst->linesize[1], 1, w / 2, h / 2 };
+        planes[count++] = { src->data[2], src->linesize[2], dst->data[2], dst->linesize[2], 1, w / 2, h / 2 };
+    }
+
+    // 2. 下采样：每段处理各平面中相同比例的输出行
+    auto scale = [&](int band, int bands) {
+        for (int i = 0; i < count; i++) {
+            const BoxPlane& plane = planes[i];
+            int begin = (int)((int64_t)plane.rows * band / bands);
+            int end = (int)((int64_t)plane.rows * (band + 1) / bands);
+            for (int row = begin; row < end; row++) {
+                const uint8_t* rows[4];
+                for (int k = 0; k < factor; k++)
+                    rows[k] = plane.src + (int64_t)(row * factor + k) * plane.src_stride;
+                BoxRow(rows, factor, plane.channels,
+                    plane.dst + (int64_t)row * plane.dst_stride, plane.width * plane.channels);
+            }
+        }
+    };
+
+    if (!pool || (int64_t)src->width * src->height < DOWNSCALE_PARALLEL_PIXELS) {
+        scale(0, 1);
+        return 0;
+    }
+
+    int bands = pool->ThreadCount() + 1;
+    pool->ParallelFor(bands, [&](int band) { scale(band, bands); });
+
+    return 0;
+};
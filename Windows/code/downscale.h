@@ -0,0 +1,44 @@
+﻿#ifndef DOWNSCALE_H
+#define DOWNSCALE_H
+
+#include "threadpool.h"
+
+extern "C" {
+#include "libavutil/frame.h"
+}
+
+// 源帧达到该像素数（4K）时才把下采样分给线程池
+#define DOWNSCALE_PARALLEL_PIXELS (3840 * 2160)
+
+/**
+ * @brief 源尺寸缩小到显示尺寸可用的整数倍数（1、2 或 4）
+ *
+ * 取缩小后宽高仍不小于显示尺寸的最大倍数，保证不丢失屏幕上能看到的细节；
+ * 显示尺寸无效时返回 1
+ */
+int DownscaleFactor(int src_w, int src_h, int dst_w, int dst_h);
+
+/**
+ * @brief 是否支持该像素格式的盒式下采样（yuv420p / yuvj420p / nv12 / nv21）
+ */
+bool DownscaleSupported(int format);
+
+/**
+ * @brief 按 factor 缩小后的尺寸：宽高各除以 factor 后向下取偶数，保证色度平面能整块取样
+ */
+void DownscaleSize(int src_w, int src_h, int factor, int* w, int* h);
+
+/**
+ * @brief 2:1 / 4:1 盒式下采样：每个输出像素取 factor x factor 个源像素的平均值（四舍五入）
+ *
+ * 行内核有 SSE2 / NEON 实现，nv12 / nv21 的交织色度平面用标量实现
+ *
+ * @param src    DownscaleSupported 的帧
+ * @param dst    已分配好缓冲区、格式与 src 相同、尺寸为 DownscaleSize 结果的帧（只写像素）
+ * @param factor 2 或 4
+ * @param pool   线程池，可为空；源帧达到 DOWNSCALE_PARALLEL_PIXELS 时按行分段并行
+ * @return 成功返回0，参数不支持返回-1
+ */
+int DownscaleFrame(const AVFrame* src, AVFrame* dst, int factor, ThreadPool* pool);
+
+#endif // DOWNSCALE_H
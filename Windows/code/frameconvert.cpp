@@ -0,0 +1,134 @@
+﻿#include "frameconvert.h"
+#include "allochook.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/imgutils.h"
+}
+
+// 输出图像的行对齐（字节）
+#define CONVERT_ALIGN 64
+// 位深转换线程池的工作线程数（调用线程也参与）
+#define CONVERT_POOL_THREADS 2
+
+FrameConverter::~FrameConverter()
+{
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+    av_buffer_pool_uninit(&pool_);
+    delete workers_;
+    workers_ = nullptr;
+};
+
+AVPixelFormat FrameConverter::ChooseFormat(AVPixelFormat src_format,
+    const std::vector<AVPixelFormat>& formats)
+{
+    if (formats.empty() || std::find(formats.begin(), formats.end(), src_format) != formats.end())
+        return src_format;
+
+    // 高位深 4:2:0 优先选择能走 SIMD 位深转换的 8 位格式
+    AVPixelFormat fast = DepthConvertTarget(src_format);
+    if (fast != AV_PIX_FMT_NONE && std::find(formats.begin(), formats.end(), fast) != formats.end())
+        return fast;
+
+    // avcodec_find_best_pix_fmt_of_list 需要以 AV_PIX_FMT_NONE 结尾的列表
+    std::vector<AVPixelFormat> list(formats);
+    list.push_back(AV_PIX_FMT_NONE);
+
+    return avcodec_find_best_pix_fmt_of_list(list.data(), src_format, 0, NULL);
+};
+
+int FrameConverter::Convert(const AVFrame* src, AVFrame* dst, AVPixelFormat dst_format)
+{
+    int w = src->width;
+    int h = src->height;
+    bool depth_only = DepthConvertTarget((AVPixelFormat)src->format) == dst_format;
+
+    // 1. 转换上下文：参数不变时返回原来的上下文（只降位深时不需要）
+    if (!depth_only) {
+        sws_ctx_ = sws_getCachedContext(sws_ctx_,
+            w, h, (AVPixelFormat)src->format,
+            w, h, dst_format,
+            SWS_BILINEAR, NULL, NULL, NULL);
+        if (!sws_ctx_) {
+            printf("sws_getCachedContext failed\n");
+            return -1;
+        }
+    }
+
+    // 2. 输出帧
+    if (AllocFrame(src, dst, dst_format, w, h) < 0)
+        return -1;
+
+    // 3. 转换
+    if (depth_only)
+        return DepthConvertFrame(src, dst, dither_, Workers((int64_t)w * h >= DEPTH_PARALLEL_PIXELS));
+
+    sws_scale(sws_ctx_, (const uint8_t* const*)src->data, src->linesize, 0, h,
+        dst->data, dst->linesize);
+
+    return 0;
+};
+
+int FrameConverter::Downscale(const AVFrame* src, AVFrame* dst, int factor)
+{
+    int w = 0;
+    int h = 0;
+    DownscaleSize(src->width, src->height, factor, &w, &h);
+    if (AllocFrame(src, dst, (AVPixelFormat)src->format, w, h) < 0)
+        return -1;
+
+    return DownscaleFrame(src, dst, factor,
+        Workers((int64_t)src->width * src->height >= DOWNSCALE_PARALLEL_PIXELS));
+};
+
+int FrameConverter::AllocFrame(const AVFrame* src, AVFrame* dst, AVPixelFormat format, int w, int h)
+{
+    // 1. 输出缓冲区：图像大小变化时重建缓冲区池
+    int size = av_image_get_buffer_size(format, w, h, CONVERT_ALIGN);
+    if (size < 0)
+        return -1;
+    if (!pool_ || size != pool_size_) {
+        av_buffer_pool_uninit(&pool_);
+        pool_ = av_buffer_pool_init(size, NULL);
+        pool_size_ = size;
+        if (!pool_)
+            return -1;
+    }
+
+    // 池中的缓冲区不再分配，但每次交出都要分配一个 AVBufferRef；side data 复制同样在库内分配（见 allochook.h）
+    AVBufferRef* buf;
+    {
+        LibraryAllocScope lib;
+        buf = av_buffer_pool_get(pool_);
+    }
+    if (!buf)
+        return -1;
+
+    // 2. 输出帧：属性来自原帧，数据指向池中的缓冲区
+    av_frame_unref(dst);
+    {
+        LibraryAllocScope lib;
+        av_frame_copy_props(dst, src);
+    }
+    dst->format = format;
+    dst->width = w;
+    dst->height = h;
+    dst->buf[0] = buf;
+    av_image_fill_arrays(dst->data, dst->linesize, buf->data, format, w, h, CONVERT_ALIGN);
+
+    return 0;
+};
+
+ThreadPool* FrameConverter::Workers(bool needed)
+{
+    if (needed && !workers_) {
+        int cores = (int)std::thread::hardware_concurrency();
+        workers_ = new ThreadPool(std::max(1, std::min(CONVERT_POOL_THREADS, cores - 1)));
+    }
+
+    return needed ? workers_ : nullptr;
+};
@@ -0,0 +1,76 @@
+﻿#ifndef FRAMECONVERT_H
+#define FRAMECONVERT_H
+
+#include "depthconvert.h"
+#include "downscale.h"
+#include <vector>
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libavutil/buffer.h"
+#include "libswscale/swscale.h"
+}
+
+/**
+ * @brief 在解码线程上把显示端不支持的像素格式转换为支持的格式
+ *
+ * - 10 / 12 / 16 位 4:2:0（HDR10、10 位 HEVC 等）转 8 位走 SIMD 位深转换（见 depthconvert.h），
+ *   只降位深、不做色调映射；4K 帧由内部线程池按行分段并行
+ * - 其他格式交给 sws_scale，SwsContext 用 sws_getCachedContext 缓存，格式 / 尺寸不变时直接复用
+ * - 输出缓冲区来自按图像大小创建的 AVBufferPool，稳定播放时不再分配
+ * - 输出帧保留原帧的 pts、duration、opaque（延迟时间戳槽序号）等属性
+ * - Downscale 在视频远大于显示区域时做 2:1 / 4:1 盒式下采样（见 downscale.h）；
+ *   同一帧先转换再下采样时要用两个实例，否则两种尺寸的输出让缓冲区池来回重建
+ */
+class FrameConverter
+{
+public:
+    FrameConverter() {};
+    ~FrameConverter();
+
+    FrameConverter(const FrameConverter&) = delete;
+    FrameConverter& operator=(const FrameConverter&) = delete;
+
+    /**
+     * @brief 从显示端支持的格式中选择 src_format 的转换目标（损失最小的一个）
+     * @param formats 显示端支持的格式，为空表示都支持
+     * @return 无需转换时返回 src_format
+     */
+    static AVPixelFormat ChooseFormat(AVPixelFormat src_format, const std::vector<AVPixelFormat>& formats);
+
+    /**
+     * @brief 把 src 转换为 dst_format，结果写入 dst（dst 原有的引用会先释放）
+     * @return 成功返回0，失败返回-1
+     */
+    int Convert(const AVFrame* src, AVFrame* dst, AVPixelFormat dst_format);
+
+    /**
+     * @brief 把 src 按 factor（2 或 4）盒式下采样，结果写入 dst（格式不变，尺寸见 DownscaleSize）
+     * @return 成功返回0，格式不支持或失败返回-1
+     */
+    int Downscale(const AVFrame* src, AVFrame* dst, int factor);
+
+    /**
+     * @brief 位深转换是否使用有序抖动（默认开启，避免平滑渐变出现色带）
+     */
+    void SetDither(bool on) { dither_ = on; }
+
+private:
+    /**
+     * @brief 从缓冲区池取得 w x h 的 format 图像作为 dst 的数据，属性复制自 src
+     */
+    int AllocFrame(const AVFrame* src, AVFrame* dst, AVPixelFormat format, int w, int h);
+
+    /**
+     * @brief 需要并行时返回线程池（第一次需要时创建），否则返回空
+     */
+    ThreadPool* Workers(bool needed);
+
+    SwsContext* sws_ctx_ = nullptr;     // 缓存的转换上下文
+    AVBufferPool* pool_ = nullptr;      // 输出缓冲区池
+    int pool_size_ = 0;                 // 池中缓冲区大小（字节）
+    ThreadPool* workers_ = nullptr;     // 4K 位深转换 / 下采样的线程池（第一次需要时创建）
+    bool dither_ = true;                // 位深转换使用有序抖动
+};
+
+#endif // FRAMECONVERT_H
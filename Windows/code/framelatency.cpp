@@ -0,0 +1,204 @@
+﻿#include "framelatency.h"
+
+extern "C" {
+#include "libavutil/time.h"
+}
+
+#define STAMP_SLOTS 4096    // 时间戳槽数（在途包数上限），必须是 2 的幂
+
+// ============================================================================
+//                              LatencyHistogram
+// ============================================================================
+
+void LatencyHistogram::Record(int64_t us)
+{
+    if (us < 0)
+        us = 0;
+
+    // 桶下标 = us 的二进制位数
+    int bucket = 0;
+    for (int64_t v = us; v > 0 && bucket < kBuckets - 1; v >>= 1)
+        bucket++;
+
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+
+    int64_t cur = max_.load(std::memory_order_relaxed);
+    while (us > cur && !max_.compare_exchange_weak(cur, us, std::memory_order_relaxed));
+};
+
+void LatencyHistogram::Reset()
+{
+    for (int i = 0; i < kBuckets; i++)
+        buckets_[i] = 0;
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+};
+
+double LatencyHistogram::Mean() const
+{
+    int64_t count = count_;
+    return count > 0 ? (double)sum_ / count : 0.0;
+};
+
+int64_t LatencyHistogram::Percentile(double q) const
+{
+    int64_t count = count_;
+    if (count == 0)
+        return 0;
+
+    int64_t rank = (int64_t)(q * count);
+    int64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += buckets_[i];
+        if (seen > rank)
+            return i == 0 ? 0 : ((int64_t)1 << i) - 1;
+    }
+
+    return max_;
+};
+
+// ============================================================================
+//                                FrameLatency
+// ============================================================================
+
+FrameLatency& FrameLatency::Instance()
+{
+    static FrameLatency instance;
+    return instance;
+};
+
+void FrameLatency::Record(const FrameStamps& stamps)
+{
+    // 任一节点缺失（如解码器没有传递 opaque、槽已被重新占用）时只记录能算出的阶段
+    if (stamps.read && stamps.decode_start)
+        stages_[PacketQueue].Record(stamps.decode_start - stamps.read);
+    if (stamps.decode_start && stamps.decode_end)
+        stages_[Decode].Record(stamps.decode_end - stamps.decode_start);
+    if (stamps.decode_end && stamps.enqueue)
+        stages_[Enqueue].Record(stamps.enqueue - stamps.decode_end);
+    if (stamps.enqueue && stamps.present)
+        stages_[FrameQueue].Record(stamps.present - stamps.enqueue);
+    if (stamps.read && stamps.present)
+        stages_[Total].Record(stamps.present - stamps.read);
+};
+
+void FrameLatency::Reset()
+{
+    for (int i = 0; i < StageCount; i++)
+        stages_[i].Reset();
+};
+
+void FrameLatency::Dump(FILE* out) const
+{
+    static const char* names[StageCount] = {
+        "packet queue", "decode", "enqueue", "frame queue", "total"
+    };
+
+    if (stages_[Total].Count() == 0)
+        return;
+
+    fprintf(out, "video frame latency (ms)   count      mean       p50       p99       max\n");
+    for (int i = 0; i < StageCount; i++) {
+        const LatencyHistogram& h = stages_[i];
+        fprintf(out, "  %-22s %9lld %9.2f %9.2f %9.2f %9.2f\n", names[i],
+            (long long)h.Count(), h.Mean() / 1000.0,
+            h.Percentile(0.5) / 1000.0, h.Percentile(0.99) / 1000.0, h.Max() / 1000.0);
+    }
+};
+
+// ============================================================================
+//                                  打点函数
+// ============================================================================
+
+namespace {
+
+// 与 FrameStamps 的字段一一对应
+enum StampField { kRead = 0, kDecodeStart, kDecodeEnd, kEnqueue, kPresent, kFieldCount };
+static_assert(sizeof(FrameStamps) == kFieldCount * sizeof(int64_t), "FrameStamps layout");
+
+struct StampSlot {
+    std::atomic<intptr_t> seq{ 0 };             // 占用该槽的包序号，0 表示空闲 / 正在改写
+    std::atomic<int64_t> fields[kFieldCount] = {};
+};
+
+StampSlot g_slots[STAMP_SLOTS];
+std::atomic<intptr_t> g_next_seq{ 0 };
+
+// opaque 里的包序号对应的槽；槽已被更新的包占用时返回 nullptr
+StampSlot* GetSlot(void* opaque)
+{
+    intptr_t seq = (intptr_t)opaque;
+    if (seq <= 0)
+        return nullptr;
+
+    StampSlot& slot = g_slots[seq & (STAMP_SLOTS - 1)];
+    return slot.seq.load(std::memory_order_acquire) == seq ? &slot : nullptr;
+};
+
+void Stamp(void* opaque, StampField field)
+{
+    if (StampSlot* slot = GetSlot(opaque))
+        slot->fields[field].store(av_gettime_relative(), std::memory_order_relaxed);
+};
+
+} // namespace
+
+void StampPacketRead(AVPacket* packet)
+{
+    // 序号回绕到负数时从 1 重新开始（0 表示没有时间戳）
+    intptr_t seq = g_next_seq.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (seq <= 0) {
+        g_next_seq = 1;
+        seq = 1;
+    }
+
+    // 先让持有旧序号的帧失效，再清空字段、发布新序号
+    StampSlot& slot = g_slots[seq & (STAMP_SLOTS - 1)];
+    slot.seq.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < kFieldCount; i++)
+        slot.fields[i].store(0, std::memory_order_relaxed);
+    slot.fields[kRead].store(av_gettime_relative(), std::memory_order_relaxed);
+    slot.seq.store(seq, std::memory_order_release);
+
+    packet->opaque = (void*)seq;
+};
+
+void StampDecodeStart(AVPacket* packet)
+{
+    Stamp(packet->opaque, kDecodeStart);
+};
+
+void StampDecodeEnd(AVFrame* frame)
+{
+    Stamp(frame->opaque, kDecodeEnd);
+};
+
+void StampEnqueue(AVFrame* frame)
+{
+    Stamp(frame->opaque, kEnqueue);
+};
+
+void StampPresent(AVFrame* frame)
+{
+    StampSlot* slot = GetSlot(frame->opaque);
+    if (!slot)
+        return;
+
+    FrameStamps stamps;
+    stamps.read = slot->fields[kRead].load(std::memory_order_relaxed);
+    stamps.decode_start = slot->fields[kDecodeStart].load(std::memory_order_relaxed);
+    stamps.decode_end = slot->fields[kDecodeEnd].load(std::memory_order_relaxed);
+    stamps.enqueue = slot->fields[kEnqueue].load(std::memory_order_relaxed);
+    stamps.present = av_gettime_relative();
+    slot->fields[kPresent].store(stamps.present, std::memory_order_relaxed);
+
+    // 读字段期间槽被重新占用则丢弃这一帧
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->seq.load(std::memory_order_relaxed) != (intptr_t)frame->opaque)
+        return;
+
+    FrameLatency::Instance().Record(stamps);
+};
@@ -0,0 +1,127 @@
+﻿#ifndef FRAMELATENCY_H
+#define FRAMELATENCY_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+/**
+ * @brief 单帧在流水线各节点的时间戳（av_gettime_relative，微秒，0 表示未记录）
+ *
+ * 存放在预先分配的环形槽表里，解复用时按包序号占用一个槽，序号写进 AVPacket::opaque；
+ * 解码器打开 AV_CODEC_FLAG_COPY_OPAQUE 后会把它带到解码出的 AVFrame::opaque，
+ * 之后随帧进入 AVFrameQueue 直到显示。一个包解出多帧时（如音频）这些帧共享同一份时间戳。
+ * 打点不分配内存；槽被更新的包重新占用后（在途包超过槽数），旧帧的时间戳视为缺失。
+ */
+struct FrameStamps {
+    int64_t read;           // av_read_frame 返回
+    int64_t decode_start;   // avcodec_send_packet 之前
+    int64_t decode_end;     // avcodec_receive_frame 返回该帧
+    int64_t enqueue;        // 放入 AVFrameQueue
+    int64_t present;        // 显示完成（SDL_RenderPresent 之后）
+};
+
+/**
+ * @brief 以 2 的幂划分桶的延迟直方图（微秒），记录无锁，可在任意线程读取
+ */
+class LatencyHistogram
+{
+public:
+    static const int kBuckets = 32;     // 第 i 个桶：[2^(i-1), 2^i) 微秒，第 0 个桶为 0
+
+    void Record(int64_t us);
+    void Reset();
+
+    int64_t Count() const { return count_; };
+    int64_t Max() const { return max_; };
+    double Mean() const;
+
+    /**
+     * @brief 估算分位数（返回所在桶的上界，微秒）
+     * @param q 0~1，例如 0.99
+     */
+    int64_t Percentile(double q) const;
+
+private:
+    std::atomic<int64_t> buckets_[kBuckets] = {};
+    std::atomic<int64_t> count_{ 0 };
+    std::atomic<int64_t> sum_{ 0 };
+    std::atomic<int64_t> max_{ 0 };
+};
+
+/**
+ * @brief 视频帧端到端延迟统计（进程内唯一）
+ *
+ * 各阶段：
+ *   - PacketQueue：读到包 → 送入解码器（包队列排队）
+ *   - Decode     ：送入解码器 → 解出帧（含解码器内部重排延迟）
+ *   - Enqueue    ：解出帧 → 进入帧队列
+ *   - FrameQueue ：进入帧队列 → 显示完成（帧队列排队 + 同步等待 + 上传渲染）
+ *   - Total      ：读到包 → 显示完成
+ */
+class FrameLatency
+{
+public:
+    enum Stage {
+        PacketQueue = 0,
+        Decode,
+        Enqueue,
+        FrameQueue,
+        Total,
+        StageCount
+    };
+
+    static FrameLatency& Instance();
+
+    /**
+     * @brief 记录一帧的各阶段延迟（视频输出端显示完成后调用）
+     */
+    void Record(const FrameStamps& stamps);
+
+    void Reset();
+
+    const LatencyHistogram& Histogram(Stage stage) const { return stages_[stage]; };
+
+    /**
+     * @brief 输出各阶段统计表（没有记录时不输出）
+     */
+    void Dump(FILE* out) const;
+
+private:
+    FrameLatency() {};
+
+    LatencyHistogram stages_[StageCount];
+};
+
+// ================ 时间戳打点（没有时间戳的包 / 帧直接跳过） ================
+
+/**
+ * @brief 解复用线程读到包后调用：占用一个时间戳槽并记录读取时间
+ */
+void StampPacketRead(AVPacket* packet);
+
+/**
+ * @brief 解码线程送入解码器前调用
+ */
+void StampDecodeStart(AVPacket* packet);
+
+/**
+ * @brief 解码线程取到帧后调用
+ */
+void StampDecodeEnd(AVFrame* frame);
+
+/**
+ * @brief 帧放入 AVFrameQueue 时调用
+ */
+void StampEnqueue(AVFrame* frame);
+
+/**
+ * @brief 视频输出端显示完成后调用：记录显示时间并计入 FrameLatency
+ */
+void StampPresent(AVFrame* frame);
+
+#endif // FRAMELATENCY_H
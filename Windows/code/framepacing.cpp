@@ -0,0 +1,189 @@
+﻿#include "framepacing.h"
+#include <algorithm>
+#include <cmath>
+
+// pts 间隔超过帧间隔的该倍数时认为中间有帧被跳过
+#define PACING_SKIP_RATIO 1.5
+// pts 间隔超过该秒数（或倒退）时按不连续处理（如 seek、时间戳跳变）
+#define PACING_MAX_PTS_GAP 10.0
+
+// ============================================================================
+//                             FrameTimeHistogram
+// ============================================================================
+
+int FrameTimeHistogram::BucketIndex(int64_t us)
+{
+    if (us < 2 * kSubBuckets)
+        return (int)us;
+
+    // exponent = us 的最高位，取其后 kSubBits 位作为子桶
+    int exponent = 0;
+    for (int64_t v = us; v > 1; v >>= 1)
+        exponent++;
+    if (exponent >= kMaxExponent)
+        return kBuckets - 1;
+
+    int shift = exponent - kSubBits;
+    int sub = (int)(us >> shift) - kSubBuckets;
+    return 2 * kSubBuckets + (exponent - kSubBits - 1) * kSubBuckets + sub;
+};
+
+int64_t FrameTimeHistogram::BucketUpper(int index)
+{
+    if (index < 2 * kSubBuckets)
+        return index;
+
+    int shift = (index - 2 * kSubBuckets) / kSubBuckets + 1;
+    int sub = (index - 2 * kSubBuckets) % kSubBuckets;
+    return (((int64_t)(kSubBuckets + sub + 1)) << shift) - 1;
+};
+
+void FrameTimeHistogram::Record(int64_t us)
+{
+    if (us < 0)
+        us = 0;
+
+    buckets_[BucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+
+    int64_t cur = max_.load(std::memory_order_relaxed);
+    while (us > cur && !max_.compare_exchange_weak(cur, us, std::memory_order_relaxed));
+};
+
+void FrameTimeHistogram::Reset()
+{
+    for (int i = 0; i < kBuckets; i++)
+        buckets_[i] = 0;
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+};
+
+double FrameTimeHistogram::Mean() const
+{
+    int64_t count = count_;
+    return count > 0 ? (double)sum_ / count : 0.0;
+};
+
+int64_t FrameTimeHistogram::Percentile(double q) const
+{
+    int64_t count = count_;
+    if (count == 0)
+        return 0;
+
+    int64_t rank = (int64_t)(q * count);
+    int64_t seen = 0;
+    int64_t max = max_;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += buckets_[i];
+        if (seen > rank)
+            return std::min(BucketUpper(i), max);
+    }
+
+    return max;
+};
+
+// ============================================================================
+//                                FramePacing
+// ============================================================================
+
+FramePacing& FramePacing::Instance()
+{
+    static FramePacing instance;
+    return instance;
+};
+
+FramePacing::FramePacing()
+{
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    late_ = registry.GetCounter("video.pacing.late");
+    repeated_ = registry.GetCounter("video.pacing.repeated");
+    skipped_ = registry.GetCounter("video.pacing.skipped_pts");
+};
+
+void FramePacing::OnPresent(double present, double target, double pts, double duration, double speed)
+{
+    if (speed <= 0.0)
+        speed = 1.0;
+
+    double pts_gap = pts - last_pts_;
+    if (has_last_ && (pts_gap <= 0.0 || pts_gap > PACING_MAX_PTS_GAP))
+        has_last_ = false;  // 时间戳不连续：只更新基准
+
+    // 帧间隔（媒体时间）：优先帧时长，其次上一次的 pts 间隔
+    double interval = duration > 0.0 ? duration : last_interval_;
+
+    if (has_last_) {
+        if (interval <= 0.0)
+            interval = pts_gap;
+
+        frame_time_.Record((int64_t)((present - last_present_) * 1000000));
+
+        // 上一帧画面比 pts 要求多停留的帧间隔数
+        double extra = (present - last_present_) - pts_gap / speed;
+        int64_t repeats = (int64_t)std::floor(extra / (interval / speed) + 0.5);
+        if (repeats > 0)
+            repeated_->Add(repeats);
+
+        if (pts_gap > interval * PACING_SKIP_RATIO)
+            skipped_->Add((int64_t)std::floor(pts_gap / interval + 0.5) - 1);
+        else
+            last_interval_ = pts_gap;
+    }
+
+    double late = present - target;
+    lateness_.Record((int64_t)(late * 1000000));
+    if (interval > 0.0 && late > interval / speed)
+        late_->Add(1);
+
+    has_last_ = true;
+    last_present_ = present;
+    last_pts_ = pts;
+};
+
+void FramePacing::Reset()
+{
+    frame_time_.Reset();
+    lateness_.Reset();
+    late_base_ = late_->Get();
+    repeated_base_ = repeated_->Get();
+    skipped_base_ = skipped_->Get();
+};
+
+FramePacingStats FramePacing::Snapshot() const
+{
+    FramePacingStats stats;
+    stats.presents = lateness_.Count();
+    stats.frame_time_mean_us = (int64_t)frame_time_.Mean();
+    stats.frame_time_p50_us = frame_time_.Percentile(0.5);
+    stats.frame_time_p90_us = frame_time_.Percentile(0.9);
+    stats.frame_time_p99_us = frame_time_.Percentile(0.99);
+    stats.frame_time_max_us = frame_time_.Max();
+    stats.lateness_p50_us = lateness_.Percentile(0.5);
+    stats.lateness_p99_us = lateness_.Percentile(0.99);
+    stats.lateness_max_us = lateness_.Max();
+    stats.late_frames = late_->Get() - late_base_;
+    stats.repeated_frames = repeated_->Get() - repeated_base_;
+    stats.skipped_pts = skipped_->Get() - skipped_base_;
+    return stats;
+};
+
+void FramePacing::Dump(FILE* out) const
+{
+    FramePacingStats stats = Snapshot();
+    if (stats.presents == 0)
+        return;
+
+    fprintf(out, "video frame pacing (ms)    count      mean       p50       p90       p99       max\n");
+    fprintf(out, "  %-22s %9lld %9.2f %9.2f %9.2f %9.2f %9.2f\n", "frame time",
+        (long long)frame_time_.Count(), stats.frame_time_mean_us / 1000.0,
+        stats.frame_time_p50_us / 1000.0, stats.frame_time_p90_us / 1000.0,
+        stats.frame_time_p99_us / 1000.0, stats.frame_time_max_us / 1000.0);
+    fprintf(out, "  %-22s %9lld %9.2f %9.2f %9.2f %9.2f %9.2f\n", "lateness",
+        (long long)stats.presents, lateness_.Mean() / 1000.0,
+        stats.lateness_p50_us / 1000.0, lateness_.Percentile(0.9) / 1000.0,
+        stats.lateness_p99_us / 1000.0, stats.lateness_max_us / 1000.0);
+    fprintf(out, "  late > 1 interval: %lld   repeated: %lld   skipped pts: %lld\n",
+        (long long)stats.late_frames, (long long)stats.repeated_frames, (long long)stats.skipped_pts);
+};
@@ -0,0 +1,129 @@
+﻿#ifndef FRAMEPACING_H
+#define FRAMEPACING_H
+
+#include "metrics.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief HDR 直方图式的帧时间直方图（微秒），记录无锁，可在任意线程读取
+ *
+ * 每个 2 的幂区间再线性分成 16 个子桶，相对误差不超过 1/16：
+ * 16.7ms 与 33.3ms 这样的帧间隔能分开（LatencyHistogram 的 2 的幂桶会落进同一个桶）。
+ * 0~31 微秒每个值一个桶，上限约 2^36 微秒，超出的计入最后一个桶。
+ */
+class FrameTimeHistogram
+{
+public:
+    static const int kSubBits = 4;                  // 每个 2 的幂区间的子桶数 = 2^kSubBits
+    static const int kSubBuckets = 1 << kSubBits;
+    static const int kMaxExponent = 36;
+    static const int kBuckets = 2 * kSubBuckets + (kMaxExponent - kSubBits - 1) * kSubBuckets;
+
+    void Record(int64_t us);
+    void Reset();
+
+    int64_t Count() const { return count_; };
+    int64_t Max() const { return max_; };
+    double Mean() const;
+
+    /**
+     * @brief 估算分位数（返回所在子桶的上界，不超过最大值，微秒）
+     * @param q 0~1，例如 0.99
+     */
+    int64_t Percentile(double q) const;
+
+private:
+    static int BucketIndex(int64_t us);
+    static int64_t BucketUpper(int index);
+
+    std::atomic<int64_t> buckets_[kBuckets] = {};
+    std::atomic<int64_t> count_{ 0 };
+    std::atomic<int64_t> sum_{ 0 };
+    std::atomic<int64_t> max_{ 0 };
+};
+
+/**
+ * @brief 帧节奏统计快照（FramePacing::Snapshot 返回）
+ */
+struct FramePacingStats {
+    int64_t presents = 0;           // 计入统计的显示次数
+    int64_t frame_time_mean_us = 0; // 相邻两次显示的实际间隔
+    int64_t frame_time_p50_us = 0;
+    int64_t frame_time_p90_us = 0;
+    int64_t frame_time_p99_us = 0;
+    int64_t frame_time_max_us = 0;
+    int64_t lateness_p50_us = 0;    // 实际显示时刻晚于 pts 目标时刻的量（早于目标计 0）
+    int64_t lateness_p99_us = 0;
+    int64_t lateness_max_us = 0;
+    int64_t late_frames = 0;        // 晚于目标超过一个帧间隔的帧数
+    int64_t repeated_frames = 0;    // 上一帧比 pts 要求多停留的帧间隔数（画面重复）
+    int64_t skipped_pts = 0;        // pts 跳过的帧数（没有送到输出端的帧）
+};
+
+/**
+ * @brief 视频输出端的帧节奏统计（进程内唯一），用于客观比较渲染改动
+ *
+ * 每次显示后由渲染线程调用 OnPresent，传入实际显示时刻、按 pts 计算的目标时刻和帧 pts：
+ *   - 帧时间：与上一次显示的间隔（FrameTimeHistogram，分位数见 Snapshot）
+ *   - 晚显示：实际时刻 - 目标时刻，超过一个帧间隔记为晚帧
+ *   - 重复帧：实际间隔比 pts 间隔多出的帧间隔数（四舍五入），即上一帧画面多停留的次数
+ *   - 跳过的 pts：pts 间隔超过 1.5 个帧间隔时，中间缺少的帧数
+ * 帧间隔取 frame->duration，没有时取上一次的 pts 间隔；时间间隔都按倍速换算到系统时间。
+ *
+ * 晚帧 / 重复帧 / 跳过的 pts 同时计入指标 video.pacing.late / .repeated / .skipped_pts。
+ * 暂停、换文件等不连续处调用 Break，下一次显示不与之前的比较。
+ */
+class FramePacing
+{
+public:
+    static FramePacing& Instance();
+
+    /**
+     * @brief 记录一次显示（只在渲染线程调用）
+     * @param present  实际显示时刻（秒，系统时间）
+     * @param target   按 pts 计算的应显示时刻（秒，系统时间）
+     * @param pts      帧 pts（秒）
+     * @param duration 帧时长（秒，媒体时间），未知时传 0
+     * @param speed    当前倍速
+     */
+    void OnPresent(double present, double target, double pts, double duration, double speed);
+
+    /**
+     * @brief 标记不连续（只在渲染线程调用）
+     */
+    void Break() { has_last_ = false; };
+
+    void Reset();
+
+    /**
+     * @brief 读取统计（可在任意线程调用）
+     */
+    FramePacingStats Snapshot() const;
+
+    /**
+     * @brief 输出统计表（没有记录时不输出）
+     */
+    void Dump(FILE* out) const;
+
+private:
+    FramePacing();
+
+    FrameTimeHistogram frame_time_;     // 相邻两次显示的间隔
+    FrameTimeHistogram lateness_;       // 晚于目标时刻的量
+    MetricCounter* late_ = nullptr;
+    MetricCounter* repeated_ = nullptr;
+    MetricCounter* skipped_ = nullptr;
+    std::atomic<int64_t> late_base_{ 0 };      // Reset 时的计数器值（注册表中的计数器只增不减）
+    std::atomic<int64_t> repeated_base_{ 0 };
+    std::atomic<int64_t> skipped_base_{ 0 };
+
+    // 渲染线程私有
+    bool has_last_ = false;
+    double last_present_ = 0.0;         // 上一次显示时刻
+    double last_pts_ = 0.0;             // 上一帧 pts
+    double last_interval_ = 0.0;        // 上一次的 pts 间隔（帧时长未知时使用）
+};
+
+#endif // FRAMEPACING_H
@@ -0,0 +1,252 @@
+﻿#include "frametap.h"
+#include "allochook.h"
+#include "avframequeue.h"
+#include <algorithm>
+#include <chrono>
+
+// ============================================================================
+//                             FrameSubscription
+// ============================================================================
+
+FrameSubscription::FrameSubscription(const std::string& metric_prefix, const TapOptions& options)
+    : options_(options)
+{
+    if (options_.capacity < 1)
+        options_.capacity = 1;
+    ring_.resize(options_.capacity, nullptr);
+    free_.reserve(options_.capacity + 1);
+    evicted_.reserve(options_.capacity);
+
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    delivered_ = registry.GetCounter(metric_prefix + ".delivered");
+    dropped_ = registry.GetCounter(metric_prefix + ".dropped");
+    depth_ = registry.GetGauge(metric_prefix + ".depth");
+    bytes_gauge_ = registry.GetGauge(metric_prefix + ".bytes");
+    publish_ns_ = registry.GetHistogram(metric_prefix + ".publish_ns");
+};
+
+FrameSubscription::~FrameSubscription()
+{
+    for (size_t i = 0; i < count_; i++)
+        av_frame_free(&ring_[(head_ + i) % ring_.size()]);
+    for (AVFrame* frame : free_)
+        av_frame_free(&frame);
+    depth_->Set(0);
+    bytes_gauge_->Set(0);
+};
+
+bool FrameSubscription::Over(int64_t bytes) const
+{
+    if (count_ == 0)
+        return false;
+    return count_ == ring_.size() || (options_.max_bytes > 0 && bytes_ + bytes > options_.max_bytes);
+};
+
+AVFrame* FrameSubscription::TakeShell()
+{
+    if (free_.empty())
+        return nullptr;
+
+    AVFrame* frame = free_.back();
+    free_.pop_back();
+    return frame;
+};
+
+int FrameSubscription::Offer(const AVFrame* src)
+{
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    int64_t bytes = FrameBytes(src);
+
+    AVFrame* frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+            return -1;
+        if (Over(bytes) && options_.drop == TapDropPolicy::DropNewest) {
+            dropped_->Add(1);
+            return 0;
+        }
+        frame = TakeShell();
+    }
+
+    // 取引用在锁外：订阅者的 Pop 不会被挡住
+    if (!frame)
+        frame = av_frame_alloc();
+    int ret = -1;
+    if (frame) {
+        LibraryAllocScope lib;  // 每个平面一个 AVBufferRef（见 allochook.h）
+        ret = av_frame_ref(frame, src);
+    }
+    if (ret < 0) {
+        av_frame_free(&frame);
+        dropped_->Add(1);
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // DropOldest：挤出最旧的帧直到放得下（DropNewest 在上面已经返回；取引用期间订阅者只会取走帧）
+        while (Over(bytes)) {
+            AVFrame* oldest = ring_[head_];
+            ring_[head_] = nullptr;
+            head_ = (head_ + 1) % ring_.size();
+            count_--;
+            bytes_ -= FrameBytes(oldest);
+            evicted_.push_back(oldest);
+        }
+        ring_[(head_ + count_) % ring_.size()] = frame;
+        count_++;
+        bytes_ += bytes;
+        depth_->Set((int64_t)count_);
+        bytes_gauge_->Set(bytes_);
+    }
+    cond_.notify_one();
+
+    for (AVFrame* oldest : evicted_) {
+        dropped_->Add(1);
+        Recycle(oldest);
+    }
+    evicted_.clear();
+    delivered_->Add(1);
+    publish_ns_->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0).count());
+
+    return 0;
+};
+
+AVFrame* FrameSubscription::Pop(int timeout, AVRational* time_base)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (count_ == 0 && timeout > 0) {
+        cond_.wait_for(lock, std::chrono::milliseconds(timeout), [this] {
+            return count_ != 0 || closed_;
+            });
+    }
+    if (count_ == 0)
+        return nullptr;
+
+    AVFrame* frame = ring_[head_];
+    ring_[head_] = nullptr;
+    head_ = (head_ + 1) % ring_.size();
+    count_--;
+    bytes_ -= FrameBytes(frame);
+    depth_->Set((int64_t)count_);
+    bytes_gauge_->Set(bytes_);
+    if (time_base)
+        *time_base = time_base_;
+
+    return frame;
+};
+
+void FrameSubscription::Recycle(AVFrame* frame)
+{
+    if (!frame)
+        return;
+
+    av_frame_unref(frame);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < ring_.size() + 1) {
+            free_.push_back(frame);
+            return;
+        }
+    }
+    av_frame_free(&frame);
+};
+
+AVRational FrameSubscription::TimeBase()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return time_base_;
+};
+
+void FrameSubscription::SetTimeBase(AVRational time_base)
+{
+    std::vector<AVFrame*> flushed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (time_base.num == time_base_.num && time_base.den == time_base_.den)
+            return;
+        time_base_ = time_base;
+
+        // 排队的是上一个文件的帧，pts 不能按新的时间基解释：全部丢弃
+        while (count_ > 0) {
+            flushed.push_back(ring_[head_]);
+            ring_[head_] = nullptr;
+            head_ = (head_ + 1) % ring_.size();
+            count_--;
+        }
+        bytes_ = 0;
+        depth_->Set(0);
+        bytes_gauge_->Set(0);
+    }
+
+    for (AVFrame* frame : flushed) {
+        dropped_->Add(1);
+        Recycle(frame);
+    }
+};
+
+void FrameSubscription::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cond_.notify_all();
+};
+
+// ============================================================================
+//                                  FrameTap
+// ============================================================================
+
+std::shared_ptr<FrameSubscription> FrameTap::Subscribe(const std::string& name, const TapOptions& options)
+{
+    std::shared_ptr<FrameSubscription> subscription =
+        std::make_shared<FrameSubscription>("tap." + stream_ + "." + name, options);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscription->SetTimeBase(time_base_);
+    subscriptions_.push_back(subscription);
+    count_ = (int)subscriptions_.size();
+
+    return subscription;
+};
+
+void FrameTap::Unsubscribe(const std::shared_ptr<FrameSubscription>& subscription)
+{
+    if (!subscription)
+        return;
+
+    subscription->Close();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriptions_.erase(std::remove(subscriptions_.begin(), subscriptions_.end(), subscription),
+        subscriptions_.end());
+    count_ = (int)subscriptions_.size();
+};
+
+void FrameTap::SetTimeBase(AVRational time_base)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    time_base_ = time_base;
+    for (auto& subscription : subscriptions_)
+        subscription->SetTimeBase(time_base);
+};
+
+void FrameTap::Publish(const AVFrame* frame)
+{
+    if (count_ == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < subscriptions_.size();) {
+        if (subscriptions_[i]->Offer(frame) < 0) {
+            // 订阅者已自行 Close：移除
+            subscriptions_.erase(subscriptions_.begin() + i);
+            continue;
+        }
+        i++;
+    }
+    count_ = (int)subscriptions_.size();
+};
@@ -0,0 +1,164 @@
+﻿#ifndef FRAMETAP_H
+#define FRAMETAP_H
+
+#include "metrics.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavutil/frame.h"
+}
+
+/**
+ * @brief 订阅队列满时的丢弃策略
+ */
+enum class TapDropPolicy {
+    DropOldest, // 丢弃队列中最旧的帧，保留最新的（实时分析）
+    DropNewest  // 丢弃新到的帧，保留已排队的（按顺序处理一段连续的帧）
+};
+
+/**
+ * @brief 订阅设置
+ */
+struct TapOptions {
+    int capacity = 8;                               // 队列容量（帧）
+    TapDropPolicy drop = TapDropPolicy::DropOldest;
+    int64_t max_bytes = 64 << 20;                   // 队列中帧引用的缓冲区字节上限，0 表示只按帧数限制
+};
+
+/**
+ * @brief 一个订阅者的帧队列（由 FrameTap::Subscribe 创建）
+ *
+ * - 收到的帧是解码线程输出帧的新引用（av_frame_ref），不复制像素 / 样本数据；
+ *   数据与播放共享，只能读不能写
+ * - 队列有界：帧数达到 capacity 或字节数将超过 max_bytes 时按丢弃策略丢帧，解码线程从不等待订阅者；
+ *   队列里只有一帧时不按字节数丢弃，所以单帧大于 max_bytes 时仍能收到
+ * - 排队的帧不计入帧队列的共享内存预算（FrameMemoryBudget），但它们的引用让解码器的缓冲区
+ *   不能回到缓冲池：每个订阅者额外占用的内存最多约为 max_bytes（4K 8 位 4:2:0 每帧约 12MB，默认约 5 帧）
+ * - Pop / Recycle / Close 可在订阅者的任意线程调用
+ *
+ * 指标（<前缀> 为 tap.<video|audio>.<名字>）：
+ *   <前缀>.delivered / .dropped  放入队列 / 被丢弃的帧数
+ *   <前缀>.depth / .bytes        当前排队帧数 / 字节数
+ *   <前缀>.publish_ns            解码线程为该订阅者每帧花费的时间（取引用 + 入队，直方图，纳秒）
+ */
+class FrameSubscription
+{
+public:
+    FrameSubscription(const std::string& metric_prefix, const TapOptions& options);
+    ~FrameSubscription();
+
+    FrameSubscription(const FrameSubscription&) = delete;
+    FrameSubscription& operator=(const FrameSubscription&) = delete;
+
+    /**
+     * @brief 取出一帧
+     * @param timeout 等待超时（毫秒），0 表示不等待
+     * @param time_base 非空时返回该帧 pts 的时间基（和帧一起取出，之后切换文件也不变）
+     * @return 帧（用完后调用 Recycle 归还），超时或已关闭返回 NULL
+     */
+    AVFrame* Pop(int timeout, AVRational* time_base = nullptr);
+
+    /**
+     * @brief 归还 Pop 取出的帧：释放引用，空壳留给下一帧复用
+     */
+    void Recycle(AVFrame* frame);
+
+    /**
+     * @brief 关闭订阅：不再接收新帧，唤醒等待中的 Pop（之后 Pop 取完剩余帧后返回 NULL）
+     */
+    void Close();
+    bool Closed() const { return closed_; }
+
+    /**
+     * @brief 帧 pts 的时间基（当前文件的流时间基，切换文件时更新）
+     *
+     * 时间基变化时队列中上一个文件的帧全部丢弃（计入 dropped）；已经取出的帧用 Pop 返回的时间基
+     */
+    AVRational TimeBase();
+
+    int64_t Delivered() const { return delivered_->Get(); }
+    int64_t Dropped() const { return dropped_->Get(); }
+
+private:
+    friend class FrameTap;
+
+    /**
+     * @brief 解码线程调用：取引用放入队列，满时按策略丢帧（不等待）
+     * @return 成功或丢弃返回0，已关闭返回-1
+     */
+    int Offer(const AVFrame* frame);
+
+    AVFrame* TakeShell();               // 取空壳（调用方持有锁）
+    bool Over(int64_t bytes) const;     // 再放入 bytes 字节的一帧是否超出帧数 / 字节上限（调用方持有锁）
+    void SetTimeBase(AVRational time_base);  // 时间基变化时清空队列
+
+    TapOptions options_;
+    AVRational time_base_ = { 0, 1 };
+    std::mutex mutex_;                  // 保护以下环形队列和空闲链表
+    std::condition_variable cond_;
+    std::vector<AVFrame*> ring_;        // 容量固定的环形队列
+    size_t head_ = 0;
+    size_t count_ = 0;
+    int64_t bytes_ = 0;                 // 排队帧引用的缓冲区字节数
+    std::vector<AVFrame*> free_;        // 空壳 AVFrame
+    std::vector<AVFrame*> evicted_;     // DropOldest 挤出的帧，出锁后归还（只在 Offer 中使用）
+    std::atomic<bool> closed_{ false };
+
+    MetricCounter* delivered_ = nullptr;
+    MetricCounter* dropped_ = nullptr;
+    MetricGauge* depth_ = nullptr;
+    MetricGauge* bytes_gauge_ = nullptr;
+    LatencyHistogram* publish_ns_ = nullptr;
+};
+
+/**
+ * @brief 解码输出帧的订阅点（音频、视频各一个）
+ *
+ * 分析插件（运动检测、OCR 等）订阅正在播放的帧，不需要把文件再解码一次。
+ * 解码线程在帧放入 AVFrameQueue 之前调用 Publish：视频帧是显示端收到的帧
+ * （像素格式转换 / 下采样之后），早于显示时间（相差帧队列的深度）。
+ * 订阅在文件之间保留，切换文件后继续收到新文件的帧（pts 从新文件开始，还没取走的旧文件帧丢弃）。
+ */
+class FrameTap
+{
+public:
+    /**
+     * @param stream 流名（"video" / "audio"），用于指标名
+     */
+    explicit FrameTap(const char* stream) : stream_(stream) {};
+
+    /**
+     * @brief 新建订阅（任意线程）
+     * @param name 订阅者名字，用于指标名
+     */
+    std::shared_ptr<FrameSubscription> Subscribe(const std::string& name, const TapOptions& options);
+
+    /**
+     * @brief 取消订阅并关闭其队列（任意线程；直接 Close 也可以，下一帧时移除）
+     */
+    void Unsubscribe(const std::shared_ptr<FrameSubscription>& subscription);
+
+    /**
+     * @brief 设置之后发布的帧的时间基（每个文件的解码线程启动前调用）
+     */
+    void SetTimeBase(AVRational time_base);
+
+    /**
+     * @brief 把一帧交给所有订阅者（解码线程调用；没有订阅者时只有一次原子读）
+     */
+    void Publish(const AVFrame* frame);
+
+private:
+    std::string stream_;
+    AVRational time_base_ = { 0, 1 };                       // 受 mutex_ 保护
+    std::mutex mutex_;                                      // 保护订阅列表
+    std::vector<std::shared_ptr<FrameSubscription>> subscriptions_;
+    std::atomic<int> count_{ 0 };                           // 订阅数
+};
+
+#endif // FRAMETAP_H
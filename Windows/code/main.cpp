@@ -3,9 +3,24 @@
 #include <vector>
 #include <map>
 #include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#ifdef _WIN32
 #include <conio.h>
 #include <windows.h>
+#endif
 #include "maincontroller.h"
+#include "mediaprobe.h"
+#include "benchmark.h"
+#include "microbench.h"
+#include "synctest.h"
+#include "framelatency.h"
+#include "framepacing.h"
+#include "tracing.h"
+#include "statsserver.h"
+#include "shmexport.h"
+#include "shmreader.h"
 
 extern "C" {
 #include <libavutil/log.h>
@@ -15,14 +30,15 @@ using namespace std;
 
 #undef main // 取消 SDL 对 main 的宏定义，避免冲突
 
+#ifdef _WIN32
 // =======================
 // 函数：扫描指定目录下的视频文件
 // 参数：dir_path - 目录路径
-// 返回值：视频文件名列表
+// 返回值：视频文件列表（按文件名排序，附带大小和修改时间作为探测缓存的键）
 // 支持格式：.mp4 .MP4 .mkv .avi
 // =======================
-vector<string> ScanVideoFiles(const string& dir_path) {
-    vector<string> files;
+vector<MediaFile> ScanVideoFiles(const string& dir_path) {
+    vector<MediaFile> files;
     WIN32_FIND_DATAA find_data;  // Windows 文件查找数据结构
 
     // 构建搜索路径，使用通配符 *.* 匹配所有文件
@@ -44,7 +60,14 @@ vector<string> ScanVideoFiles(const string& dir_path) {
 
                 // 检查是否为支持的视频格式
                 if (ext == ".mp4" || ext == ".MP4" || ext == ".mkv" || ext == ".avi") {
-                    files.push_back(name);  // 添加到结果列表
+                    // 大小和修改时间直接来自目录项，命中缓存时无需打开文件
+                    MediaFile file;
+                    file.name = name;
+                    file.path = dir_path + "\\" + name;
+                    file.size = ((int64_t)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+                    file.mtime = ((int64_t)find_data.ftLastWriteTime.dwHighDateTime << 32)
+                        | find_data.ftLastWriteTime.dwLowDateTime;
+                    files.push_back(file);  // 添加到结果列表
                 }
             }
         }
@@ -52,50 +75,76 @@ vector<string> ScanVideoFiles(const string& dir_path) {
 
     FindClose(hFind);  // 关闭查找句柄
 
+    // 目录枚举顺序由文件系统决定，排序后列表顺序固定
+    sort(files.begin(), files.end(), [](const MediaFile& a, const MediaFile& b) {
+        return a.name < b.name;
+        });
+
     return files;
 };
 
+// =======================
+// 函数：生成列表编号
+// 参数：index - 序号（从0开始）
+// 返回值：A, B, ..., Z, AA, AB, ...（文件很多时不会越界）
+// =======================
+string MakeLabel(size_t index) {
+    string label;
+    index++;
+    while (index > 0) {
+        index--;
+        label.insert(label.begin(), (char)('A' + index % 26));
+        index /= 26;
+    }
+    return label;
+};
+
 // =======================
 // 函数：选择视频文件
 // 参数：video_dir - 视频目录路径
-// 返回值：完整视频路径
+//         probe - 媒体探测器（带磁盘缓存）
+// 返回值：选中文件的探测结果（path 为空表示没有可选文件）
 // 说明：
-//  1. 显示目录下视频列表，用户可通过字母编号或文件名（无后缀）选择视频
-//  2. 按 Esc 键退出程序
+//  1. 显示目录下视频列表（时长 / 分辨率 / 编码），用户可通过字母编号或文件名（无后缀）选择视频
+//  2. 无法播放的文件会标出原因，不能被选中
+//  3. 按 Esc 键退出程序
 // =======================
-string SelectVideo(const string& video_dir) {
+MediaInfo SelectVideo(const string& video_dir, MediaProbe& probe) {
     // 扫描目录获取视频文件列表
-    vector<string> video_files = ScanVideoFiles(video_dir);
+    vector<MediaFile> video_files = ScanVideoFiles(video_dir);
 
-    // 如果没有找到视频文件，提示并返回空字符串
+    // 如果没有找到视频文件，提示并返回空结果
     if (video_files.empty()) {
         cout << "未找到视频文件: " << video_dir << endl;
-        return "";
+        return MediaInfo();
     }
 
+    // 并行探测（缓存命中的文件不会被打开），结果顺序与 video_files 一致
+    vector<MediaInfo> infos = probe.Probe(video_files);
+
     // 建立选择映射表：用户输入 → 文件名
     // 支持两种输入方法：
     //  1. 字母编号：A, B, C...
     //  2. 文件名（不含扩展名）：video1, movie2...
-    map<string, string> selection_map;
-    char label = 'A';  // 从字母A开始编号
+    map<string, size_t> selection_map;  // 用户输入 → infos 下标
 
     cout << "\n视频列表:\n";  // 显示标题
 
     // 遍历所有视频文件，建立映射并显示列表
-    for (auto& f : video_files) {
-        cout << label << ". " << f << endl;  // 显示编号和文件名
+    for (size_t i = 0; i < infos.size(); i++) {
+        const string& f = infos[i].file.name;
+        string label = MakeLabel(i);  // 从字母A开始编号
+
+        // 显示编号、文件名和探测结果
+        cout << label << ". " << f << "  [" << MediaProbe::Describe(infos[i]) << "]" << endl;
 
         // 建立字母编号映射（如 "A" → "video1.mp4"）
-        string key_upper(1, label);
-        selection_map[key_upper] = f;
+        selection_map[label] = i;
 
         // 建立文件名映射（不含扩展名）
         // 查找最后一个点号的位置，提取文件名（不含扩展名）
         string key_name = f.substr(0, f.find_last_of('.'));
-        selection_map[key_name] = f;
-
-        label++;  // 编号递增
+        selection_map[key_name] = i;
     }
 
     string user_choice;  // 存储用户输入
@@ -145,9 +194,16 @@ string SelectVideo(const string& video_dir) {
 
         // 检查用户输入是否有效
         if (selection_map.find(user_choice) != selection_map.end()) {
-            // 输入有效，构建完整文件路径并返回
-            // 格式：目录路径 + 分隔符 + 文件名
-            return video_dir + "\\" + selection_map[user_choice];
+            const MediaInfo& info = infos[selection_map[user_choice]];
+
+            // 探测时已确认无法播放的文件不进入播放流程
+            if (!info.playable) {
+                cout << "该视频无法播放（" << info.error << "），请重新选择！\n";
+                continue;
+            }
+
+            // 输入有效，返回探测结果（含完整文件路径）
+            return info;
         }
         else {
             // 输入无效，提示用户重新输入
@@ -155,33 +211,190 @@ string SelectVideo(const string& video_dir) {
         }
     }
 
-    return "";
+    return MediaInfo();
+};
+
+// 连拍间隔（帧）
+#define SNAPSHOT_BURST_EVERY 30
+
+// =======================
+// 函数：截图完成回调（在截图线程上调用）
+// =======================
+static void PrintSnapshot(const SnapshotResult& result) {
+    if (result.ret == 0)
+        printf("截图已保存：%s（%dx%d，pts %.3f s，耗时 %.1f ms）\n", result.path.c_str(),
+            result.width, result.height, result.pts, result.encode_us / 1000.0);
+    else
+        printf("截图失败：%s\n", result.path.c_str());
+};
+#endif // _WIN32
+
+// 倍速范围（atempo 支持 0.5 ~ 100）
+#define SPEED_MIN 0.5
+#define SPEED_MAX 100.0
+
+// =======================
+// 函数：解析逗号分隔的倍速列表（--sync-test）
+// 返回值：成功返回0，任一项不是数字或超出倍速范围返回-1
+// =======================
+static int ParseSpeedList(const char* text, std::vector<float>& speeds) {
+    speeds.clear();
+    for (const char* p = text; ; ) {
+        char* end = nullptr;
+        double speed = strtod(p, &end);
+        if (end == p || (*end != ',' && *end != '\0') || !(speed >= SPEED_MIN && speed <= SPEED_MAX)) {
+            printf("--sync-test: invalid speed in \"%s\" (expected %g ~ %g, comma separated)\n",
+                text, SPEED_MIN, SPEED_MAX);
+            return -1;
+        }
+        speeds.push_back((float)speed);
+        if (*end == '\0')
+            break;
+        p = end + 1;
+    }
+
+    return 0;
 };
 
 // =======================
 // 主函数
+// 用法：
+//   player                          交互式选择并播放 ./videos 下的视频（仅 Windows）
+//   player --bench <文件> [--paced | --virtual] [--assert-no-alloc]
+//                                   无界面性能测试，结束后输出吞吐和各线程 CPU 时间；
+//                                   --virtual 使用虚拟时钟，同步行为与 --paced 相同但不等待真实时间
+//                                   <文件> 也可以是 synth:<参数> 或 lavfi:<滤镜图>，不需要媒体文件（见 synthmedia.h）
+//                                   --assert-no-alloc 预热后本仓库代码每帧还有堆分配时以非零状态退出（需要 PLAYER_ALLOC_HOOK 构建）
+//   player --microbench [结果.json]  队列 / 时钟 / 音频转换 / YUV 拷贝等热点组件的微基准测试，结果为 JSON
+//   player --sync-test [倍速列表] [--paced | --virtual | --sdl]
+//                                   音视频同步精度测试，默认倍速 0.5,1.0,1.5（每项 0.5 ~ 100）、空输出端实时播放；
+//                                   --sdl 使用真实窗口和声卡
+//   以上任一模式加 --trace <文件.json>：记录各线程活动，退出时写出 Chrome trace（Perfetto 可打开）
+//   交互模式加 --stats-port <端口>：在 http://127.0.0.1:<端口>/metrics 输出 Prometheus 格式指标
+//   交互模式加 --vsync：垂直同步，每帧排到离其 pts 最近的 vblank 显示
+//   交互模式或 --bench 加 --shm-export <名字>：把视频帧导出到共享内存帧环，供其他进程读取（见 shmring.h）
+//   player --shm-read <名字> [秒数]   共享内存帧环的示例读端：原地读取每帧，输出帧率、吞吐和丢帧
 // =======================
-int main()
+int main(int argc, char* argv[])
 {
     // 设置 FFmpeg 日志级别，只显示错误信息
     av_log_set_level(AV_LOG_ERROR);
 
+    // ===================== 命令行参数 =====================
+    const char* bench_url = nullptr;     // --bench <文件>
+    bool microbench = false;             // --microbench [结果.json]
+    const char* microbench_path = nullptr;
+    bool sync_test = false;              // --sync-test [倍速列表]
+    std::vector<float> sync_speeds = { 0.5f, 1.0f, 1.5f };
+    const char* trace_path = nullptr;    // --trace <文件.json>
+    int stats_port = 0;                  // --stats-port <端口>，0 表示不开启
+    bool vsync = false;                  // --vsync
+    bool assert_no_alloc = false;        // --assert-no-alloc（--bench）
+    const char* shm_export = nullptr;    // --shm-export <名字>
+    const char* shm_read = nullptr;      // --shm-read <名字> [秒数]
+    double shm_read_seconds = 0.0;
+    SinkType bench_type = SinkType::NullFast;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            bench_url = argv[++i];
+        else if (strcmp(argv[i], "--microbench") == 0) {
+            microbench = true;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+                microbench_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sync-test") == 0) {
+            sync_test = true;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                // 逗号分隔的倍速列表
+                if (ParseSpeedList(argv[++i], sync_speeds) < 0)
+                    return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--sdl") == 0)
+            bench_type = SinkType::Sdl;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--stats-port") == 0 && i + 1 < argc)
+            stats_port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vsync") == 0)
+            vsync = true;
+        else if (strcmp(argv[i], "--assert-no-alloc") == 0)
+            assert_no_alloc = true;
+        else if (strcmp(argv[i], "--shm-export") == 0 && i + 1 < argc)
+            shm_export = argv[++i];
+        else if (strcmp(argv[i], "--shm-read") == 0 && i + 1 < argc) {
+            shm_read = argv[++i];
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+                shm_read_seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--paced") == 0)
+            bench_type = SinkType::NullPaced;
+        else if (strcmp(argv[i], "--virtual") == 0)
+            bench_type = SinkType::NullVirtual;
+    }
+
+    // 追踪文件在进程退出时写出（Esc 可能在任意位置直接 exit）
+    if (trace_path) {
+        TraceStart(trace_path);
+        atexit([] { TraceStop(); });
+    }
+
+    // ===================== 性能测试模式 =====================
+    if (microbench)
+        return RunMicroBenchmarks(microbench_path) == 0 ? 0 : 1;
+    if (sync_test)
+        return RunSyncAccuracyTest(bench_type, sync_speeds) == 0 ? 0 : 1;
+    if (bench_url)
+        return RunPipelineBenchmark(bench_url, bench_type, shm_export, assert_no_alloc) == 0 ? 0 : 1;
+    if (shm_read)
+        return RunShmReader(shm_read, shm_read_seconds) == 0 ? 0 : 1;
+
+    // 交互模式退出时输出视频帧各阶段延迟与帧节奏统计（Esc 可能在任意位置直接 exit）
+    atexit([] {
+        FrameLatency::Instance().Dump(stdout);
+        FramePacing::Instance().Dump(stdout);
+    });
+
+#ifdef _WIN32
     // 视频存放目录
     string video_dir = "./videos";
 
+    // 媒体探测器：结果缓存在视频目录下，下次启动时未改动的文件无需重新探测
+    MediaProbe probe(video_dir + "\\.probe_cache");
+
+    // 播放器控制器在整个程序生命周期内只创建一次：
+    // 切换视频时复用 SDL 窗口、音频设备和解码器，只在参数变化时重新配置
+    MainController controller;
+    controller.setVsync(vsync);
+    bool burst = false;  // 是否在连拍
+
+    // 可选：视频帧导出到共享内存，推理等进程外的消费者直接映射读取
+    ShmFrameExporter shm_exporter;
+    if (shm_export) {
+        TapOptions tap_options;
+        tap_options.capacity = 2;  // 导出线程跟不上时丢最旧的帧
+        shm_exporter.Start(shm_export, controller.subscribeFrames(AVMEDIA_TYPE_VIDEO, "shm", tap_options));
+    }
+
+    // 可选的本地统计接口（长时间运行的播放器用 Prometheus 采集）
+    StatsServer stats_server(&controller);
+    if (stats_port > 0)
+        stats_server.Start(stats_port);
+
     // ===================== 外层循环：视频选择 =====================
     // 当用户选择退出当前视频（按E键）时，会回到这里选择新视频
     while (true) {
         // 调用 SelectVideo 函数，让用户选择要播放的视频
-        string video_path = SelectVideo(video_dir);
+        MediaInfo video = SelectVideo(video_dir, probe);
 
-        // 如果返回空字符串，表示没有视频或用户取消，退出程序
-        if (video_path.empty())
+        // 如果返回空路径，表示没有视频或用户取消，退出程序
+        if (video.file.path.empty())
             break;  // 退出外层循环，进而结束程序
 
-        // ========== 创建主控制器，准备播放选中的视频 ==========
+        // ========== 设置主控制器，准备播放选中的视频 ==========
         // MainController 是整个播放器的核心，管理所有播放组件
-        MainController controller(video_path.c_str());
+        // 传入探测到的容器格式，打开文件时跳过格式探测
+        controller.setUrl(video.file.path.c_str(), video.format_name.c_str());
 
         // ========== 显示播放器控制功能说明 ==========
         cout << "\n功能列表:\n";
@@ -189,7 +402,10 @@ int main()
         cout << "2.暂停：空格键\n";
         cout << "3.慢放：快捷键'S/s'，按一次切换至0.5倍速，再按一次回到1倍速\n";
         cout << "4.结束当前视频：快捷键'E/e'\n";
-        cout << "5.退出程序：Esc键\n";
+        cout << "5.显示/隐藏指标叠加层：快捷键'I/i'\n";
+        cout << "6.输出帧节奏统计：快捷键'P/p'\n";
+        cout << "7.截图（PNG，保存在当前目录）：快捷键'C/c'；连拍（每30帧一张）开始/停止：快捷键'B/b'\n";
+        cout << "8.退出程序：Esc键\n";
 
         // ===================== 内层循环：播放控制 =====================
         // 处理当前视频的播放控制，直到用户选择结束当前视频
@@ -223,6 +439,29 @@ int main()
                         controller.stop();  // 清理播放资源
                     return 0;  // 直接退出程序
                 }
+                // ------------ I/i：指标叠加层 ------------
+                else if (ch == 'i' || ch == 'I') {
+                    controller.setOverlay(!controller.overlay());
+                }
+                // ------------ P/p：帧节奏统计 ------------
+                else if (ch == 'p' || ch == 'P') {
+                    FramePacingStats pacing = controller.GetFramePacing();
+                    printf("帧时间(ms) p50 %.2f  p90 %.2f  p99 %.2f  max %.2f | 晚帧 %lld  重复帧 %lld  跳过pts %lld\n",
+                        pacing.frame_time_p50_us / 1000.0, pacing.frame_time_p90_us / 1000.0,
+                        pacing.frame_time_p99_us / 1000.0, pacing.frame_time_max_us / 1000.0,
+                        (long long)pacing.late_frames, (long long)pacing.repeated_frames,
+                        (long long)pacing.skipped_pts);
+                }
+                // ------------ C/c：截图 ------------
+                else if (ch == 'c' || ch == 'C') {
+                    controller.snapshot(PrintSnapshot);
+                }
+                // ------------ B/b：连拍开始 / 停止 ------------
+                else if (ch == 'b' || ch == 'B') {
+                    burst = !burst;
+                    controller.setSnapshotBurst(burst ? SNAPSHOT_BURST_EVERY : 0, PrintSnapshot);
+                    cout << (burst ? "连拍开始\n" : "连拍停止\n");
+                }
                 // ------------ S/s：倍速切换 ------------
                 else if (ch == 's' || ch == 'S') {
                     // 获取当前倍速，在0.5x和1.0x之间切换
@@ -239,6 +478,14 @@ int main()
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
     }
+#else
+    (void)stats_port;  // 交互模式仅 Windows 可用
+    (void)vsync;
+    cout << "usage: " << argv[0] << " --bench <file> [--paced | --virtual] [--assert-no-alloc] [--trace <file.json>] [--shm-export <name>]" << endl;
+    cout << "       " << argv[0] << " --microbench [results.json]" << endl;
+    cout << "       " << argv[0] << " --sync-test [0.5,1.0,1.5] [--paced | --virtual | --sdl]" << endl;
+    cout << "       " << argv[0] << " --shm-read <name> [seconds]" << endl;
+#endif // _WIN32
 
     return 0;
 };
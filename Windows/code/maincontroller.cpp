@@ -1,28 +1,83 @@
 #include "maincontroller.h"
+#include "threadutil.h"
+#include "tracing.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
+// ֡йڴԤ㣺ڴ 1/64 32MB ~ 256MB ֮
+// 8GB ڴĻԻԼ 10 ֡ 4K 4K Ҳֻ֡˻ҳ
+#define FRAME_BUDGET_MIN ((int64_t)32 * 1024 * 1024)
+#define FRAME_BUDGET_MAX ((int64_t)256 * 1024 * 1024)
+// Ƶ֡໺ʱ΢룩
+#define VIDEO_QUEUE_MAX_DURATION 400000
+// Ƶ֡еСǰʱ΢룩СǰܹԤ
+#define AUDIO_QUEUE_MIN_DURATION 500000
+#define AUDIO_QUEUE_MAX_DURATION 1000000
+
 /*
  * 캯
  * Ƶ Packet/Frame 
  */
 MainController::MainController(const char* url)
 {
-    m_url = url;  // Ƶļ·ָ븳ֵ
+    if (url)
+        m_url = url;  // Ƶļ·
 
     // ĸж̼߳ݴ
-    audio_packet_queue = new AVPacketQueue();  // Ƶ
-    video_packet_queue = new AVPacketQueue();  // Ƶ
-    audio_frame_queue = new AVFrameQueue();    // Ƶ֡
-    video_frame_queue = new AVFrameQueue();    // Ƶ֡
+    audio_packet_queue = new AVPacketQueue("audio_packet");  // Ƶ
+    video_packet_queue = new AVPacketQueue("video_packet");  // Ƶ
+    audio_frame_queue = new AVFrameQueue("audio_frame");     // Ƶ֡
+    video_frame_queue = new AVFrameQueue("video_frame");     // Ƶ֡
+
+    // ֽ֡ʱƣ֡йһڴԤ
+    frame_budget.SetLimit(std::min(std::max(SystemMemoryBytes() / 64, FRAME_BUDGET_MIN),
+        FRAME_BUDGET_MAX));
+
+    FrameQueueLimits audio_limits;
+    audio_limits.min_frames = 1;
+    audio_limits.min_duration_us = AUDIO_QUEUE_MIN_DURATION;
+    audio_limits.max_duration_us = AUDIO_QUEUE_MAX_DURATION;
+    audio_frame_queue->SetLimits(audio_limits, &frame_budget);
+
+    FrameQueueLimits video_limits;
+    video_limits.min_frames = 3;
+    video_limits.max_duration_us = VIDEO_QUEUE_MAX_DURATION;
+    video_frame_queue->SetLimits(video_limits, &frame_budget);
 };
 
 /*
- * ֹͣŲԴ
+ * ֹͣţ̲߳Դ
  */
 MainController::~MainController()
 {
     stop();
+
+    // ֪ͨפ߳˳Լ߳ͷŴںƵ豸
+    {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        exit_requested = true;
+    }
+    session_cv.notify_all();
+
+    if (play_thread.joinable())
+        play_thread.join();
+
+    // ̳߳жָ룬ڶ֮ǰɾReleaseAll ɣ
+    delete audio_packet_queue;
+    delete video_packet_queue;
+    delete audio_frame_queue;
+    delete video_frame_queue;
+};
+
+/*
+ * һβŵļ
+ */
+void MainController::setUrl(const char* url, const char* format_name)
+{
+    m_url = url ? url : "";
+    m_format_name = format_name ? format_name : "";
+    speed_ = 1.0f;  // ļٶȿʼ
 };
 
 /*===================================================================
@@ -31,10 +86,13 @@ MainController::~MainController()
 
  /*
   * start()
-  * ̨̣߳ڲִ²裺
-  *   1. InitAll() ʼģ
+  * ̨߳ύһβ󣬲߳ڲִУ
+  *   1. InitAll() ʼ / ģ
   *   2. StartAllThreads() ⸴+
   *   3. MainLoop() ƵȾѭ
+  *
+  * ֻ߳ڵһ start() ʱ֮פ
+  *  SDL ںȾԿļ
   */
 void MainController::start()
 {
@@ -43,29 +101,63 @@ void MainController::start()
 
     // ־
     started = true;
+    stop_requested = false;
+
+    // ״ʱפ߳
+    if (!play_thread.joinable())
+        play_thread = std::thread(&MainController::PlayLoop, this);
+
+    // ύ
+    {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        session_requested = true;
+    }
+    session_cv.notify_all();
+};
+
+/*
+ * פ̣߳ȴ start() ļִ ʼ    
+ */
+void MainController::PlayLoop()
+{
+    SetCurrentThreadName("play");
+
+    while (true) {
+        // ȴ˳
+        {
+            std::unique_lock<std::mutex> lk(session_mtx);
+            session_cv.wait(lk, [this]() {
+                return session_requested || exit_requested;
+                });
+            if (exit_requested)
+                break;
+            session_requested = false;
+        }
 
-    // ̨߳
-    play_thread = std::thread([this]() {
         // 1ʼģ
         if (InitAll() < 0) {
             printf("InitAll failed\n");
-            started = false;  // ʼʧܣñ־
-            return;
+            StopAndClean();  // ͷѴĲֲñ־
+            continue;
         }
 
         // 2д̣߳⸴+룩
         if (StartAllThreads() < 0) {
             printf("StartAllThreads failed\n");
-            started = false;
-            return;
+            StopAndClean();
+            continue;
         }
 
-        // 3Ⱦѭֱڹرգ
-        MainLoop();
-        });
+        // 3Ⱦѭֱڹرջ stop()
+        if (!stop_requested)
+            MainLoop();
+
+        // 4ǰļ / Ƶ豸 / 
+        StopAndClean();
+    }
 
-    // ̣߳ʹ
-    play_thread.detach();
+    // ߳˳ǰͷſɸڱڴ߳٣
+    ReleaseAll();
 };
 
 /*
@@ -77,6 +169,14 @@ void MainController::pause()
         return;
 
     paused = true;
+
+    // ʱӺһͣƵƵȾѭڻָǰ
+    std::lock_guard<std::mutex> lk(session_mtx);
+    avsync.Pause();
+    if (audio_output)
+        audio_output->Pause();
+    if (video_output)
+        video_output->Pause();
 };
 
 /*
@@ -92,6 +192,14 @@ void MainController::resume()
         std::lock_guard<std::mutex> lk(pause_mtx);
         paused = false;
     }
+    {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        avsync.Resume();
+        if (audio_output)
+            audio_output->Resume();
+        if (video_output)
+            video_output->Resume();
+    }
 
     // ֪ͨеȴ߳
     pause_cv.notify_all();
@@ -104,10 +212,72 @@ void MainController::setSpeed(float s)
 {
     speed_ = s;
 
+    // ʱӰ±ƣƵݴ˼һ֡ĵʱ
+    avsync.SetSpeed(s);
+
+    // Ƶؽ˾ͼͲ̵߳ Init / Reconfigure 
+    std::lock_guard<std::mutex> lk(session_mtx);
     if (audio_output)
         audio_output->SetSpeed(s);
 };
 
+/*
+ * ʾ / ָӲ㣨δʱڴЧ
+ */
+void MainController::setOverlay(bool on)
+{
+    overlay_ = on;
+
+    std::lock_guard<std::mutex> lk(session_mtx);
+    if (video_output)
+        video_output->SetOverlay(on);
+};
+
+/*
+ * ͼ󽻸ͼ̣߳ʾ֡Ⱦ߳һˢʱȡ
+ */
+int64_t MainController::snapshot(SnapshotCallback done)
+{
+    return snapshot_writer_.RequestOne(std::move(done));
+};
+
+void MainController::setSnapshotBurst(int every_n, SnapshotCallback done)
+{
+    snapshot_writer_.SetBurst(every_n, std::move(done));
+};
+
+/*
+ * Ľ֡ĵ MainController У̴߳ǰҲЧ
+ */
+std::shared_ptr<FrameSubscription> MainController::subscribeFrames(AVMediaType type,
+    const std::string& name, const TapOptions& options)
+{
+    FrameTap& tap = type == AVMEDIA_TYPE_AUDIO ? audio_tap_ : video_tap_;
+    return tap.Subscribe(name, options);
+};
+
+void MainController::unsubscribeFrames(const std::shared_ptr<FrameSubscription>& subscription)
+{
+    video_tap_.Unsubscribe(subscription);
+    audio_tap_.Unsubscribe(subscription);
+};
+
+/*
+ * ʱָ
+ */
+std::vector<MetricValue> MainController::GetStats()
+{
+    return MetricsRegistry::Instance().Snapshot();
+};
+
+/*
+ * Ƶ֡ͳ
+ */
+FramePacingStats MainController::GetFramePacing()
+{
+    return FramePacing::Instance().Snapshot();
+};
+
 /*
  * ͣ״̬
  */
@@ -116,6 +286,64 @@ bool MainController::isPaused() const
     return paused;
 };
 
+/*
+ * ǰļǷȫ꣺
+ * ⸴öβհ̳߳ˢϺ˳ȡ֡
+ */
+bool MainController::isFinished()
+{
+    std::lock_guard<std::mutex> lk(session_mtx);
+
+    if (!started || !demux_thread || !audio_decode_thread || !video_decode_thread)
+        return false;
+
+    return demux_thread->IsEof()
+        && audio_decode_thread->IsFinished()
+        && video_decode_thread->IsFinished()
+        && audio_frame_queue->Size() == 0
+        && video_frame_queue->Size() == 0;
+};
+
+/*
+ * ȡˮͳƿ
+ */
+PipelineStats MainController::GetPipelineStats()
+{
+    PipelineStats stats;
+
+    stats.audio_packet_queue_size = audio_packet_queue->Size();
+    stats.video_packet_queue_size = video_packet_queue->Size();
+    stats.audio_frame_queue_size = audio_frame_queue->Size();
+    stats.video_frame_queue_size = video_frame_queue->Size();
+    stats.master_clock = avsync.GetClock();
+
+    std::lock_guard<std::mutex> lk(session_mtx);
+
+    if (demux_thread) {
+        stats.packets_read = demux_thread->PacketsRead();
+        stats.demux_cpu_us = demux_thread->CpuTimeUs();
+    }
+    if (audio_decode_thread) {
+        stats.audio_frames_decoded = audio_decode_thread->FramesDecoded();
+        stats.audio_samples_decoded = audio_decode_thread->SamplesDecoded();
+        stats.audio_decode_cpu_us = audio_decode_thread->CpuTimeUs();
+    }
+    if (video_decode_thread) {
+        stats.video_frames_decoded = video_decode_thread->FramesDecoded();
+        stats.video_decode_cpu_us = video_decode_thread->CpuTimeUs();
+    }
+    if (audio_output) {
+        stats.audio_samples_played = audio_output->SamplesPlayed();
+        stats.audio_sink_cpu_us = audio_output->CpuTimeUs();
+    }
+    if (video_output) {
+        stats.video_frames_presented = video_output->FramesPresented();
+        stats.video_sink_cpu_us = video_output->CpuTimeUs();
+    }
+
+    return stats;
+};
+
 /*
  * ͣȴָ
  */
@@ -132,26 +360,38 @@ void MainController::WaitIfPaused()
 
 /*
  * ֹͣţӿڣ
+ * ֪ͨȾѭ˳ȴ߳
  */
 void MainController::stop()
 {
-    StopAndClean();
+    if (!started)
+        return;
+
+    stop_requested = true;
+
+    std::unique_lock<std::mutex> lk(session_mtx);
+    if (video_output)
+        video_output->RequestQuit();
+
+    // ȴִ߳ StopAndClean()
+    session_cv.wait(lk, [this]() {
+        return !started;
+        });
 };
 
 /*
  * Ⱦѭ VideoOutput SDL ڣ
- * ֱڹرպ˳ִ
+ * ֱڹرջ stop() ˳ PlayLoop() 
  */
 void MainController::MainLoop()
 {
     if (video_output)
         video_output->MainLoop(); // ڲֱ˳
-
-    stop();
 };
 
 /*
  * ˳򴴽ͳʼвģ
+ * ⸴⣬ģֻڵһβʱ֮ļĲ
  * ʼ˳
  *   1. ⸴ (DemuxThread)
  *   2. Ƶ (DecodeThread)
@@ -164,18 +404,37 @@ int MainController::InitAll()
 {
     int ret = 0;  // ֵ
 
+    // һļʱѱֹ
+    audio_packet_queue->Reset();
+    video_packet_queue->Reset();
+    audio_frame_queue->Reset();
+    video_frame_queue->Reset();
+
     /*--------------------- 1. ⸴ʼ ---------------------*/
-    demux_thread = new DemuxThread(audio_packet_queue, video_packet_queue, this);
-    ret = demux_thread->Init(m_url);  // ýļƵ
+    {
+        // ̶ָ߳ᱻ GetPipelineStats() ̶߳ȡ
+        std::lock_guard<std::mutex> lk(session_mtx);
+        demux_thread = new DemuxThread(audio_packet_queue, video_packet_queue, this);
+    }
+    ret = demux_thread->Init(m_url.c_str(), m_format_name.c_str());  // ýļƵ
     if (ret < 0) {
         printf("%s(%d) demux_thread Init failed\n", __FUNCTION__, __LINE__);
 
         return ret;  // ʼʧܣֱӷ
     }
 
+    // Ƶ֡ʱ㣨Ƶ֡еĻʱ
+    AVStream* video_stream = demux_thread->IfmtCtx()->streams[demux_thread->VideoStreamIndex()];
+    video_frame_queue->SetStreamInfo(video_stream->time_base,
+        av_guess_frame_rate(demux_thread->IfmtCtx(), video_stream, NULL));
+
     /*--------------------- 2. Ƶʼ ---------------------*/
-    audio_decode_thread = new DecodeThread(audio_packet_queue, audio_frame_queue, this);
-    // ȡƵʼ
+    if (!audio_decode_thread) {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        audio_decode_thread = new DecodeThread(audio_packet_queue, audio_frame_queue, this);
+        audio_decode_thread->SetFrameTap(&audio_tap_);
+    }
+    // ȡƵʼʱѴ򿪵Ľ
     ret = audio_decode_thread->Init(demux_thread->AudioCodecParameters());
     if (ret < 0) {
         printf("%s(%d) audio_decode_thread Init failed\n", __FUNCTION__, __LINE__);
@@ -184,9 +443,23 @@ int MainController::InitAll()
     }
 
     /*--------------------- 3. Ƶʼ ---------------------*/
-    video_decode_thread = new DecodeThread(video_packet_queue, video_frame_queue, this);
-    // ȡƵʼ
-    ret = video_decode_thread->Init(demux_thread->VideoCodecParameters());
+    if (!video_decode_thread) {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        video_decode_thread = new DecodeThread(video_packet_queue, video_frame_queue, this);
+        video_decode_thread->SetFrameTap(&video_tap_);
+    }
+    // SDL еʾߴ磺ƵԶʱɽСlowres / ʽ²
+    // ˰ԭʼߴ룬ֻ׼ԵĹ
+    AVCodecParameters* video_par = demux_thread->VideoCodecParameters();
+    if (sink_type_ == SinkType::Sdl && video_par && video_par->width > 0 && video_par->height > 0) {
+        SDL_Rect rect = CalcLetterBoxRect(video_par->width, video_par->height);
+        video_decode_thread->SetTargetSize(rect.w, rect.h);
+    }
+    else {
+        video_decode_thread->SetTargetSize(0, 0);
+    }
+    // ȡƵʼʱѴ򿪵Ľ
+    ret = video_decode_thread->Init(video_par);
     if (ret < 0) {
         printf("%s(%d) video_decode_thread Init failed\n", __FUNCTION__, __LINE__);
 
@@ -194,7 +467,15 @@ int MainController::InitAll()
     }
 
     /*--------------------- 4. ͬʱӳʼ ---------------------*/
+    // ʱģʽʱ 0 ʼֻ˶ڵȴʱǰ
+    VirtualClock* virtual_clock_ptr = nullptr;
+    if (sink_type_ == SinkType::NullVirtual) {
+        virtual_clock.Reset();
+        virtual_clock_ptr = &virtual_clock;
+    }
+    avsync.SetClockSource(virtual_clock_ptr);
     avsync.InitClock();  // ʼƵʱΪʱ
+    avsync.SetSpeed(speed_);
 
     /*--------------------- 5. Ƶģʼ ---------------------*/
     // ׼Ƶṹ
@@ -206,16 +487,39 @@ int MainController::InitAll()
     audio_params.fmt = audio_decode_thread->GetAVCodecContext()->sample_fmt;        // ʽ
     audio_params.freq = audio_decode_thread->GetAVCodecContext()->sample_rate;      // 
 
-    // Ƶģ
-    audio_output = new AudioOutput(
-        &avsync,                          // ͬʱ
-        audio_params,                     // Ƶ
-        audio_frame_queue,                // Ƶ֡
-        demux_thread->AudioStreamTimebase()  // Ƶʱ
-    );
+    if (!audio_output) {
+        // ״βţʹƵģ
+        AudioSink* output = nullptr;
+        if (sink_type_ == SinkType::Sdl) {
+            output = new AudioOutput(
+                &avsync,                          // ͬʱ
+                audio_params,                     // Ƶ
+                audio_frame_queue,                // Ƶ֡
+                demux_thread->AudioStreamTimebase()  // Ƶʱ
+            );
+        }
+        else {
+            output = new NullAudioSink(&avsync, audio_params, audio_frame_queue,
+                demux_thread->AudioStreamTimebase(), sink_type_ == SinkType::NullPaced,
+                virtual_clock_ptr);
+        }
+        std::lock_guard<std::mutex> lk(session_mtx);
+        audio_output = output;
 
-    // ʼƵSDLƵ豸
-    ret = audio_output->Init();
+        // ʼƵSDLƵ豸
+        ret = audio_output->Init();
+    }
+    else {
+        // ãʲʱ´ SDL Ƶ豸setSpeed ؽ˾ͼ
+        std::lock_guard<std::mutex> lk(session_mtx);
+        ret = audio_output->Reconfigure(audio_params, audio_frame_queue,
+            demux_thread->AudioStreamTimebase());
+    }
+    // start() ֮ǰõı٣½õ˶Ч
+    if (ret >= 0) {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        audio_output->SetSpeed(speed_);
+    }
     if (ret < 0) {
         printf("%s(%d) audio_output Init failed\n", __FUNCTION__, __LINE__);
 
@@ -223,22 +527,58 @@ int MainController::InitAll()
     }
 
     /*--------------------- 6. Ƶģʼ ---------------------*/
-    video_output = new VideoOutput(
-        &avsync,                          // ͬʱ
-        video_frame_queue,                // Ƶ֡
-        video_decode_thread->GetAVCodecContext()->width,     // Ƶ
-        video_decode_thread->GetAVCodecContext()->height,    // Ƶ߶
-        demux_thread->VideoStreamTimebase()  // Ƶʱ
-    );
-
-    // ʼƵSDLڣ
-    ret = video_output->Init();
+    if (!video_output) {
+        // ״βţʹƵģ
+        VideoSink* output = nullptr;
+        if (sink_type_ == SinkType::Sdl) {
+            VideoOutput* sdl_output = new VideoOutput(
+                &avsync,                          // ͬʱ
+                video_frame_queue,                // Ƶ֡
+                video_decode_thread->GetAVCodecContext()->width,     // Ƶ
+                video_decode_thread->GetAVCodecContext()->height,    // Ƶ߶
+                demux_thread->VideoStreamTimebase()  // Ƶʱ
+            );
+            sdl_output->SetVsync(vsync_);         // Ⱦ֮ǰǷֱͬ
+            output = sdl_output;
+        }
+        else {
+            output = new NullVideoSink(&avsync, video_frame_queue,
+                video_decode_thread->GetAVCodecContext()->width,
+                video_decode_thread->GetAVCodecContext()->height,
+                demux_thread->VideoStreamTimebase(), sink_type_ == SinkType::NullPaced,
+                virtual_clock_ptr);
+        }
+        output->SetSnapshotWriter(&snapshot_writer_);  // ˺
+        output->SetOverlayListener([this](bool on) { overlay_ = on; });  // ڰ I 
+        {
+            std::lock_guard<std::mutex> lk(session_mtx);
+            video_output = output;
+        }
+
+        // ʼƵSDLڣ
+        ret = video_output->Init();
+        video_output->SetOverlay(overlay_);
+    }
+    else {
+        // ãںȾֱʱ仯ʱؽ
+        ret = video_output->Reconfigure(video_frame_queue,
+            video_decode_thread->GetAVCodecContext()->width,
+            video_decode_thread->GetAVCodecContext()->height,
+            demux_thread->VideoStreamTimebase());
+    }
     if (ret < 0) {
         printf("%s(%d) video_output Init failed\n", __FUNCTION__, __LINE__);
 
         return ret;
     }
 
+    // ʾ˲ֱʾظʽƵ߳ת
+    video_decode_thread->SetDisplayFormats(video_output->DisplayFormats());
+
+    // ֡߰ǰļʱ pts
+    audio_tap_.SetTimeBase(demux_thread->AudioStreamTimebase());
+    video_tap_.SetTimeBase(demux_thread->VideoStreamTimebase());
+
     return 0;  // гʼɹ
 };
 
@@ -265,7 +605,8 @@ int MainController::StartAllThreads()
 };
 
 /*
- * ȷ˳ֹͣͷԴ
+ * ȷ˳ֹͣͷŵǰļԴ
+ * ڡƵ豸ͽһļ
  */
 void MainController::StopAndClean()
 {
@@ -289,13 +630,9 @@ void MainController::StopAndClean()
     if (audio_decode_thread) audio_decode_thread->Stop();  // ֹͣƵ߳
     if (demux_thread)        demux_thread->Stop();         // ֹͣ⸴߳
 
-    /*------------- 3. ɾƵģ -------------*/
-    // ֹͣģ飬ɾ
-
-    delete audio_output;   // ɾƵģ飨رSDLƵ豸
-    delete video_output;   // ɾƵģ飨رSDLڣ
-    audio_output = nullptr;
-    video_output = nullptr;
+    /*------------- 3. Ƶ -------------*/
+    // 豸ִ򿪣صҲƶʱ
+    if (audio_output) audio_output->Pause();
 
     /*------------- 4. ն -------------*/
     // ֡У
@@ -306,16 +643,49 @@ void MainController::StopAndClean()
     audio_packet_queue->Abort();  // ֹвͷа
     video_packet_queue->Abort();
 
-    /*------------- 5. ɾ̶߳ -------------*/
-    delete audio_decode_thread;  // ɾƵ̶߳
-    delete video_decode_thread;  // ɾƵ̶߳
-    delete demux_thread;         // ɾ⸴̶߳
-
-    audio_decode_thread = nullptr;
-    video_decode_thread = nullptr;
-    demux_thread = nullptr;
+    /*------------- 5. ɾ⸴ÿļһ -------------*/
+    {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        delete demux_thread;         // ɾ⸴̶߳󣨹رļ
+        demux_thread = nullptr;
+    }
 
     /*------------- 6. ò״̬ -------------*/
-    started = false;  // ־
     paused = false;   // ͣ־
+    {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        started = false;  // ־
+    }
+    session_cv.notify_all();  // ѵȴе stop()
+};
+
+/*
+ * ͷſɸõ߳˳ǰã
+ */
+void MainController::ReleaseAll()
+{
+    AudioSink* audio = nullptr;
+    VideoSink* video = nullptr;
+    DecodeThread* audio_decode = nullptr;
+    DecodeThread* video_decode = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(session_mtx);
+        audio = audio_output;
+        video = video_output;
+        audio_decode = audio_decode_thread;
+        video_decode = video_decode_thread;
+        audio_output = nullptr;
+        video_output = nullptr;
+        audio_decode_thread = nullptr;
+        video_decode_thread = nullptr;
+    }
+
+    delete audio;          // ɾƵģ飨رSDLƵ豸
+    if (video) {
+        video->DeInit();   // ٴ / Ⱦ / 
+        delete video;
+    }
+
+    delete audio_decode;  // ɾƵ̶߳ͷŽģ
+    delete video_decode;  // ɾƵ̶߳
 };
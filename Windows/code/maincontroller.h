@@ -5,10 +5,41 @@
 #include "decodethread.h"
 #include "audiooutput.h"
 #include "videooutput.h"
+#include "nullsink.h"
 #include "avsync.h"
+#include "framepacing.h"
+#include "snapshot.h"
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <string>
+
+/*
+ * ˮ߸׶εͳƿգGetPipelineStats أ
+ * ΪǰļʼۼֵCPU ʱ䵥λΪ΢
+ */
+struct PipelineStats {
+    int64_t packets_read = 0;           // ⸴öȡİ
+    int64_t video_frames_decoded = 0;   // Ƶ֡
+    int64_t audio_frames_decoded = 0;   // Ƶ֡
+    int64_t audio_samples_decoded = 0;  // Ƶÿ
+    int64_t video_frames_presented = 0; // Ƶѵ֡
+    int64_t audio_samples_played = 0;   // Ƶѵ
+
+    int audio_packet_queue_size = 0;    // ǰг
+    int video_packet_queue_size = 0;
+    int audio_frame_queue_size = 0;
+    int video_frame_queue_size = 0;
+
+    double master_clock = 0.0;          // ʱӣýʱ䣬룩
+
+    int64_t demux_cpu_us = 0;           // ׶߳ CPU ʱ
+    int64_t audio_decode_cpu_us = 0;
+    int64_t video_decode_cpu_us = 0;
+    int64_t audio_sink_cpu_us = 0;
+    int64_t video_sink_cpu_us = 0;
+};
 
 /*
  * MainController
@@ -21,17 +52,28 @@
  *
  * ע⣺
  *   - MainLoop() ƵȾѭSDL ڣ
+ *   - һ MainController βŶļsetUrl + start / stop
+ *     SDL ڡȾƵ豸ͼݵĽļ֮临ã
+ *     ֻзֱʡʻ仯ʱ´
  */
 class MainController
 {
 public:
     // ================ 캯 ================
-    MainController(const char* url);  // 캯Ƶļ·
+    MainController(const char* url = nullptr);  // 캯Ƶļ·
     ~MainController();                 // ȷԴͷ
 
     // ================ ƽӿ ================
     //  main.cpp ãӦûļ
 
+    /**
+     * @brief һ start() ŵļ
+     * @param url Ƶļ·ڲ渱
+     * @param format_name ʽý̽⻺棬Ϊգ
+     * ܣлļʱãٻָΪ 1.0
+     */
+    void setUrl(const char* url, const char* format_name = nullptr);
+
     /**
      * @brief ʼţʼ + ̣߳
      * ܣ״ִ̨߳гʼ
@@ -39,8 +81,9 @@ public:
     void start();
 
     /**
-     * @brief ֹͣŲͷԴ
-     * ܣֹ̣ͣ߳Դصʼ״̬
+     * @brief ֹͣ
+     * ܣȾѭֹ̲ͣ߳նУǰļֹͣ
+     *       ڡƵ豸ͽһļʹ
      */
     void stop();
 
@@ -73,7 +116,8 @@ public:
     /**
      * @brief òű
      * @param s µıֵ0.5-1.0
-     * ܣ޸ƵٶȣƵͨʱͬ
+     * ܣ޸ƵٶȣƵͨʱͬ棻
+     *       Ҳ setUrl ֮start() ֮ǰãļͷͰñٲ
      */
     void setSpeed(float s);
 
@@ -89,6 +133,85 @@ public:
      */
     bool isStarted() const { return started; }
 
+    /**
+     * @brief ѡͣSDL / 
+     * @param type 
+     * ܣڵһ start() ֮ǰãʾ / µܲ
+     */
+    void setSinkType(SinkType type) { sink_type_ = type; }
+
+    /**
+     * @brief ֱͬȾʾˢύÿ֡ŵ pts  vblank
+     * ܣڵһ start() ֮ǰãֻ SDL Ч
+     */
+    void setVsync(bool on) { vsync_ = on; }
+
+    /**
+     * @brief ͼȡʾ֡ͣʱΪͣĻ棩
+     * @param done ɻصڽͼ߳ϵãΪգ
+     * @return ͼţصе SnapshotResult::id Ӧ
+     * ܣȾֻ߳֡һãתдļڽͼ߳ɣӰ첥ţ
+     *       ֻ SDL Ч֮ǰȵһ֡ʾʱ
+     */
+    int64_t snapshot(SnapshotCallback done = nullptr);
+
+    /**
+     * @brief ģÿʾ every_n ֡һţ0 ʾֹͣͼ̸߳ʱsnapshot.dropped
+     * @param done ÿʱĻصڽͼ߳ϵãΪգ
+     */
+    void setSnapshotBurst(int every_n, SnapshotCallback done = nullptr);
+
+    /**
+     * @brief ͼʽPNG / JPEGĿ¼ JPEG ֮ĽͼЧ
+     */
+    void setSnapshotOptions(const SnapshotOptions& options) { snapshot_writer_.SetOptions(options); }
+
+    /**
+     * @brief Ľ֡˶⡢OCR ȷãҪٽһΣ̵߳ã
+     * @param type AVMEDIA_TYPE_VIDEO / AVMEDIA_TYPE_AUDIO
+     * @param name ָ֣Ϊ tap.<video|audio>.<name>.*
+     * @param options ʱĶ
+     * @return ߵ֡УPop ȡ֡Recycle 黹ֻ֡ãݣֻܶ
+     * ܣߴʱԼĶﶪ֡Ӳѹţļ֮䱣
+     */
+    std::shared_ptr<FrameSubscription> subscribeFrames(AVMediaType type, const std::string& name,
+        const TapOptions& options = TapOptions());
+
+    /**
+     * @brief ȡĲر
+     */
+    void unsubscribeFrames(const std::shared_ptr<FrameSubscription>& subscription);
+
+    /**
+     * @brief ǰļǷȫ
+     * @return bool ̶߳ѳˢ֡Ϊʱ true
+     */
+    bool isFinished();
+
+    /**
+     * @brief ȡˮͳƿգ̵߳ã
+     */
+    PipelineStats GetPipelineStats();
+
+    /**
+     * @brief ȡʱ̵ָ꣨߳ã
+     * @return ָбг / ֽÿ֡ʱ֡
+     *         ƵǷ뾲䡢Ƶƫȣб metrics.h
+     */
+    std::vector<MetricValue> GetStats();
+
+    /**
+     * @brief ȡƵ֡ͳƣ֡ʱλ֡ظ֡ pts̵߳ã
+     * @return  SDL ˵ۼֵ framepacing.h
+     */
+    FramePacingStats GetFramePacing();
+
+    /**
+     * @brief ʾ / ƵϽǵָӲ
+     */
+    void setOverlay(bool on);
+    bool overlay() const { return overlay_; }
+
     /**
      * @brief ͣȴ resume()
      * ܣ⸴̺߳ͽ̵߳ãʵͣȴ
@@ -99,10 +222,17 @@ private:
     // ================ ڲ ================
     // ڲʹãװ˸ӵĳʼ߼
 
+    /**
+     * @brief ̨߳
+     * ܣפ̣߳δÿһ start() 
+     *       SDL ںȾֻڴǵ߳ʹãԱͬһ̸߳ļ
+     */
+    void PlayLoop();
+
     /**
      * @brief ʼģ
      * @return int ɹ0ʧܷظֵ
-     * ܣʼв
+     * ܣ⸴״εʱ֮ò
      */
     int InitAll();
 
@@ -114,16 +244,23 @@ private:
     int StartAllThreads();
 
     /**
-     * @brief ֹ̲ͣ߳Դ
-     * ܣȷ˳ֹͣͷԴ
+     * @brief ֹ̲ͣ߳ǰļԴ
+     * ܣȷ˳ֹͣͷŽ⸴նУڲ߳ϵã
      */
     void StopAndClean();
 
+    /**
+     * @brief ͷſɸõڡƵ豸
+     * ܣ߳˳ǰ
+     */
+    void ReleaseAll();
+
 private:
     // ================ Ա ================
 
     // 
-    const char* m_url;                // Ƶļ·ָ
+    std::string m_url;                // Ƶļ·
+    std::string m_format_name;        // ʽձʾԶ̽⣩
 
     // ================ ݶ ================
 
@@ -131,8 +268,10 @@ private:
     AVPacketQueue* video_packet_queue; // Ƶݰ
     AVFrameQueue* audio_frame_queue;   // Ƶ֡
     AVFrameQueue* video_frame_queue;   // Ƶ֡
+    FrameMemoryBudget frame_budget;    // Ƶ֡йڴԤ
 
     // ================ ͬʱ ================
+    VirtualClock virtual_clock;       // ʱԴ SinkType::NullVirtual ʹã
     AVSync avsync;                    // ƵͬʱӣƵʱΪʱ
 
     // ================ ߳ģ ================
@@ -140,16 +279,28 @@ private:
     DemuxThread* demux_thread = nullptr;          // ⸴̶߳
     DecodeThread* audio_decode_thread = nullptr;  // Ƶ̶߳
     DecodeThread* video_decode_thread = nullptr;  // Ƶ̶߳
+    FrameTap audio_tap_{ "audio" };               // ֡Ķĵ㣨Ƚ̻߳þã
+    FrameTap video_tap_{ "video" };
 
     // ================ ģ ================
-    AudioOutput* audio_output = nullptr;          // Ƶģ飨SDLƵ
-    VideoOutput* video_output = nullptr;          // Ƶģ飨SDLڣ
+    AudioSink* audio_output = nullptr;            // Ƶģ飨SDLƵ / 
+    VideoSink* video_output = nullptr;            // Ƶģ飨SDL / 
+    SinkType sink_type_ = SinkType::Sdl;          // 
+    bool vsync_ = false;                          // SDL Ƿֱͬ
+    SnapshotWriter snapshot_writer_;              // ͼ̣߳˻þã
 
     // ================ ״̬ ================
-    bool started = false;    // ־true=false=δ
+    std::atomic<bool> started{ false };  // ־true=false=δ
     bool paused = false;     // ͣ״̬־true=ͣfalse=У
 
-    std::thread play_thread; // ̨߳
+    std::thread play_thread; // ̨̣߳פļ
+
+    // ================ ŻỰ ================
+    std::mutex session_mtx;                 // Ựģָ
+    std::condition_variable session_cv;     // ֪ͨ߳̿ʼ / ֪ͨ stop() ѽ
+    bool session_requested = false;         // start() 󲥷ļ
+    bool exit_requested = false;            // ʱ󲥷߳˳
+    std::atomic<bool> stop_requested{ false }; // stop() ǰļ
 
     // ================ ͣƻ ================
     // ʹʵͣ/ָ
@@ -159,6 +310,8 @@ private:
 
     // ================ ٶȿ ================
     float speed_ = 1.0f;                    // ǰٶȣ1.0=ٶȣ
+
+    std::atomic<bool> overlay_{ false };    // ǷʾָӲ
 };
 
 #endif // MAINCONTROLLER_H
@@ -0,0 +1,245 @@
+﻿#include "mediaprobe.h"
+#include "threadpool.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/error.h>
+}
+
+// 缓存文件第一行，格式变化时修改版本号使旧缓存失效
+#define PROBE_CACHE_HEADER "#mediaprobe v1"
+
+// ---------------------------------------------------------
+// 构造与析构
+// ---------------------------------------------------------
+MediaProbe::MediaProbe(const std::string& cache_path)
+    : cache_path_(cache_path)
+{
+    LoadCache();
+};
+
+MediaProbe::~MediaProbe()
+{
+    delete pool_;
+    pool_ = nullptr;
+};
+
+// ---------------------------------------------------------
+// 探测一组文件：缓存命中直接返回，未命中的并行探测
+// ---------------------------------------------------------
+std::vector<MediaInfo> MediaProbe::Probe(const std::vector<MediaFile>& files)
+{
+    std::vector<MediaInfo> results(files.size());
+    std::vector<int> misses;  // 需要真正打开的文件序号
+
+    // 1. 查缓存：路径、大小、修改时间都一致才算命中
+    for (size_t i = 0; i < files.size(); i++) {
+        auto it = cache_.find(files[i].path);
+        if (it != cache_.end()
+            && it->second.file.size == files[i].size
+            && it->second.file.mtime == files[i].mtime) {
+            results[i] = it->second;
+            results[i].file = files[i];
+        }
+        else {
+            misses.push_back((int)i);
+        }
+    }
+
+    // 2. 并行探测未命中的文件
+    //    每个任务只写 results 中属于自己的位置，所以结果顺序与输入顺序一致
+    if (!misses.empty()) {
+        if (!pool_)
+            pool_ = new ThreadPool();
+
+        pool_->ParallelFor((int)misses.size(), [&](int k) {
+            int i = misses[k];
+            results[i] = ProbeFile(files[i]);
+            });
+    }
+
+    // 3. 有新结果或有文件被删除时写回缓存
+    if (!misses.empty() || cache_.size() != files.size()) {
+        cache_.clear();
+        for (const auto& info : results)
+            cache_[info.file.path] = info;
+        SaveCache(results);
+    }
+
+    return results;
+};
+
+// ---------------------------------------------------------
+// 打开并分析单个文件
+// ---------------------------------------------------------
+MediaInfo MediaProbe::ProbeFile(const MediaFile& file)
+{
+    MediaInfo info;
+    info.file = file;
+
+    char err2str[128];
+    AVFormatContext* fmt_ctx = nullptr;
+
+    // 1. 打开文件
+    int ret = avformat_open_input(&fmt_ctx, file.path.c_str(), NULL, NULL);
+    if (ret < 0) {
+        av_strerror(ret, err2str, sizeof(err2str));
+        info.error = std::string("打开失败: ") + err2str;
+        return info;
+    }
+
+    // 2. 读取流信息
+    ret = avformat_find_stream_info(fmt_ctx, NULL);
+    if (ret < 0) {
+        av_strerror(ret, err2str, sizeof(err2str));
+        info.error = std::string("读取流信息失败: ") + err2str;
+        avformat_close_input(&fmt_ctx);
+        return info;
+    }
+
+    info.format_name = fmt_ctx->iformat->name;
+    if (fmt_ctx->duration != AV_NOPTS_VALUE)
+        info.duration = fmt_ctx->duration / (double)AV_TIME_BASE;
+
+    // 3. 与 DemuxThread::Init 相同的选流规则
+    int video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    int audio_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+
+    bool decodable = true;
+
+    if (video_stream >= 0) {
+        AVCodecParameters* par = fmt_ctx->streams[video_stream]->codecpar;
+        info.width = par->width;
+        info.height = par->height;
+        info.video_codec = avcodec_get_name(par->codec_id);
+        if (!avcodec_find_decoder(par->codec_id)) {
+            info.error = "不支持的视频编码: " + info.video_codec;
+            decodable = false;
+        }
+    }
+
+    if (audio_stream >= 0) {
+        AVCodecParameters* par = fmt_ctx->streams[audio_stream]->codecpar;
+        info.audio_codec = avcodec_get_name(par->codec_id);
+        if (decodable && !avcodec_find_decoder(par->codec_id)) {
+            info.error = "不支持的音频编码: " + info.audio_codec;
+            decodable = false;
+        }
+    }
+
+    if (video_stream < 0)
+        info.error = "没有视频流";
+    else if (audio_stream < 0)
+        info.error = "没有音频流";
+
+    info.playable = decodable && video_stream >= 0 && audio_stream >= 0;
+
+    avformat_close_input(&fmt_ctx);
+
+    return info;
+};
+
+// ---------------------------------------------------------
+// 格式化描述
+// ---------------------------------------------------------
+std::string MediaProbe::Describe(const MediaInfo& info)
+{
+    if (!info.playable)
+        return "无法播放: " + info.error;
+
+    char buf[256];
+    int total = (int)(info.duration + 0.5);
+    snprintf(buf, sizeof(buf), "%02d:%02d:%02d %dx%d %s/%s",
+        total / 3600, total / 60 % 60, total % 60,
+        info.width, info.height,
+        info.video_codec.c_str(), info.audio_codec.c_str());
+
+    return buf;
+};
+
+// ---------------------------------------------------------
+// 磁盘缓存：每行一个文件，字段用 Tab 分隔
+//   path size mtime playable duration width height vcodec acodec format error
+// ---------------------------------------------------------
+
+// 字段中不能出现分隔符
+static std::string CacheField(const std::string& s)
+{
+    std::string out = s;
+    for (auto& ch : out) {
+        if (ch == '\t' || ch == '\n' || ch == '\r')
+            ch = ' ';
+    }
+    return out;
+};
+
+void MediaProbe::LoadCache()
+{
+    std::ifstream in(cache_path_, std::ios::binary);
+    if (!in)
+        return;
+
+    std::string line;
+    if (!std::getline(in, line) || line != PROBE_CACHE_HEADER)
+        return;  // 版本不匹配，丢弃旧缓存
+
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() == 10)
+            fields.push_back("");  // error 为空时行尾没有内容
+        if (fields.size() != 11)
+            continue;
+
+        MediaInfo info;
+        info.file.path = fields[0];
+        info.file.size = strtoll(fields[1].c_str(), nullptr, 10);
+        info.file.mtime = strtoll(fields[2].c_str(), nullptr, 10);
+        info.playable = fields[3] == "1";
+        info.duration = strtod(fields[4].c_str(), nullptr);
+        info.width = atoi(fields[5].c_str());
+        info.height = atoi(fields[6].c_str());
+        info.video_codec = fields[7];
+        info.audio_codec = fields[8];
+        info.format_name = fields[9];
+        info.error = fields[10];
+
+        cache_[info.file.path] = info;
+    }
+};
+
+void MediaProbe::SaveCache(const std::vector<MediaInfo>& infos)
+{
+    // 先写临时文件再替换，避免中途退出留下半个缓存
+    std::string tmp_path = cache_path_ + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return;
+
+        out << PROBE_CACHE_HEADER << "\n";
+        for (const auto& info : infos) {
+            char nums[160];
+            snprintf(nums, sizeof(nums), "%lld\t%lld\t%d\t%.3f\t%d\t%d",
+                (long long)info.file.size, (long long)info.file.mtime,
+                info.playable ? 1 : 0, info.duration, info.width, info.height);
+
+            out << CacheField(info.file.path) << "\t" << nums << "\t"
+                << CacheField(info.video_codec) << "\t"
+                << CacheField(info.audio_codec) << "\t"
+                << CacheField(info.format_name) << "\t"
+                << CacheField(info.error) << "\n";
+        }
+    }
+
+    std::remove(cache_path_.c_str());
+    std::rename(tmp_path.c_str(), cache_path_.c_str());
+};
@@ -0,0 +1,82 @@
+﻿#ifndef MEDIAPROBE_H
+#define MEDIAPROBE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class ThreadPool;
+
+/**
+ * @brief 目录扫描得到的一个媒体文件（缓存键：路径 + 大小 + 修改时间）
+ */
+struct MediaFile {
+    std::string name;           // 文件名（不含目录）
+    std::string path;           // 完整路径
+    int64_t size = 0;           // 文件大小（字节）
+    int64_t mtime = 0;          // 最后修改时间（平台相关的整数表示）
+};
+
+/**
+ * @brief 探测结果：时长、分辨率、编码格式以及是否可以播放
+ */
+struct MediaInfo {
+    MediaFile file;             // 对应的文件
+
+    bool playable = false;      // 是否满足播放条件（有音频流和视频流且解码器可用）
+    std::string error;          // 不能播放时的原因
+
+    double duration = 0.0;      // 时长（秒），未知为 0
+    int width = 0;              // 视频宽度
+    int height = 0;             // 视频高度
+    std::string video_codec;    // 视频编码名（如 h264）
+    std::string audio_codec;    // 音频编码名（如 aac）
+    std::string format_name;    // 容器格式短名（如 mov,mp4,m4a,3gp,3g2,mj2），播放时跳过格式探测
+};
+
+/**
+ * @brief 媒体文件探测器（文件选择界面使用）
+ *
+ * - 在线程池上并行探测所有未命中缓存的文件
+ * - 结果按输入顺序返回，与探测完成的先后无关
+ * - 结果写入目录下的磁盘缓存（键为路径 + 大小 + 修改时间），
+ *   缓存命中时不打开文件
+ */
+class MediaProbe
+{
+public:
+    /**
+     * @param cache_path 磁盘缓存文件路径
+     */
+    explicit MediaProbe(const std::string& cache_path);
+    ~MediaProbe();
+
+    /**
+     * @brief 探测一组文件
+     * @param files 待探测文件（返回结果与之一一对应）
+     * @return 探测结果
+     */
+    std::vector<MediaInfo> Probe(const std::vector<MediaFile>& files);
+
+    /**
+     * @brief 打开并分析单个文件（不使用缓存）
+     */
+    static MediaInfo ProbeFile(const MediaFile& file);
+
+    /**
+     * @brief 把探测结果格式化为一行描述，例如 "01:23:45 1920x1080 h264/aac"
+     */
+    static std::string Describe(const MediaInfo& info);
+
+private:
+    void LoadCache();                                   // 读取磁盘缓存
+    void SaveCache(const std::vector<MediaInfo>& infos);// 写回磁盘缓存（只保留当前存在的文件）
+
+private:
+    std::string cache_path_;                            // 缓存文件路径
+    std::unordered_map<std::string, MediaInfo> cache_;  // 路径 -> 探测结果
+    ThreadPool* pool_ = nullptr;                        // 探测线程池（首次需要时创建）
+};
+
+#endif // MEDIAPROBE_H
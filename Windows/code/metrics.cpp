@@ -0,0 +1,64 @@
+﻿#include "metrics.h"
+#include <algorithm>
+
+MetricsRegistry& MetricsRegistry::Instance()
+{
+    // 有意不释放：进程退出时其他线程可能仍在更新指标
+    static MetricsRegistry* instance = new MetricsRegistry;
+    return *instance;
+};
+
+MetricCounter* MetricsRegistry::GetCounter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<MetricCounter>& metric = counters_[name];
+    if (!metric)
+        metric.reset(new MetricCounter);
+
+    return metric.get();
+};
+
+MetricGauge* MetricsRegistry::GetGauge(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<MetricGauge>& metric = gauges_[name];
+    if (!metric)
+        metric.reset(new MetricGauge);
+
+    return metric.get();
+};
+
+LatencyHistogram* MetricsRegistry::GetHistogram(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<LatencyHistogram>& metric = histograms_[name];
+    if (!metric)
+        metric.reset(new LatencyHistogram);
+
+    return metric.get();
+};
+
+std::vector<MetricValue> MetricsRegistry::Snapshot()
+{
+    std::vector<MetricValue> values;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& it : counters_)
+        values.push_back({ it.first, it.second->Get(), true });
+    for (auto& it : gauges_)
+        values.push_back({ it.first, it.second->Get(), false });
+    for (auto& it : histograms_) {
+        const LatencyHistogram& h = *it.second;
+        values.push_back({ it.first + ".count", h.Count(), true });
+        values.push_back({ it.first + ".mean", (int64_t)h.Mean(), false });
+        values.push_back({ it.first + ".p50", h.Percentile(0.5), false });
+        values.push_back({ it.first + ".p99", h.Percentile(0.99), false });
+        values.push_back({ it.first + ".max", h.Max(), false });
+    }
+
+    std::sort(values.begin(), values.end(), [](const MetricValue& a, const MetricValue& b) {
+        return a.name < b.name;
+        });
+
+    return values;
+};
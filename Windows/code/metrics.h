@@ -0,0 +1,109 @@
+﻿#ifndef METRICS_H
+#define METRICS_H
+
+#include "framelatency.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 计数器：只增不减（如丢帧数、欠载次数）
+ */
+class MetricCounter
+{
+public:
+    void Add(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); };
+    int64_t Get() const { return value_.load(std::memory_order_relaxed); };
+
+private:
+    std::atomic<int64_t> value_{ 0 };
+};
+
+/**
+ * @brief 仪表：可增可减的当前值（如队列长度、音视频偏差）
+ */
+class MetricGauge
+{
+public:
+    void Set(int64_t v) { value_.store(v, std::memory_order_relaxed); };
+    void Add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); };
+    int64_t Get() const { return value_.load(std::memory_order_relaxed); };
+
+private:
+    std::atomic<int64_t> value_{ 0 };
+};
+
+/**
+ * @brief 快照中的一项
+ */
+struct MetricValue {
+    std::string name;   // 指标名，如 "queue.video_frame.depth"
+    int64_t value;      // 当前值
+    bool counter;       // true：计数器（只增不减），false：仪表 / 直方图统计值
+};
+
+/**
+ * @brief 指标注册表（进程内唯一）
+ *
+ * - 热路径只持有 GetCounter / GetGauge / GetHistogram 返回的指针，更新都是无锁原子操作
+ * - 注册（按名字查找 / 创建）加锁，应在初始化时完成；返回的指针在进程生命周期内有效
+ * - 同名指标只创建一次，先取指针再由其他模块更新也可以
+ *
+ * 指标：
+ *   queue.<名字>.depth / .bytes / .dropped   队列长度、占用字节、未被消费就被清空的元素数
+ *   queue.<名字>.duration_us                  帧队列中帧的总时长
+ *   alloc.packets / alloc.frames              空闲链表为空、入队时新分配的 AVPacket / AVFrame 个数
+ *   arena.packets.hits / .misses / .oversize  包负载缓冲池复用 / 新分配 / 过大未入池的次数（见 packetarena.h）
+ *   arena.packets.cached_bytes / .live_bytes  缓冲池中空闲 / 正被引用的字节数
+ *   decode.<audio|video>.frame_time_us        每帧解码耗时（直方图）
+ *   video.upload_us                           每帧纹理上传耗时（直方图）
+ *   video.present_interval_us                 相邻两次显示的实际间隔（直方图，衡量节奏是否均匀）
+ *   video.vsync_period_us                     垂直同步时由显示时刻估计的刷新周期（--vsync）
+ *   video.pacing.late / .repeated / .skipped_pts  晚于 pts 目标超过一个帧间隔的帧数、画面多停留的帧间隔数、
+ *                                             pts 跳过的帧数（帧时间分位数等完整统计见 framepacing.h）
+ *   video.convert_us                          显示端不支持的像素格式在解码线程上的转换耗时（直方图，含高位深转 8 位）
+ *   video.downscale_us                        视频远大于显示区域时解码线程上的盒式下采样耗时（直方图）
+ *   video.downscale_factor                    当前帧相对原始分辨率的缩小倍数（lowres 与下采样的乘积，1 表示未缩小）
+ *   video.frames_late                         显示时已晚于 pts 超过 40ms 的帧数
+ *                                             （除格式无法显示外输出端从不丢帧，未显示就被丢弃的帧见 queue.video_frame.dropped）
+ *   video.frames_unsupported                  像素格式无法显示（如转换失败）而在输出端丢弃的帧数
+ *   tap.<video|audio>.<名字>.delivered / .dropped / .depth / .bytes  帧订阅者收到 / 在其队列中丢弃 / 正在排队的帧数、排队帧的字节数
+ *   tap.<video|audio>.<名字>.publish_ns       解码线程为该订阅者每帧花费的时间（直方图，纳秒，见 frametap.h）
+ *   snapshot.captured / .dropped / .failed    截图成功数、截图线程积压时丢弃的连拍帧数、失败数（见 snapshot.h）
+ *   snapshot.encode_us                        每张截图在截图线程上的转换 + 编码 + 写文件耗时（直方图）
+ *   shm.frames / shm.oversize                 写入共享内存帧环的帧数、超过槽大小而跳过的帧数（见 shmring.h）
+ *   shm.write_us                              每帧复制进共享内存槽的耗时（直方图）
+ *   audio.underruns                           播放中音频帧队列为空的次数
+ *   audio.silence_insertions / .silence_bytes 填充静音的次数与字节数
+ *   avsync.drift_us / avsync.abs_drift_us     最近一帧显示时的 视频pts - 主时钟（仪表 / 直方图）
+ */
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry& Instance();
+
+    MetricCounter* GetCounter(const std::string& name);
+    MetricGauge* GetGauge(const std::string& name);
+    LatencyHistogram* GetHistogram(const std::string& name);
+
+    /**
+     * @brief 读取所有指标（按名字排序）
+     *
+     * 直方图展开为 <名字>.count / .mean / .p50 / .p99 / .max
+     */
+    std::vector<MetricValue> Snapshot();
+
+private:
+    MetricsRegistry() {};
+
+    std::mutex mutex_;  // 只保护以下三个表的结构
+    std::map<std::string, std::unique_ptr<MetricCounter>> counters_;
+    std::map<std::string, std::unique_ptr<MetricGauge>> gauges_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+};
+
+#endif // METRICS_H
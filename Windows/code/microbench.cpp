@@ -0,0 +1,873 @@
+﻿#include "microbench.h"
+#include "queue.h"
+#include "avpacketqueue.h"
+#include "avframequeue.h"
+#include "packetarena.h"
+#include "avsync.h"
+#include "audiooutput.h"
+#include "videooutput.h"
+#include "textureupload.h"
+#include "depthconvert.h"
+#include "downscale.h"
+#include "shmring.h"
+#include "metrics.h"
+#include "tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+// 每项基准的最短运行时间（纳秒），循环次数不固定的项按时间运行
+#define MICRO_MIN_RUN_NS 200000000LL
+
+namespace {
+
+/**
+ * 一项基准的结果
+ */
+struct MicroResult {
+    std::string name;               // 基准名
+    std::string params;             // 参数（线程数、分辨率、倍速等）
+    int64_t iterations = 0;         // 操作次数
+    int64_t elapsed_ns = 0;         // 总耗时
+    int64_t p50_ns = -1;            // 单次延迟分位数，-1 表示未测
+    int64_t p99_ns = -1;
+    int64_t max_ns = -1;
+    const char* extra_name = nullptr; // 附加指标名（可为空）
+    double extra = 0.0;             // 附加指标值
+};
+
+/**
+ * 按采样计算延迟分位数（会对 samples 排序）
+ */
+void SetLatency(MicroResult& result, std::vector<int64_t>& samples)
+{
+    if (samples.empty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+    result.p50_ns = samples[samples.size() / 2];
+    result.p99_ns = samples[samples.size() * 99 / 100];
+    result.max_ns = samples.back();
+};
+
+/**
+ * 读取计数器当前值（用于计算每次操作的分配次数）
+ */
+int64_t CounterValue(const char* name)
+{
+    return MetricsRegistry::Instance().GetCounter(name)->Get();
+};
+
+// ============================================================================
+//                                  Queue<T>
+// ============================================================================
+
+/**
+ * 单线程 push + pop：无争用时一对操作的开销（加锁 / 通知 / 环形缓冲区）
+ */
+void BenchQueueSingleThread(std::vector<MicroResult>& results)
+{
+    const int64_t count = 2000000;
+    Queue<int64_t> queue;
+    int64_t value = 0;
+
+    int64_t start = TraceNowNs();
+    for (int64_t i = 0; i < count; i++) {
+        queue.Push(i);
+        queue.Pop(value, 0);
+    }
+
+    MicroResult result;
+    result.name = "queue.push_pop";
+    result.params = "threads=1";
+    result.iterations = count;
+    result.elapsed_ns = TraceNowNs() - start;
+    results.push_back(result);
+};
+
+/**
+ * 多生产者 / 多消费者：元素是入队时刻，出队时记录排队延迟
+ * 队列无界，生产者比消费者快时延迟包含积压，反映的是满负荷下的延迟
+ */
+void BenchQueueThreads(std::vector<MicroResult>& results, int producers, int consumers)
+{
+    const int64_t count = 1000000;
+    Queue<int64_t> queue;
+    std::atomic<int64_t> consumed{ 0 };
+    std::vector<std::vector<int64_t>> latencies(consumers);
+    std::vector<std::thread> threads;
+
+    int64_t start = TraceNowNs();
+    for (int i = 0; i < consumers; i++) {
+        latencies[i].reserve(count / consumers * 2);
+        threads.emplace_back([&, i] {
+            int64_t stamp = 0;
+            while (consumed.load(std::memory_order_relaxed) < count) {
+                if (queue.Pop(stamp, 10) == 0) {
+                    latencies[i].push_back(TraceNowNs() - stamp);
+                    consumed.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < producers; i++) {
+        threads.emplace_back([&, i] {
+            int64_t n = count / producers + (i < count % producers ? 1 : 0);
+            for (int64_t j = 0; j < n; j++)
+                queue.Push(TraceNowNs());
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    MicroResult result;
+    result.name = "queue.mpmc";
+    result.params = "producers=" + std::to_string(producers) + ",consumers=" + std::to_string(consumers);
+    result.iterations = count;
+    result.elapsed_ns = TraceNowNs() - start;
+
+    std::vector<int64_t> all;
+    all.reserve(count);
+    for (std::vector<int64_t>& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    SetLatency(result, all);
+
+    results.push_back(result);
+};
+
+// ============================================================================
+//                         AVPacketQueue / AVFrameQueue
+// ============================================================================
+
+/**
+ * 与解复用 / 解码线程相同的用法：同一个 AVPacket 反复装入新数据后 Push（移走引用），再 Pop 并归还
+ */
+void BenchPacketQueue(std::vector<MicroResult>& results)
+{
+    const int64_t count = 500000;
+    AVPacketQueue queue("microbench_packet");
+    AVPacket* source = av_packet_alloc();
+    AVPacket* packet = av_packet_alloc();
+    if (av_new_packet(source, 4096) < 0) {
+        av_packet_free(&source);
+        av_packet_free(&packet);
+        return;
+    }
+
+    int64_t allocs = CounterValue("alloc.packets");
+    int64_t start = TraceNowNs();
+    for (int64_t i = 0; i < count; i++) {
+        av_packet_ref(packet, source);
+        queue.Push(packet);
+        AVPacket* out = queue.Pop(0);
+        queue.Recycle(out);
+    }
+
+    MicroResult result;
+    result.name = "packet_queue.push_pop";
+    result.params = "payload=4096";
+    result.iterations = count;
+    result.elapsed_ns = TraceNowNs() - start;
+    result.extra_name = "allocs_per_op";
+    result.extra = (CounterValue("alloc.packets") - allocs) / (double)count;
+    results.push_back(result);
+
+    av_packet_free(&source);
+    av_packet_free(&packet);
+};
+
+/**
+ * 与解码线程 / 输出端相同的用法：同一个 AVFrame 反复引用 1080p 缓冲区后 Push，再 Pop 并归还
+ */
+void BenchFrameQueue(std::vector<MicroResult>& results)
+{
+    const int64_t count = 500000;
+    AVFrameQueue queue("microbench_frame");
+    AVFrame* source = av_frame_alloc();
+    source->format = AV_PIX_FMT_YUV420P;
+    source->width = 1920;
+    source->height = 1080;
+    if (av_frame_get_buffer(source, 0) < 0) {
+        av_frame_free(&source);
+        return;
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    int64_t allocs = CounterValue("alloc.frames");
+    int64_t start = TraceNowNs();
+    for (int64_t i = 0; i < count; i++) {
+        av_frame_ref(frame, source);
+        queue.Push(frame);
+        AVFrame* out = queue.Pop(0);
+        queue.Recycle(out);
+    }
+
+    MicroResult result;
+    result.name = "frame_queue.push_pop";
+    result.params = "1920x1080 yuv420p";
+    result.iterations = count;
+    result.elapsed_ns = TraceNowNs() - start;
+    result.extra_name = "allocs_per_op";
+    result.extra = (CounterValue("alloc.frames") - allocs) / (double)count;
+    results.push_back(result);
+
+    av_frame_free(&frame);
+    av_frame_free(&source);
+};
+
+/**
+ * 与解复用线程相同的用法：读入大小不一的负载后搬进缓冲池，同时有 100 个包在队列里，
+ * 最早的包解码后归还（包含 av_read_frame 本身的分配与拷贝开销）
+ */
+void BenchPacketArena(std::vector<MicroResult>& results)
+{
+    const int64_t count = 200000;
+    const int window = 100;
+    std::vector<AVPacket*> in_flight(window, nullptr);
+    for (AVPacket*& packet : in_flight)
+        packet = av_packet_alloc();
+
+    PacketArena& arena = PacketArena::Instance();
+    int64_t hits = CounterValue("arena.packets.hits");
+    int64_t misses = CounterValue("arena.packets.misses");
+    int64_t start = TraceNowNs();
+    for (int64_t i = 0; i < count; i++) {
+        AVPacket* packet = in_flight[i % window];
+        av_packet_unref(packet);
+        // 4KB ~ 256KB 之间变化的负载，近似高码率视频的 P / B 帧与关键帧
+        int size = 4096 + (int)((i * 2654435761u) % (252 * 1024));
+        if (av_new_packet(packet, size) < 0)
+            break;
+        arena.Adopt(packet);
+    }
+
+    MicroResult result;
+    result.name = "packet_arena.adopt";
+    result.params = "payload=4K-256K window=100";
+    result.iterations = count;
+    result.elapsed_ns = TraceNowNs() - start;
+    result.extra_name = "hit_rate";
+    int64_t total = (CounterValue("arena.packets.hits") - hits) + (CounterValue("arena.packets.misses") - misses);
+    result.extra = total > 0 ? (CounterValue("arena.packets.hits") - hits) / (double)total : 0.0;
+    results.push_back(result);
+
+    for (AVPacket*& packet : in_flight)
+        av_packet_free(&packet);
+};
+
+// ============================================================================
+//                                   AVSync
+// ============================================================================
+
+/**
+ * 一个线程持续 SetClock（音频回调），readers 个线程持续 GetClock（视频刷新 / 统计）
+ */
+void BenchAVSync(std::vector<MicroResult>& results, int readers)
+{
+    AVSync avsync;
+    std::atomic<bool> stop{ false };
+    std::atomic<int64_t> reads{ 0 };
+    int64_t writes = 0;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < readers; i++) {
+        threads.emplace_back([&] {
+            int64_t n = 0;
+            volatile double sink = 0.0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                sink = avsync.GetClock();
+                n++;
+            }
+            (void)sink;
+            reads.fetch_add(n);
+        });
+    }
+
+    int64_t start = TraceNowNs();
+    while (TraceNowNs() - start < MICRO_MIN_RUN_NS) {
+        avsync.SetClock(writes * 0.001);
+        writes++;
+    }
+    int64_t elapsed = TraceNowNs() - start;
+    stop = true;
+    for (std::thread& t : threads)
+        t.join();
+
+    std::string params = "readers=" + std::to_string(readers);
+
+    MicroResult set;
+    set.name = "avsync.set_clock";
+    set.params = params;
+    set.iterations = writes;
+    set.elapsed_ns = elapsed;
+    results.push_back(set);
+
+    if (readers > 0) {
+        // 每个读线程的平均单次开销
+        MicroResult get;
+        get.name = "avsync.get_clock";
+        get.params = params;
+        get.iterations = reads / readers;
+        get.elapsed_ns = elapsed;
+        results.push_back(get);
+    }
+};
+
+// ============================================================================
+//                                音频回调路径
+// ============================================================================
+
+/**
+ * 直接驱动 AudioOutput 的回调：48kHz 立体声 FLTP 帧经 atempo 滤镜图、
+ * swr_convert 转为 S16，再 memcpy 到输出缓冲区。每次回调 2048 字节（与 SDL 设备的 512 样本一致）
+ */
+void BenchAudioCallback(std::vector<MicroResult>& results, float speed)
+{
+    const int callbacks = 20000;
+    const int callback_bytes = 512 * 2 * 2;
+    const int frame_samples = 1024;
+
+    AudioParams params;
+    params.freq = 48000;
+    params.fmt = AV_SAMPLE_FMT_FLTP;
+    av_channel_layout_default(&params.ch_layout, 2);
+
+    AVSync avsync;
+    AVFrameQueue queue("microbench_audio");
+    AudioOutput output(&avsync, params, &queue, AVRational{ 1, params.freq });
+    if (output.InitOffline(speed) < 0) {
+        fprintf(stderr, "microbench: audio filter graph init failed\n");
+        return;
+    }
+
+    // 一帧 1024 样本的正弦波，所有输入帧共享同一缓冲区
+    AVFrame* source = av_frame_alloc();
+    source->format = params.fmt;
+    source->sample_rate = params.freq;
+    source->nb_samples = frame_samples;
+    av_channel_layout_copy(&source->ch_layout, &params.ch_layout);
+    if (av_frame_get_buffer(source, 0) < 0) {
+        av_frame_free(&source);
+        return;
+    }
+    for (int c = 0; c < 2; c++) {
+        float* samples = (float*)source->data[c];
+        for (int i = 0; i < frame_samples; i++)
+            samples[i] = 0.5f * (float)sin(2 * M_PI * 440.0 * i / params.freq);
+    }
+
+    // 预先放入足够的输入帧，计时只包含回调本身
+    int64_t frames = (int64_t)(callbacks * 512.0 * speed / frame_samples) + 16;
+    for (int64_t i = 0; i < frames; i++) {
+        AVFrame* frame = av_frame_alloc();
+        av_frame_ref(frame, source);
+        frame->pts = i * frame_samples;
+        queue.Push(frame);
+        av_frame_free(&frame);
+    }
+
+    std::vector<uint8_t> stream(callback_bytes);
+    std::vector<int64_t> latencies;
+    latencies.reserve(callbacks);
+
+    int64_t start = TraceNowNs();
+    for (int i = 0; i < callbacks; i++) {
+        int64_t t0 = TraceNowNs();
+        output.FillBuffer(stream.data(), callback_bytes);
+        latencies.push_back(TraceNowNs() - t0);
+    }
+
+    char text[32];
+    snprintf(text, sizeof(text), "speed=%.2f", speed);
+
+    MicroResult result;
+    result.name = "audio.callback";
+    result.params = text;
+    result.iterations = callbacks;
+    result.elapsed_ns = TraceNowNs() - start;
+    // 输出的音频时长与耗时之比：回调能跑多少倍实时
+    result.extra_name = "realtime_factor";
+    result.extra = (callbacks * 512.0 / params.freq) / (result.elapsed_ns / 1e9);
+    SetLatency(result, latencies);
+    results.push_back(result);
+
+    av_frame_free(&source);
+    av_channel_layout_uninit(&params.ch_layout);
+};
+
+// ============================================================================
+//                              Letterbox / YUV 拷贝
+// ============================================================================
+
+static const struct { int w, h; } kResolutions[] = {
+    { 640, 360 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 },
+};
+
+void BenchLetterBox(std::vector<MicroResult>& results)
+{
+    const int64_t count = 10000000;
+    volatile int sink = 0;
+
+    int64_t start = TraceNowNs();
+    for (int64_t i = 0; i < count; i++) {
+        const auto& r = kResolutions[i & 3];
+        SDL_Rect rect = CalcLetterBoxRect(r.w, r.h);
+        sink = rect.w;
+    }
+    (void)sink;
+
+    MicroResult result;
+    result.name = "video.letterbox_rect";
+    result.params = "mixed";
+    result.iterations = count;
+    result.elapsed_ns = TraceNowNs() - start;
+    results.push_back(result);
+};
+
+/**
+ * 每种分辨率：
+ *   - video.yuv_copy     ：av_image_copy 拷贝三个平面（纹理上传中 CPU 拷贝部分的下限）
+ *   - video.texture_upload：上传到软件渲染器的 IYUV 流式纹理（不需要窗口），
+ *                           分别测 SDL_UpdateYUVTexture、锁定纹理直接拷贝、锁定纹理并行拷贝（4K）
+ */
+void BenchYuvCopy(std::vector<MicroResult>& results)
+{
+    ThreadPool pool(3);
+
+    for (const auto& r : kResolutions) {
+        AVFrame* frame = av_frame_alloc();
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = r.w;
+        frame->height = r.h;
+        if (av_frame_get_buffer(frame, 0) < 0) {
+            av_frame_free(&frame);
+            continue;
+        }
+        av_frame_make_writable(frame);
+        for (int p = 0; p < 3; p++)
+            memset(frame->data[p], 0x80, frame->linesize[p] * (p ? r.h / 2 : r.h));
+
+        uint8_t* dst_data[4] = {};
+        int dst_linesize[4] = {};
+        if (av_image_alloc(dst_data, dst_linesize, r.w, r.h, AV_PIX_FMT_YUV420P, 32) < 0) {
+            av_frame_free(&frame);
+            continue;
+        }
+
+        char params[32];
+        snprintf(params, sizeof(params), "%dx%d", r.w, r.h);
+        double frame_bytes = r.w * r.h * 1.5;
+
+        // 1. 纯 CPU 平面拷贝
+        int64_t count = 0;
+        int64_t start = TraceNowNs();
+        while (TraceNowNs() - start < MICRO_MIN_RUN_NS || count < 10) {
+            av_image_copy(dst_data, dst_linesize, (const uint8_t**)frame->data, frame->linesize,
+                AV_PIX_FMT_YUV420P, r.w, r.h);
+            count++;
+        }
+
+        MicroResult copy;
+        copy.name = "video.yuv_copy";
+        copy.params = params;
+        copy.iterations = count;
+        copy.elapsed_ns = TraceNowNs() - start;
+        copy.extra_name = "gb_per_sec";
+        copy.extra = frame_bytes * count / copy.elapsed_ns;
+        results.push_back(copy);
+
+        // 2. 软件渲染器纹理上传
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, r.w, r.h, 32, SDL_PIXELFORMAT_ARGB8888);
+        SDL_Renderer* renderer = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+        SDL_Texture* texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_IYUV,
+            SDL_TEXTUREACCESS_STREAMING, r.w, r.h) : nullptr;
+        if (texture) {
+            // 0 = SDL_UpdateYUVTexture，1 = 锁定拷贝，2 = 锁定并行拷贝（只有 4K 及以上才会并行）
+            for (int mode = 0; mode < 3; mode++) {
+                if (mode == 2 && (int64_t)r.w * r.h < UPLOAD_PARALLEL_PIXELS)
+                    continue;
+
+                count = 0;
+                start = TraceNowNs();
+                while (TraceNowNs() - start < MICRO_MIN_RUN_NS || count < 10) {
+                    if (mode == 0) {
+                        SDL_UpdateYUVTexture(texture, NULL,
+                            frame->data[0], frame->linesize[0],
+                            frame->data[1], frame->linesize[1],
+                            frame->data[2], frame->linesize[2]);
+                    }
+                    else {
+                        UploadFrameTexture(texture, frame, mode == 2 ? &pool : nullptr);
+                    }
+                    count++;
+                }
+
+                static const char* kModes[] = { " software", " software lock", " software lock mt" };
+                MicroResult upload;
+                upload.name = "video.texture_upload";
+                upload.params = std::string(params) + kModes[mode];
+                upload.iterations = count;
+                upload.elapsed_ns = TraceNowNs() - start;
+                upload.extra_name = "gb_per_sec";
+                upload.extra = frame_bytes * count / upload.elapsed_ns;
+                results.push_back(upload);
+            }
+        }
+        else {
+            fprintf(stderr, "microbench: software renderer unavailable: %s\n", SDL_GetError());
+        }
+
+        if (texture)
+            SDL_DestroyTexture(texture);
+        if (renderer)
+            SDL_DestroyRenderer(renderer);
+        if (surface)
+            SDL_FreeSurface(surface);
+
+        av_freep(&dst_data[0]);
+        av_frame_free(&frame);
+    }
+};
+
+/**
+ * 1080p / 4K 的 yuv420p10le 转 yuv420p：
+ *   - video.depth_convert：sws_scale（与 FrameConverter 相同的 SWS_BILINEAR）、标量内核、
+ *                          当前 CPU 最快的 SIMD 内核（四舍五入 / 有序抖动）、4K 再加线程池并行
+ */
+void BenchDepthConvert(std::vector<MicroResult>& results)
+{
+    ThreadPool pool(2);
+    const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+    for (const auto& size : sizes) {
+        int w = size[0];
+        int h = size[1];
+        AVFrame* src = av_frame_alloc();
+        AVFrame* dst = av_frame_alloc();
+        src->format = AV_PIX_FMT_YUV420P10LE;
+        src->width = w;
+        src->height = h;
+        dst->format = AV_PIX_FMT_YUV420P;
+        dst->width = w;
+        dst->height = h;
+        if (av_frame_get_buffer(src, 0) < 0 || av_frame_get_buffer(dst, 0) < 0) {
+            av_frame_free(&src);
+            av_frame_free(&dst);
+            continue;
+        }
+
+        // 水平渐变：10 位样本低 2 位不全为 0，抖动和四舍五入的结果不同
+        for (int p = 0; p < 3; p++) {
+            int pw = p ? (w + 1) / 2 : w;
+            int ph = p ? (h + 1) / 2 : h;
+            for (int y = 0; y < ph; y++) {
+                uint16_t* row = (uint16_t*)(src->data[p] + (int64_t)y * src->linesize[p]);
+                for (int x = 0; x < pw; x++)
+                    row[x] = (uint16_t)(64 + (x * 876 / pw));
+            }
+        }
+
+        SwsContext* sws = sws_getContext(w, h, AV_PIX_FMT_YUV420P10LE, w, h, AV_PIX_FMT_YUV420P,
+            SWS_BILINEAR, NULL, NULL, NULL);
+        std::string simd = DepthKernelName(DepthKernel::Auto);
+
+        // 0 = sws_scale，1 = 标量，2 = SIMD，3 = SIMD + 抖动，4 = SIMD + 线程池（只测 4K）
+        for (int mode = 0; mode < 5; mode++) {
+            if (mode == 0 && !sws)
+                continue;
+            if (mode == 4 && (int64_t)w * h < DEPTH_PARALLEL_PIXELS)
+                continue;
+
+            int64_t count = 0;
+            int64_t start = TraceNowNs();
+            while (TraceNowNs() - start < MICRO_MIN_RUN_NS || count < 10) {
+                if (mode == 0) {
+                    sws_scale(sws, (const uint8_t* const*)src->data, src->linesize, 0, h,
+                        dst->data, dst->linesize);
+                }
+                else {
+                    DepthConvertFrame(src, dst, mode == 3, mode == 4 ? &pool : nullptr,
+                        mode == 1 ? DepthKernel::Scalar : DepthKernel::Auto);
+                }
+                count++;
+            }
+
+            const std::string kModes[] = { " sws", " scalar", " " + simd, " " + simd + " dither", " " + simd + " mt" };
+            char params[32];
+            snprintf(params, sizeof(params), "%dx%d", w, h);
+
+            MicroResult result;
+            result.name = "video.depth_convert";
+            result.params = params + kModes[mode];
+            result.iterations = count;
+            result.elapsed_ns = TraceNowNs() - start;
+            result.extra_name = "gb_per_sec";
+            result.extra = w * h * 1.5 * count / result.elapsed_ns;
+            results.push_back(result);
+        }
+
+        sws_freeContext(sws);
+        av_frame_free(&src);
+        av_frame_free(&dst);
+    }
+};
+
+/**
+ * 4K yuv420p 盒式下采样到 1080p（2:1）和 540p（4:1），单线程与线程池并行
+ */
+void BenchDownscale(std::vector<MicroResult>& results)
+{
+    ThreadPool pool(2);
+    AVFrame* src = av_frame_alloc();
+    src->format = AV_PIX_FMT_YUV420P;
+    src->width = 3840;
+    src->height = 2160;
+    if (av_frame_get_buffer(src, 0) < 0) {
+        av_frame_free(&src);
+        return;
+    }
+    av_frame_make_writable(src);
+    for (int p = 0; p < 3; p++)
+        memset(src->data[p], 0x80, src->linesize[p] * (p ? 1080 : 2160));
+
+    for (int factor = 2; factor <= 4; factor *= 2) {
+        AVFrame* dst = av_frame_alloc();
+        dst->format = AV_PIX_FMT_YUV420P;
+        DownscaleSize(src->width, src->height, factor, &dst->width, &dst->height);
+        if (av_frame_get_buffer(dst, 0) < 0) {
+            av_frame_free(&dst);
+            continue;
+        }
+
+        for (int mt = 0; mt < 2; mt++) {
+            int64_t count = 0;
+            int64_t start = TraceNowNs();
+            while (TraceNowNs() - start < MICRO_MIN_RUN_NS || count < 10) {
+                DownscaleFrame(src, dst, factor, mt ? &pool : nullptr);
+                count++;
+            }
+
+            char params[48];
+            snprintf(params, sizeof(params), "3840x2160 %d:1%s", factor, mt ? " mt" : "");
+            MicroResult result;
+            result.name = "video.downscale";
+            result.params = params;
+            result.iterations = count;
+            result.elapsed_ns = TraceNowNs() - start;
+            result.extra_name = "gb_per_sec";
+            result.extra = 3840 * 2160 * 1.5 * count / result.elapsed_ns;
+            results.push_back(result);
+        }
+        av_frame_free(&dst);
+    }
+
+    av_frame_free(&src);
+};
+
+// ============================================================================
+//                              共享内存帧环
+// ============================================================================
+
+/**
+ * 一个线程往 4 槽共享内存帧环写 1080p YUV420P 帧，另一个线程映射同一块内存原地读取亮度平面：
+ * 写端每帧拷贝的吞吐与延迟，以及读端完整读到（未被覆盖）的帧比例
+ */
+void BenchShmRing(std::vector<MicroResult>& results)
+{
+    const int w = 1920;
+    const int h = 1080;
+    const char* name = "player_microbench_ring";
+
+    AVFrame* src = av_frame_alloc();
+    src->format = AV_PIX_FMT_YUV420P;
+    src->width = w;
+    src->height = h;
+    if (av_frame_get_buffer(src, 0) < 0) {
+        av_frame_free(&src);
+        return;
+    }
+    for (int p = 0; p < 3; p++)
+        memset(src->data[p], 0x80, src->linesize[p] * (p ? h / 2 : h));
+
+    ShmFrameRing writer;
+    ShmFrameRing reader;
+    if (writer.Create(name, 4, (int64_t)(w + 64) * h * 3 / 2) < 0 || reader.Open(name) < 0) {
+        av_frame_free(&src);
+        return;
+    }
+
+    // 读端：跟随最新帧，原地求亮度和（模拟推理前处理读一遍整帧）
+    std::atomic<bool> stop{ false };
+    int64_t read_ok = 0;
+    int64_t read_torn = 0;
+    std::thread consumer([&] {
+        uint64_t next = 0;
+        uint64_t sum = 0;
+        while (!stop) {
+            uint64_t ws = reader.WriteSeq();
+            if (next >= ws) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (ws - next >= (uint64_t)reader.SlotCount())
+                next = ws - 1;
+
+            ShmFrameView view;
+            if (reader.Acquire(next, &view) == 0) {
+                for (int y = 0; y < view.height; y++) {
+                    const uint8_t* row = view.data[0] + (size_t)y * view.linesize[0];
+                    for (int x = 0; x < view.width; x += 8)
+                        sum += row[x];
+                }
+                if (reader.Validate(view))
+                    read_ok++;
+                else
+                    read_torn++;
+            }
+            else {
+                read_torn++;
+            }
+            next++;
+        }
+        volatile uint64_t sink = sum;  // 防止求和被优化掉
+        (void)sink;
+    });
+
+    std::vector<int64_t> samples;
+    int64_t count = 0;
+    int64_t start = TraceNowNs();
+    while (TraceNowNs() - start < MICRO_MIN_RUN_NS || count < 10) {
+        int64_t t0 = TraceNowNs();
+        src->pts = count;
+        writer.Write(src, AVRational{ 1, 30 });
+        samples.push_back(TraceNowNs() - t0);
+        count++;
+    }
+    int64_t elapsed = TraceNowNs() - start;
+    stop = true;
+    consumer.join();
+
+    MicroResult result;
+    result.name = "shm.ring_write";
+    result.params = "1920x1080 yuv420p 4 slots";
+    result.iterations = count;
+    result.elapsed_ns = elapsed;
+    result.extra_name = "gb_per_sec";
+    result.extra = w * h * 1.5 * count / elapsed;
+    SetLatency(result, samples);
+    results.push_back(result);
+
+    MicroResult read;
+    read.name = "shm.ring_read";
+    read.params = "1920x1080 luma in place";
+    read.iterations = read_ok;
+    read.elapsed_ns = elapsed;
+    read.extra_name = "overwritten_ratio";
+    read.extra = read_ok + read_torn > 0 ? (double)read_torn / (read_ok + read_torn) : 0.0;
+    results.push_back(read);
+
+    reader.Close();
+    writer.Close();
+    av_frame_free(&src);
+};
+
+// ============================================================================
+//                                  输出
+// ============================================================================
+
+void WriteJson(FILE* fp, const std::vector<MicroResult>& results)
+{
+    fprintf(fp, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const MicroResult& r = results[i];
+        double ns_per_op = r.iterations > 0 ? (double)r.elapsed_ns / r.iterations : 0.0;
+        double ops_per_sec = r.elapsed_ns > 0 ? r.iterations * 1e9 / r.elapsed_ns : 0.0;
+
+        fprintf(fp, "    {\"name\": \"%s\", \"params\": \"%s\", \"iterations\": %lld, "
+            "\"ns_per_op\": %.2f, \"ops_per_sec\": %.1f",
+            r.name.c_str(), r.params.c_str(), (long long)r.iterations, ns_per_op, ops_per_sec);
+        if (r.p50_ns >= 0) {
+            fprintf(fp, ", \"p50_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld",
+                (long long)r.p50_ns, (long long)r.p99_ns, (long long)r.max_ns);
+        }
+        if (r.extra_name)
+            fprintf(fp, ", \"%s\": %.4f", r.extra_name, r.extra);
+        fprintf(fp, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+};
+
+} // namespace
+
+int RunMicroBenchmarks(const char* json_path)
+{
+    bool to_stdout = !json_path || strcmp(json_path, "-") == 0;
+    std::vector<MicroResult> results;
+
+    // 进度输出到 stderr，stdout 可能是 JSON
+    fprintf(stderr, "microbench: queue\n");
+    BenchQueueSingleThread(results);
+    BenchQueueThreads(results, 1, 1);
+    BenchQueueThreads(results, 4, 4);
+
+    fprintf(stderr, "microbench: packet / frame queue\n");
+    BenchPacketQueue(results);
+    BenchFrameQueue(results);
+    BenchPacketArena(results);
+
+    fprintf(stderr, "microbench: avsync\n");
+    BenchAVSync(results, 0);
+    BenchAVSync(results, 3);
+
+    fprintf(stderr, "microbench: audio callback\n");
+    BenchAudioCallback(results, 1.0f);
+    BenchAudioCallback(results, 1.5f);
+
+    fprintf(stderr, "microbench: letterbox / yuv copy\n");
+    BenchLetterBox(results);
+    BenchYuvCopy(results);
+
+    fprintf(stderr, "microbench: depth convert\n");
+    BenchDepthConvert(results);
+    BenchDownscale(results);
+
+    fprintf(stderr, "microbench: shared memory ring\n");
+    BenchShmRing(results);
+
+    if (to_stdout) {
+        WriteJson(stdout, results);
+        return 0;
+    }
+
+    FILE* fp = fopen(json_path, "w");
+    if (!fp) {
+        fprintf(stderr, "microbench: open %s failed\n", json_path);
+        return -1;
+    }
+    WriteJson(fp, results);
+    fclose(fp);
+
+    // 写文件时在终端输出简表
+    for (const MicroResult& r : results) {
+        printf("%-24s %-22s %12.1f ns/op", r.name.c_str(), r.params.c_str(),
+            r.iterations > 0 ? (double)r.elapsed_ns / r.iterations : 0.0);
+        if (r.p50_ns >= 0)
+            printf("  p50 %lld ns  p99 %lld ns", (long long)r.p50_ns, (long long)r.p99_ns);
+        if (r.extra_name)
+            printf("  %s %.3f", r.extra_name, r.extra);
+        printf("\n");
+    }
+    printf("microbench: results written to %s\n", json_path);
+
+    return 0;
+};
@@ -0,0 +1,23 @@
+﻿#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+/**
+ * @brief 热点组件微基准测试（不需要媒体文件、窗口和声卡）
+ *
+ * 覆盖：
+ *   - Queue<T>：单线程 push/pop、1:1 与 4:4 争用下的吞吐和入队到出队延迟
+ *   - AVPacketQueue / AVFrameQueue：每次 push/pop 的开销与分配次数
+ *   - AVSync：一个线程 SetClock、多个线程 GetClock 时的单次开销
+ *   - 音频回调转换路径：atempo 滤镜图 + swr_convert + memcpy（不同倍速）
+ *   - CalcLetterBoxRect 与各分辨率 YUV 平面拷贝 / 软件渲染器纹理上传
+ *   - 共享内存帧环：1080p 帧的写入吞吐 / 延迟，读端原地读取期间帧被覆盖的比例
+ *
+ * 结果以 JSON 输出，每项包含 iterations、ns_per_op、ops_per_sec，
+ * 有单次延迟的项另有 p50_ns / p99_ns / max_ns，部分项带附加指标（allocs_per_op、gb_per_sec 等）。
+ *
+ * @param json_path 结果文件路径；nullptr 或 "-" 时输出到 stdout
+ * @return 成功返回0，失败返回-1
+ */
+int RunMicroBenchmarks(const char* json_path);
+
+#endif // MICROBENCH_H
@@ -0,0 +1,225 @@
+﻿#include "nullsink.h"
+#include "threadutil.h"
+#include "framelatency.h"
+#include "tracing.h"
+#include "syncprobe.h"
+#include <chrono>
+
+// 队列为空时的等待时间（毫秒）
+#define NULL_SINK_POP_TIMEOUT 10
+
+// 按时钟同步时单次最长等待（秒）
+#define NULL_SINK_MAX_WAIT 0.01
+
+// ============================================================================
+//                                NullAudioSink
+// ============================================================================
+
+NullAudioSink::NullAudioSink(AVSync* avsync, const AudioParams& audio_params,
+    AVFrameQueue* frame_queue, AVRational time_base, bool paced,
+    VirtualClock* virtual_clock)
+    : avsync_(avsync),
+    src_tgt_(audio_params),
+    frame_queue_(frame_queue),
+    time_base_(time_base),
+    paced_(paced || virtual_clock),
+    virtual_clock_(virtual_clock)
+{
+    if (virtual_clock_)
+        clock_id_ = virtual_clock_->AddParticipant();
+};
+
+NullAudioSink::~NullAudioSink()
+{
+    DeInit();
+
+    if (virtual_clock_)
+        virtual_clock_->RemoveParticipant(clock_id_);
+};
+
+int NullAudioSink::Init()
+{
+    abort_ = false;
+    thread_ = std::thread(&NullAudioSink::Run, this);
+
+    return 0;
+};
+
+int NullAudioSink::DeInit()
+{
+    abort_ = true;
+    if (thread_.joinable())
+        thread_.join();
+
+    return 0;
+};
+
+/**
+ * @brief 切换到新的音频流：停止消费线程，更新参数后重新启动
+ */
+int NullAudioSink::Reconfigure(const AudioParams& audio_params,
+    AVFrameQueue* frame_queue, AVRational time_base)
+{
+    DeInit();
+
+    src_tgt_ = audio_params;
+    frame_queue_ = frame_queue;
+    time_base_ = time_base;
+    paused_ = false;
+
+    return Init();
+};
+
+void NullAudioSink::Run()
+{
+    using clock = std::chrono::steady_clock;
+
+    SetCurrentThreadName("null audio sink");
+
+    clock::time_point start = clock::now();
+    double virtual_start = virtual_clock_ ? virtual_clock_->NowSec() : 0.0;
+    double played = 0.0;  // paced 模式下已“播放”的时长（秒）
+    int64_t frames = 0;   // 已消费帧数，用于控制 CPU 时间采样频率
+
+    while (!abort_) {
+        // 暂停时不消费也不推动时钟；恢复后重新计时
+        if (paused_) {
+            ThreadSleepMs(NULL_SINK_POP_TIMEOUT);
+            start = clock::now();
+            if (virtual_clock_)
+                virtual_start = virtual_clock_->NowSec();
+            played = 0.0;
+            continue;
+        }
+
+        AVFrame* frame = frame_queue_->Pop(NULL_SINK_POP_TIMEOUT);
+        if (!frame)
+            continue;
+
+        samples_played_ += frame->nb_samples;
+
+        if (paced_ && frame->sample_rate > 0) {
+            // 倍速播放时，同样多的样本实际播放时间为 时长 / 倍速
+            played += frame->nb_samples / (double)frame->sample_rate / speed_;
+            if (virtual_clock_) {
+                // 虚拟时间：等其它输出端也进入等待后，时间直接跳到本帧播放结束
+                while (!abort_ &&
+                    virtual_clock_->SleepUntil(clock_id_, virtual_start + played, NULL_SINK_POP_TIMEOUT) < 0);
+            }
+            else {
+                std::this_thread::sleep_until(start +
+                    std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(played)));
+            }
+
+            // 同步精度测试：本帧在刚结束的这段时间内“播放”
+            if (SyncProbe::Instance().Enabled()) {
+                double period = 1.0 / frame->sample_rate / speed_;
+                SyncProbe::Instance().OnAudioFrame(frame,
+                    avsync_->SourceNowSec() - frame->nb_samples * period, period);
+            }
+        }
+
+        // 与 SDL 回调相同：用刚“播放”完的帧的 pts 更新主时钟
+        if (frame->pts != AV_NOPTS_VALUE)
+            avsync_->SetClock(frame->pts * av_q2d(time_base_));
+
+        frame_queue_->Recycle(frame);
+
+        // 每 16 帧采样一次线程 CPU 时间
+        if ((++frames & 15) == 0)
+            cpu_time_us_ = CurrentThreadCpuTimeUs();
+    }
+
+    cpu_time_us_ = CurrentThreadCpuTimeUs();
+};
+
+// ============================================================================
+//                                NullVideoSink
+// ============================================================================
+
+NullVideoSink::NullVideoSink(AVSync* avsync, AVFrameQueue* frame_queue,
+    int video_width, int video_height, AVRational time_base, bool paced,
+    VirtualClock* virtual_clock)
+    : avsync_(avsync),
+    frame_queue_(frame_queue),
+    video_width_(video_width),
+    video_height_(video_height),
+    time_base_(time_base),
+    paced_(paced || virtual_clock),
+    virtual_clock_(virtual_clock)
+{
+    if (virtual_clock_)
+        clock_id_ = virtual_clock_->AddParticipant();
+};
+
+NullVideoSink::~NullVideoSink()
+{
+    if (virtual_clock_)
+        virtual_clock_->RemoveParticipant(clock_id_);
+};
+
+int NullVideoSink::Reconfigure(AVFrameQueue* frame_queue,
+    int video_width, int video_height, AVRational time_base)
+{
+    frame_queue_ = frame_queue;
+    video_width_ = video_width;
+    video_height_ = video_height;
+    time_base_ = time_base;
+    paused_ = false;
+    quit_ = false;
+
+    return 0;
+};
+
+int NullVideoSink::MainLoop()
+{
+    while (!quit_) {
+        if (paused_) {
+            ThreadSleepMs(NULL_SINK_POP_TIMEOUT);
+            continue;
+        }
+
+        if (paced_) {
+            // 与 VideoOutput::videoRefresh 相同的同步规则：帧时间未到则等待
+            AVFrame* front = frame_queue_->Front();
+            if (!front) {
+                ThreadSleepMs(1);
+                continue;
+            }
+
+            double diff = front->pts * av_q2d(time_base_) - avsync_->GetClock();
+            if (diff > 0) {
+                double wait = diff > NULL_SINK_MAX_WAIT ? NULL_SINK_MAX_WAIT : diff;
+                if (virtual_clock_) {
+                    // 目标时间只算一次：中途被其它输出端的事件唤醒时不能顺延
+                    double target = virtual_clock_->NowSec() + wait;
+                    while (!quit_ &&
+                        virtual_clock_->SleepUntil(clock_id_, target, NULL_SINK_POP_TIMEOUT) < 0);
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+                }
+                continue;
+            }
+
+            sync_metrics_.Record(diff);
+        }
+
+        AVFrame* frame = frame_queue_->Pop(NULL_SINK_POP_TIMEOUT);
+        if (!frame)
+            continue;
+
+        StampPresent(frame);
+        if (paced_ && SyncProbe::Instance().Enabled())
+            SyncProbe::Instance().OnVideoPresent(frame, avsync_->SourceNowSec());
+        frame_queue_->Recycle(frame);
+
+        // 每 16 帧采样一次线程 CPU 时间
+        if ((++frames_presented_ & 15) == 0)
+            cpu_time_us_ = CurrentThreadCpuTimeUs();
+    }
+
+    cpu_time_us_ = CurrentThreadCpuTimeUs();
+
+    return 0;
+};
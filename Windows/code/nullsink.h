@@ -0,0 +1,111 @@
+﻿#ifndef NULLSINK_H
+#define NULLSINK_H
+
+#include "outputsink.h"
+#include "avsync.h"
+#include "clocksource.h"
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief 空音频输出：不打开任何设备，在自己的线程上消费音频帧并推动主时钟
+ *
+ * - paced = false：取到帧立即丢弃，时钟直接跳到该帧 pts（测最大吞吐）
+ * - paced = true ：按样本数 / 采样率 / 倍速换算的时长实时消费，与声卡播放节奏一致
+ * - 传入 virtual_clock 时按相同时长在虚拟时间上等待（隐含 paced）
+ */
+class NullAudioSink : public AudioSink
+{
+public:
+    NullAudioSink(AVSync* avsync, const AudioParams& audio_params,
+        AVFrameQueue* frame_queue, AVRational time_base, bool paced,
+        VirtualClock* virtual_clock = nullptr);
+    ~NullAudioSink();
+
+    int Init() override;        // 启动消费线程
+    int DeInit() override;      // 停止消费线程
+
+    int Reconfigure(const AudioParams& audio_params,
+        AVFrameQueue* frame_queue, AVRational time_base) override;
+
+    void Pause() override { paused_ = true; };
+    void Resume() override { paused_ = false; };
+    bool isPaused() override { return paused_; };
+
+    void SetSpeed(float s) override { speed_ = s < 0.5f ? 0.5f : s; };
+    float GetSpeed() const override { return speed_; };
+
+    int64_t SamplesPlayed() const override { return samples_played_; };
+    int64_t CpuTimeUs() const override { return cpu_time_us_; };
+
+private:
+    void Run();                 // 消费线程主循环
+
+private:
+    AVSync* avsync_ = nullptr;              // 音视频同步对象
+    AudioParams src_tgt_;                   // 源音频参数（只用到采样率）
+    AVFrameQueue* frame_queue_ = nullptr;   // 音频帧队列
+    AVRational time_base_;                  // 音频时间基
+    bool paced_ = false;                    // 是否按实时节奏消费
+    VirtualClock* virtual_clock_ = nullptr; // 虚拟时钟（为空表示使用墙上时间）
+    int clock_id_ = -1;                     // 在虚拟时钟中的参与者编号
+
+    std::thread thread_;                    // 消费线程
+    std::atomic<bool> abort_{ false };      // 退出标志
+    std::atomic<bool> paused_{ false };     // 暂停标志
+    std::atomic<float> speed_{ 1.0f };      // 倍速
+
+    std::atomic<int64_t> samples_played_{ 0 }; // 已消费样本数
+    std::atomic<int64_t> cpu_time_us_{ 0 };    // 消费线程 CPU 时间
+};
+
+/**
+ * @brief 空视频输出：不创建窗口，在播放线程上消费视频帧
+ *
+ * - paced = false：取到帧立即丢弃
+ * - paced = true ：与 VideoOutput 相同的同步规则，帧时间未到时等待主时钟
+ * - 传入 virtual_clock 时在虚拟时间上等待（隐含 paced）
+ */
+class NullVideoSink : public VideoSink
+{
+public:
+    NullVideoSink(AVSync* avsync, AVFrameQueue* frame_queue,
+        int video_width, int video_height, AVRational time_base, bool paced,
+        VirtualClock* virtual_clock = nullptr);
+    ~NullVideoSink();
+
+    int Init() override { return 0; };
+    void DeInit() override {};
+
+    int Reconfigure(AVFrameQueue* frame_queue,
+        int video_width, int video_height, AVRational time_base) override;
+
+    int MainLoop() override;
+    void RequestQuit() override { quit_ = true; };
+
+    void Pause() override { paused_ = true; };
+    void Resume() override { paused_ = false; };
+    bool isPaused() override { return paused_; };
+
+    int64_t FramesPresented() const override { return frames_presented_; };
+    int64_t CpuTimeUs() const override { return cpu_time_us_; };
+
+private:
+    AVSync* avsync_ = nullptr;              // 音视频同步对象
+    AVFrameQueue* frame_queue_ = nullptr;   // 视频帧队列
+    int video_width_ = 0;                   // 视频宽度
+    int video_height_ = 0;                  // 视频高度
+    AVRational time_base_;                  // 视频时间基
+    bool paced_ = false;                    // 是否按时钟同步
+    VirtualClock* virtual_clock_ = nullptr; // 虚拟时钟（为空表示使用墙上时间）
+    int clock_id_ = -1;                     // 在虚拟时钟中的参与者编号
+
+    std::atomic<bool> quit_{ false };       // 外部请求退出
+    std::atomic<bool> paused_{ false };     // 暂停标志
+
+    std::atomic<int64_t> frames_presented_{ 0 }; // 已消费帧数
+    std::atomic<int64_t> cpu_time_us_{ 0 };      // 播放线程 CPU 时间
+    VideoSyncMetrics sync_metrics_;              // 晚帧数与音视频偏差指标（仅 paced）
+};
+
+#endif // NULLSINK_H
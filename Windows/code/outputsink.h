@@ -0,0 +1,147 @@
+﻿#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "avframequeue.h"
+#include "metrics.h"
+
+class SnapshotWriter;
+
+#ifdef __cplusplus
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/samplefmt.h"
+#include "libavutil/pixfmt.h"
+}
+#endif
+
+/**
+ * @brief 音频参数结构体（包含采样率 / 声道布局 / 采样格式）
+ *        此结构由解析器或解码器初始化后传入。
+ */
+typedef struct _AudioParams {
+    int freq;                   // 采样率
+    AVChannelLayout ch_layout;  // 声道布局
+    enum AVSampleFormat fmt;    // 采样格式
+} AudioParams;
+
+/**
+ * @brief 输出端类型
+ *
+ * - Sdl       ：SDL 窗口 + SDL 音频设备（正常播放）
+ * - NullFast  ：空输出，取到帧立即丢弃，测量解复用 + 解码的最大吞吐
+ * - NullPaced ：空输出，按音频时长实时消费，视频按时钟同步，行为与正常播放一致
+ * - NullVirtual：与 NullPaced 相同的同步规则，但使用虚拟时钟，等待不消耗墙上时间，
+ *               以 CPU 允许的最快速度得到与实时播放相同的显示决策
+ */
+enum class SinkType {
+    Sdl,
+    NullFast,
+    NullPaced,
+    NullVirtual
+};
+
+/**
+ * @brief 视频输出端共用的同步指标：video.frames_late / avsync.drift_us / avsync.abs_drift_us
+ */
+class VideoSyncMetrics
+{
+public:
+    VideoSyncMetrics()
+    {
+        MetricsRegistry& registry = MetricsRegistry::Instance();
+        frames_late_ = registry.GetCounter("video.frames_late");
+        drift_ = registry.GetGauge("avsync.drift_us");
+        abs_drift_ = registry.GetHistogram("avsync.abs_drift_us");
+    };
+
+    /**
+     * @brief 显示一帧时调用
+     * @param diff 帧 pts - 主时钟（秒），负数表示晚于应显示时间
+     */
+    void Record(double diff)
+    {
+        int64_t us = (int64_t)(diff * 1000000.0);
+        drift_->Set(us);
+        abs_drift_->Record(us < 0 ? -us : us);
+        if (diff < -0.04)
+            frames_late_->Add(1);
+    };
+
+private:
+    MetricCounter* frames_late_ = nullptr;   // 晚于 pts 超过 40ms 显示的帧数
+    MetricGauge* drift_ = nullptr;           // 最近一帧的音视频偏差（微秒）
+    LatencyHistogram* abs_drift_ = nullptr;  // 音视频偏差绝对值分布（微秒）
+};
+
+/**
+ * @brief 音频输出端接口（消费音频 AVFrameQueue，并驱动主时钟）
+ */
+class AudioSink
+{
+public:
+    virtual ~AudioSink() {};
+
+    virtual int Init() = 0;        // 打开输出
+    virtual int DeInit() = 0;      // 关闭输出
+
+    // 切换到新的音频流（保留已打开的设备）
+    virtual int Reconfigure(const AudioParams& audio_params,
+        AVFrameQueue* frame_queue, AVRational time_base) = 0;
+
+    virtual void Pause() = 0;      // 暂停播放
+    virtual void Resume() = 0;     // 恢复播放
+    virtual bool isPaused() = 0;   // 是否处于暂停
+
+    virtual void SetSpeed(float s) = 0;     // 设置倍速
+    virtual float GetSpeed() const = 0;     // 获取当前倍速
+
+    // ===== 统计 =====
+    virtual int64_t SamplesPlayed() const = 0;  // 已消费的样本数（每声道）
+    virtual int64_t CpuTimeUs() const = 0;      // 输出线程累计 CPU 时间（微秒）
+};
+
+/**
+ * @brief 视频输出端接口（消费视频 AVFrameQueue，按主时钟显示）
+ *
+ * MainLoop() 在播放线程上运行，直到 RequestQuit() 或用户关闭窗口
+ */
+class VideoSink
+{
+public:
+    virtual ~VideoSink() {};
+
+    virtual int Init() = 0;        // 打开输出
+    virtual void DeInit() = 0;     // 关闭输出
+
+    // 切换到新的视频流（保留已打开的窗口等资源）
+    virtual int Reconfigure(AVFrameQueue* frame_queue,
+        int video_width, int video_height, AVRational time_base) = 0;
+
+    virtual int MainLoop() = 0;    // 显示循环（阻塞）
+    virtual void RequestQuit() = 0;// 请求 MainLoop 退出（可在其他线程调用）
+
+    virtual void Pause() = 0;      // 暂停播放
+    virtual void Resume() = 0;     // 恢复播放
+    virtual bool isPaused() = 0;   // 是否暂停
+
+    // 显示 / 隐藏指标叠加层（可在其他线程调用；没有画面的输出端忽略）
+    virtual void SetOverlay(bool /*on*/) {};
+
+    // 窗口内切换叠加层时通知控制器，保持两边一致（Init 之前调用，在显示线程上回调）
+    virtual void SetOverlayListener(std::function<void(bool)> /*listener*/) {};
+
+    // 截图：显示帧时交给 writer 取引用（Init 之前调用，writer 比输出端活得久；没有画面的输出端忽略）
+    virtual void SetSnapshotWriter(SnapshotWriter* /*writer*/) {};
+
+    // 能直接显示的像素格式，其他格式由解码线程先转换；空表示任何格式都接受（Init 之后调用）
+    virtual std::vector<AVPixelFormat> DisplayFormats() const { return {}; };
+
+    // ===== 统计 =====
+    virtual int64_t FramesPresented() const = 0; // 已显示（消费）的帧数
+    virtual int64_t CpuTimeUs() const = 0;       // 显示线程累计 CPU 时间（微秒）
+};
+
+#endif // OUTPUTSINK_H
@@ -0,0 +1,142 @@
+﻿#include "packetarena.h"
+#include "allochook.h"
+#include <algorithm>
+#include <cstring>
+
+// 最小 / 最大级别（字节）；更大的包（如无损或超高码率的关键帧）很少见，不值得缓存
+#define ARENA_MIN_SLAB 1024
+#define ARENA_MAX_SLAB (8 * 1024 * 1024)
+// 默认缓存上限，解复用线程启动时按包队列字节预算重新设置
+#define ARENA_DEFAULT_CACHE (16 * 1024 * 1024)
+
+PacketArena& PacketArena::Instance()
+{
+    // 有意不释放：缓冲块可能在静态对象析构之后才被解码器归还
+    static PacketArena* instance = new PacketArena;
+    return *instance;
+};
+
+PacketArena::PacketArena()
+{
+    // 级别按约 1.25 倍递增并按 64 字节对齐，最多浪费约 20% 的空间
+    for (int64_t size = ARENA_MIN_SLAB; size <= ARENA_MAX_SLAB; size += std::max<int64_t>(size / 4, 64)) {
+        SizeClass size_class;
+        size_class.size = (int)((size + 63) & ~63);
+        classes_.push_back(size_class);
+    }
+
+    cache_limit_ = ARENA_DEFAULT_CACHE;
+
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    hits_ = registry.GetCounter("arena.packets.hits");
+    misses_ = registry.GetCounter("arena.packets.misses");
+    oversize_ = registry.GetCounter("arena.packets.oversize");
+    cached_ = registry.GetGauge("arena.packets.cached_bytes");
+    live_ = registry.GetGauge("arena.packets.live_bytes");
+};
+
+void PacketArena::SetCacheLimit(int64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_limit_ = bytes;
+
+    // 缩小上限时立即释放多出的空闲缓冲块（从大到小）
+    for (int i = (int)classes_.size() - 1; i >= 0 && cached_bytes_ > cache_limit_; i--) {
+        SizeClass& size_class = classes_[i];
+        while (!size_class.free.empty() && cached_bytes_ > cache_limit_) {
+            av_free(size_class.free.back());
+            size_class.free.pop_back();
+            cached_bytes_ -= size_class.size;
+        }
+    }
+    cached_->Set(cached_bytes_);
+};
+
+int PacketArena::ClassIndex(int size) const
+{
+    auto it = std::lower_bound(classes_.begin(), classes_.end(), size,
+        [](const SizeClass& size_class, int value) { return size_class.size < value; });
+    if (it == classes_.end())
+        return -1;
+
+    return (int)(it - classes_.begin());
+};
+
+int PacketArena::Adopt(AVPacket* pkt)
+{
+    // 空包（结束标记）不需要搬移
+    if (!pkt->data || pkt->size <= 0)
+        return 0;
+
+    int index = ClassIndex(pkt->size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (index < 0) {
+        oversize_->Add(1);
+        return 0;
+    }
+    int slab_size = classes_[index].size;
+
+    // 1. 取一个缓冲块：优先复用空闲链表
+    uint8_t* data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint8_t*>& free = classes_[index].free;
+        if (!free.empty()) {
+            data = free.back();
+            free.pop_back();
+            cached_bytes_ -= slab_size;
+            cached_->Set(cached_bytes_);
+        }
+    }
+    if (data) {
+        hits_->Add(1);
+    }
+    else {
+        data = (uint8_t*)av_malloc(slab_size);
+        if (!data)
+            return -1;
+        misses_->Add(1);
+    }
+
+    // 2. 包装成引用计数缓冲区，释放时回到本级别的空闲链表
+    live_->Add(slab_size);
+    AVBufferRef* buf;
+    {
+        LibraryAllocScope lib;  // AVBuffer + AVBufferRef（见 allochook.h）
+        buf = av_buffer_create(data, slab_size, FreeSlab, (void*)(intptr_t)index, 0);
+    }
+    if (!buf) {
+        FreeSlab((void*)(intptr_t)index, data);
+        return -1;
+    }
+
+    // 3. 拷贝负载并补齐解码器要求的零填充，替换原负载（时间戳、side data、opaque 不变）
+    memcpy(data, pkt->data, pkt->size);
+    memset(data + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    av_buffer_unref(&pkt->buf);
+    pkt->buf = buf;
+    pkt->data = data;
+
+    return 0;
+};
+
+void PacketArena::FreeSlab(void* opaque, uint8_t* data)
+{
+    PacketArena& arena = Instance();
+    int index = (int)(intptr_t)opaque;
+    int slab_size = arena.classes_[index].size;
+
+    {
+        std::lock_guard<std::mutex> lock(arena.mutex_);
+        if (arena.cached_bytes_ + slab_size <= arena.cache_limit_) {
+            arena.classes_[index].free.push_back(data);
+            arena.cached_bytes_ += slab_size;
+            arena.cached_->Set(arena.cached_bytes_);
+            data = nullptr;
+        }
+    }
+    arena.live_->Add(-slab_size);
+
+    // 缓存已满：直接释放
+    if (data)
+        av_free(data);
+};
@@ -0,0 +1,76 @@
+﻿#ifndef PACKETARENA_H
+#define PACKETARENA_H
+
+#include "metrics.h"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+/**
+ * @brief 解复用数据包负载的分级缓冲池（进程内唯一）
+ *
+ * av_read_frame 每次返回一块新 malloc 的负载，之后在包队列里停留几百毫秒到几秒；
+ * 高码率流每秒几千次中等大小的分配与长短不一的生存期混在一起，长时间运行后堆碎片化，RSS 持续上涨。
+ *
+ * 这里把负载拷贝进按大小分级（相邻级别相差约 25%）的缓冲块，再用 av_buffer_create
+ * 包装成引用计数的 AVBufferRef 替换原来的 pkt->buf：
+ *   - 最后一个引用释放时（通常在解码线程），缓冲块回到对应级别的空闲链表，下次直接复用
+ *   - 空闲链表总字节数不超过缓存上限（由包队列的字节预算设置），多出的直接释放，
+ *     所以池占用的内存 ≈ 队列中的数据 + 缓存上限，不随运行时间增长
+ *   - 拷贝后原负载立刻释放，malloc 下一次读包时马上复用同一块内存，不会留下碎片
+ *   - 超过最大级别的包保持原样
+ *
+ * 指标：arena.packets.hits / .misses / .oversize，arena.packets.cached_bytes / .live_bytes
+ */
+class PacketArena
+{
+public:
+    static PacketArena& Instance();
+
+    /**
+     * @brief 设置空闲缓冲块的总字节上限（超出部分归还时直接释放）
+     */
+    void SetCacheLimit(int64_t bytes);
+
+    /**
+     * @brief 把数据包的负载搬进缓冲池
+     * @param pkt av_read_frame 得到的数据包，成功后 pkt->buf / pkt->data 指向池中的缓冲块
+     * @return 成功（或无需搬移）返回0，分配失败返回-1（数据包保持原样，仍可使用）
+     */
+    int Adopt(AVPacket* pkt);
+
+private:
+    PacketArena();
+
+    /**
+     * @brief 取得 size 所属级别，超过最大级别返回 -1
+     */
+    int ClassIndex(int size) const;
+
+    /**
+     * @brief av_buffer_create 的释放回调，opaque 为级别下标
+     */
+    static void FreeSlab(void* opaque, uint8_t* data);
+
+    struct SizeClass {
+        int size = 0;                   // 缓冲块大小（含输入填充）
+        std::vector<uint8_t*> free;     // 空闲缓冲块
+    };
+
+    std::mutex mutex_;                  // 保护空闲链表与缓存字节数
+    std::vector<SizeClass> classes_;    // 按大小升序排列的级别
+    int64_t cache_limit_ = 0;           // 空闲缓冲块总字节上限
+    int64_t cached_bytes_ = 0;          // 当前空闲缓冲块总字节数
+
+    MetricCounter* hits_ = nullptr;     // 从空闲链表取得缓冲块的次数
+    MetricCounter* misses_ = nullptr;   // 空闲链表为空、新分配缓冲块的次数
+    MetricCounter* oversize_ = nullptr; // 超过最大级别、保持原样的包数
+    MetricGauge* cached_ = nullptr;     // 空闲缓冲块总字节数
+    MetricGauge* live_ = nullptr;       // 正被数据包引用的缓冲块总字节数
+};
+
+#endif // PACKETARENA_H
@@ -2,13 +2,17 @@
 #define QUEUE_H
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <vector>
+#include "threadutil.h"
+#include "tracing.h"
 
 /**
  * @brief 线程安全的队列模板类
  * @tparam T 队列元素类型
  *
  * 该队列提供了线程安全的入队、出队操作，支持超时等待和优雅终止
+ *
+ * 底层为只增不减的环形缓冲区：容量达到历史最大长度后，入队出队不再分配内存
  */
 template <typename T>
 class Queue
@@ -36,6 +40,17 @@ public:
         cond_.notify_all();            // 唤醒所有等待的线程
     };
 
+    /**
+     * @brief 清除终止标志，使队列可以再次使用
+     *
+     * 用于播放会话之间复用同一个队列对象（调用前应先取空队列）
+     */
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        abort_ = 0;
+    };
+
     /**
      * @brief 向队列中添加元素
      * @param val 要添加的元素
@@ -49,7 +64,10 @@ public:
             return -1;
         }
 
-        queue_.push(val);              // 元素入队
+        if (count_ == ring_.size())    // 已满时扩容
+            Grow();
+        ring_[(head_ + count_) % ring_.size()] = val;  // 元素入队
+        count_++;
         cond_.notify_one();            // 通知一个等待的消费者线程
 
         return 0;
@@ -64,21 +82,25 @@ public:
     int Pop(T& val, const int timeout = 0)
     {
         std::unique_lock<std::mutex> lock(mutex_); // 获取互斥锁
-        if (queue_.empty()) {           // 如果队列为空
+        if (count_ == 0) {              // 如果队列为空
+            TraceScope trace("queue wait");
+            ThreadWaitScope wait(WaitKind::Queue);
             // 等待push或者超时唤醒
             cond_.wait_for(lock, std::chrono::milliseconds(timeout), [this] {
                 // 等待条件：队列非空或队列已终止
-                return !queue_.empty() | (abort_ == 1);
+                return (count_ != 0) | (abort_ == 1);
                 });
         }
         if (1 == abort_) {              // 检查队列是否已终止
             return -1;
         }
-        if (queue_.empty()) {           // 检查是否因超时仍为空
+        if (count_ == 0) {              // 检查是否因超时仍为空
             return -2;
         }
-        val = queue_.front();          // 获取队首元素
-        queue_.pop();                  // 移除队首元素
+        val = ring_[head_];            // 获取队首元素
+        ring_[head_] = T();            // 移除队首元素
+        head_ = (head_ + 1) % ring_.size();
+        count_--;
 
         return 0;
     };
@@ -94,10 +116,10 @@ public:
         if (1 == abort_) {              // 检查队列是否已终止
             return -1;
         }
-        if (queue_.empty()) {           // 检查队列是否为空
+        if (count_ == 0) {              // 检查队列是否为空
             return -2;
         }
-        val = queue_.front();          // 获取队首元素
+        val = ring_[head_];            // 获取队首元素
 
         return 0;
     };
@@ -109,14 +131,28 @@ public:
     int Size()
     {
         std::lock_guard<std::mutex> lock(mutex_);  // 获取互斥锁
-        return queue_.size();          // 返回队列大小
+        return (int)count_;            // 返回队列大小
     };
 
 private:
+    /**
+     * @brief 容量翻倍（调用方持有锁），元素按队列顺序搬到新缓冲区开头
+     */
+    void Grow()
+    {
+        std::vector<T> ring(ring_.empty() ? 16 : ring_.size() * 2);
+        for (size_t i = 0; i < count_; i++)
+            ring[i] = ring_[(head_ + i) % ring_.size()];
+        ring_.swap(ring);
+        head_ = 0;
+    };
+
     int abort_ = 0;                    // 终止标志：0-运行中，1-已终止
     std::mutex mutex_;                 // 互斥锁，保护队列操作
     std::condition_variable cond_;     // 条件变量，用于线程间同步
-    std::queue<T> queue_;              // 底层队列容器
+    std::vector<T> ring_;              // 环形缓冲区
+    size_t head_ = 0;                  // 队首下标
+    size_t count_ = 0;                 // 元素个数
 };
 
 #endif // QUEUE_H
\ No newline at end of file
@@ -0,0 +1,96 @@
+﻿#include "shmexport.h"
+#include "textureupload.h"
+#include "threadutil.h"
+#include "tracing.h"
+#include <cstdio>
+
+extern "C" {
+#include "libavutil/imgutils.h"
+#include "libavutil/time.h"
+}
+
+// 导出线程取订阅队列的超时（毫秒）
+#define SHM_EXPORT_POP_TIMEOUT 100
+
+ShmFrameExporter::~ShmFrameExporter()
+{
+    Stop();
+};
+
+int ShmFrameExporter::Start(const std::string& name, const std::shared_ptr<FrameSubscription>& subscription,
+    const ShmExportOptions& options)
+{
+    Stop();
+
+    // 槽大小取最大尺寸下各显示格式中最大的一帧（打包 RGB 每像素 4 字节），
+    // 导出线程先于窗口启动，不知道渲染器最终选的格式；行距按环的对齐计算
+    int64_t max_frame_bytes = 0;
+    for (AVPixelFormat format : TexturePixelFormats()) {
+        int bytes = av_image_get_buffer_size(format, options.max_width, options.max_height, SHM_RING_ALIGN);
+        if (bytes > max_frame_bytes)
+            max_frame_bytes = bytes;
+    }
+    if (max_frame_bytes <= 0) {
+        printf("invalid shared memory frame size %dx%d\n", options.max_width, options.max_height);
+        return -1;
+    }
+    if (ring_.Create(name, options.slots, max_frame_bytes) < 0)
+        return -1;
+
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    frames_ = registry.GetCounter("shm.frames");
+    oversize_ = registry.GetCounter("shm.oversize");
+    write_time_ = registry.GetHistogram("shm.write_us");
+
+    subscription_ = subscription;
+    abort_ = false;
+    thread_ = new std::thread(&ShmFrameExporter::Run, this);
+
+    printf("exporting video frames to shared memory \"%s\" (%d slots)\n", name.c_str(), ring_.SlotCount());
+    return 0;
+};
+
+void ShmFrameExporter::Stop()
+{
+    if (thread_) {
+        abort_ = true;
+        thread_->join();
+        delete thread_;
+        thread_ = nullptr;
+    }
+    if (subscription_)
+        subscription_->Close();  // 订阅点在下一帧时移除
+    subscription_.reset();
+
+    ring_.MarkClosed();
+    ring_.Close();
+};
+
+void ShmFrameExporter::Run()
+{
+    SetCurrentThreadName("shm export");
+
+    while (!abort_) {
+        AVRational time_base;
+        AVFrame* frame = subscription_->Pop(SHM_EXPORT_POP_TIMEOUT, &time_base);
+        if (!frame) {
+            if (subscription_->Closed())
+                break;
+            continue;
+        }
+
+        {
+            TraceScope trace("shm write");
+            int64_t t0 = av_gettime_relative();
+            int ret = ring_.Write(frame, time_base);
+            if (ret == 0) {
+                frames_->Add(1);
+                write_time_->Record(av_gettime_relative() - t0);
+            }
+            else if (ret == -2) {
+                oversize_->Add(1);
+            }
+        }
+        subscription_->Recycle(frame);
+    }
+};
@@ -0,0 +1,64 @@
+﻿#ifndef SHMEXPORT_H
+#define SHMEXPORT_H
+
+#include "frametap.h"
+#include "metrics.h"
+#include "shmring.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+/**
+ * @brief 共享内存导出设置
+ */
+struct ShmExportOptions {
+    int slots = 4;                  // 槽数：读端最多可以落后 slots-1 帧
+    int max_width = 3840;           // 槽按该尺寸下显示端可能收到的最大帧（打包 RGB）分配，更大的帧跳过（shm.oversize）
+    int max_height = 2160;
+};
+
+/**
+ * @brief 把正在播放的视频帧导出到共享内存帧环（见 shmring.h），供推理等进程外的消费者读取
+ *
+ * 导出线程订阅视频解码输出（FrameTap，丢弃最旧的帧），取到帧后拷进环的下一个槽：
+ * 解码和渲染线程只多一次取引用，导出线程或读端跟不上时丢帧，不影响播放。
+ * 导出的是显示端收到的帧（像素格式转换 / 下采样之后），早于显示时间。
+ *
+ * 指标：shm.frames / shm.oversize（跳过的过大帧）、shm.write_us（每帧拷贝耗时，直方图），
+ *       订阅队列的丢帧见 tap.video.shm.dropped
+ */
+class ShmFrameExporter
+{
+public:
+    ShmFrameExporter() {};
+    ~ShmFrameExporter();
+
+    /**
+     * @brief 创建共享内存并启动导出线程
+     * @param name 共享内存名（读端用同一个名字打开）
+     * @param subscription 视频帧订阅（MainController::subscribeFrames，建议容量 2、丢弃最旧的帧）
+     * @return 成功返回0，失败返回-1
+     */
+    int Start(const std::string& name, const std::shared_ptr<FrameSubscription>& subscription,
+        const ShmExportOptions& options = ShmExportOptions());
+
+    /**
+     * @brief 停止导出线程，标记写端退出并删除共享内存
+     */
+    void Stop();
+
+private:
+    void Run();
+
+    ShmFrameRing ring_;
+    std::shared_ptr<FrameSubscription> subscription_;
+    std::thread* thread_ = nullptr;
+    std::atomic<bool> abort_{ false };
+
+    MetricCounter* frames_ = nullptr;
+    MetricCounter* oversize_ = nullptr;
+    LatencyHistogram* write_time_ = nullptr;
+};
+
+#endif // SHMEXPORT_H
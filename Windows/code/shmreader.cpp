@@ -0,0 +1,104 @@
+﻿#include "shmreader.h"
+#include "shmring.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// 等待写端创建共享内存的最长时间（秒）
+#define SHM_READER_OPEN_TIMEOUT 10.0
+// 没有新帧时的轮询间隔（毫秒）
+#define SHM_READER_POLL_MS 1
+
+int RunShmReader(const char* name, double seconds)
+{
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    auto elapsed = [&start] {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    // 1. 打开共享内存（写端可能还没启动）
+    ShmFrameRing ring;
+    while (ring.Open(name) < 0) {
+        if (elapsed() > SHM_READER_OPEN_TIMEOUT) {
+            printf("shm reader: open \"%s\" failed\n", name);
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    printf("shm reader: mapped \"%s\" (%d slots)\n", name, ring.SlotCount());
+
+    // 2. 从最新帧开始跟随
+    uint64_t next = ring.WriteSeq();
+    int64_t frames = 0, bytes = 0, skipped = 0, overwritten = 0;
+    int64_t total_frames = 0, total_skipped = 0, total_overwritten = 0;
+    double last_report = elapsed();
+    double last_pts = 0.0;
+    double last_mean = 0.0;
+
+    while (seconds <= 0.0 || elapsed() < seconds) {
+        uint64_t ws = ring.WriteSeq();
+        if (next >= ws) {
+            if (ring.WriterClosed())
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(SHM_READER_POLL_MS));
+        }
+        else {
+            // 落后超过环的容量时跳到最新帧
+            if (ws - next >= (uint64_t)ring.SlotCount()) {
+                skipped += (int64_t)(ws - 1 - next);
+                next = ws - 1;
+            }
+
+            ShmFrameView view;
+            if (ring.Acquire(next, &view) == 0 && view.data[0]) {
+                // 原地读取第一个平面（YUV 为亮度）
+                uint64_t sum = 0;
+                int row_bytes = view.linesize[0] < view.width ? view.linesize[0] : view.width;
+                for (int y = 0; y < view.height; y++) {
+                    const uint8_t* row = view.data[0] + (size_t)y * view.linesize[0];
+                    for (int x = 0; x < row_bytes; x++)
+                        sum += row[x];
+                }
+
+                // 读完后确认这段时间没有被写端覆盖，否则结果作废
+                if (ring.Validate(view)) {
+                    frames++;
+                    bytes += (int64_t)row_bytes * view.height;
+                    last_mean = (double)sum / ((double)row_bytes * view.height);
+                    if (view.time_base.den > 0)
+                        last_pts = view.pts * av_q2d(view.time_base);
+                }
+                else {
+                    overwritten++;
+                }
+            }
+            else {
+                overwritten++;
+            }
+            next++;
+        }
+
+        double now = elapsed();
+        if (now - last_report >= 1.0) {
+            double span = now - last_report;
+            printf("shm reader: %.1f fps  %.1f MB/s  pts %.3f  mean %.1f  skipped %lld  overwritten %lld\n",
+                frames / span, bytes / span / 1e6, last_pts, last_mean,
+                (long long)skipped, (long long)overwritten);
+            total_frames += frames;
+            total_skipped += skipped;
+            total_overwritten += overwritten;
+            frames = bytes = skipped = overwritten = 0;
+            last_report = now;
+        }
+    }
+
+    total_frames += frames;
+    total_skipped += skipped;
+    total_overwritten += overwritten;
+    printf("shm reader: %s, %lld frames read, %lld skipped, %lld overwritten\n",
+        ring.WriterClosed() ? "writer closed" : "time limit reached",
+        (long long)total_frames, (long long)total_skipped, (long long)total_overwritten);
+
+    return 0;
+};
@@ -0,0 +1,21 @@
+﻿#ifndef SHMREADER_H
+#define SHMREADER_H
+
+/**
+ * @brief 共享内存帧环的示例读端（--shm-read）
+ *
+ * 另一个进程用 --shm-export <名字> 播放时，映射同名共享内存（见 shmring.h），
+ * 跟随最新帧原地读取第一个平面（求平均值，代表推理前处理读一遍整帧），不复制帧数据。
+ * 每秒输出一次：读到的帧数 / 秒、读取的字节数 / 秒、最新帧 pts、平均亮度，
+ * 以及因落后被跳过的帧数和读取期间被覆盖（结果作废）的帧数。
+ * 写端退出或到达时长后结束。
+ *
+ * 推理进程可以照此实现：只依赖 shmring.h 的布局，不需要链接播放器的其他部分。
+ *
+ * @param name    共享内存名（与 --shm-export 相同）
+ * @param seconds 最长运行时间（秒），0 表示直到写端退出
+ * @return 成功返回0，打不开共享内存返回-1
+ */
+int RunShmReader(const char* name, double seconds);
+
+#endif // SHMREADER_H
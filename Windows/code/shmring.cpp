@@ -0,0 +1,349 @@
+﻿#include "shmring.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+extern "C" {
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+}
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SHM_ALIGN_UP(x) (((x) + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN)
+
+// 槽头占用的字节数（平面数据从这里开始）
+#define SHM_SLOT_HEADER_BYTES SHM_ALIGN_UP(sizeof(ShmSlotHeader))
+
+static std::string PlatformName(const std::string& name)
+{
+#ifdef _WIN32
+    return "Local\\" + name;
+#else
+    return "/" + name;
+#endif
+};
+
+#ifndef _WIN32
+/**
+ * @brief 已存在的同名内存是否是可以替换的残留：不是帧环（没有 magic），或写端已标记退出
+ */
+static bool StaleSegment(const std::string& path)
+{
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return errno == ENOENT;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size < (off_t)sizeof(ShmRingHeader)) {
+        close(fd);
+        return true;
+    }
+    void* base = mmap(NULL, sizeof(ShmRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    const ShmRingHeader* header = (const ShmRingHeader*)base;
+    bool stale = header->magic != SHM_RING_MAGIC || header->closed.load(std::memory_order_acquire) != 0;
+    munmap(base, sizeof(ShmRingHeader));
+    return stale;
+};
+#endif
+
+ShmFrameRing::~ShmFrameRing()
+{
+    Close();
+};
+
+int ShmFrameRing::Create(const std::string& name, int slot_count, int64_t max_frame_bytes)
+{
+    Close();
+
+    if (slot_count < 2)
+        slot_count = 2;
+    uint64_t header_bytes = SHM_ALIGN_UP(sizeof(ShmRingHeader));
+    uint64_t slot_bytes = SHM_SLOT_HEADER_BYTES + SHM_ALIGN_UP((uint64_t)max_frame_bytes);
+    uint64_t size = header_bytes + slot_bytes * slot_count;
+    std::string path = PlatformName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        (DWORD)(size >> 32), (DWORD)size, path.c_str());
+    if (!mapping) {
+        printf("CreateFileMapping %s failed, err:%lu\n", path.c_str(), GetLastError());
+        return -1;
+    }
+    // 同名映射还有人打开着（另一个写端，或上一个写端的读端还没退出）：CreateFileMapping 会直接返回它，
+    // 大小和布局都可能不同，不能在读端底下重新初始化，要求换一个名字
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        printf("shared memory %s is already in use by another writer or reader, use another name\n",
+            path.c_str());
+        CloseHandle(mapping);
+        return -1;
+    }
+    void* base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+    if (!base) {
+        printf("MapViewOfFile %s failed, err:%lu\n", path.c_str(), GetLastError());
+        CloseHandle(mapping);
+        return -1;
+    }
+    mapping_ = mapping;
+#else
+    // 同名内存已存在时，只替换已退出的写端留下的（closed 已置位或不是帧环），
+    // 另一个写端还在用的不动，和 Windows 一样要求换一个名字
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        if (!StaleSegment(path)) {
+            printf("shared memory %s is already in use by another writer, use another name "
+                "(remove /dev/shm%s if that writer crashed)\n", path.c_str(), path.c_str());
+            return -1;
+        }
+        shm_unlink(path.c_str());
+        fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        printf("shm_open %s failed, errno:%d\n", path.c_str(), errno);
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        printf("ftruncate %s failed\n", path.c_str());
+        close(fd);
+        shm_unlink(path.c_str());
+        return -1;
+    }
+    void* base = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("mmap %s failed\n", path.c_str());
+        shm_unlink(path.c_str());
+        return -1;
+    }
+#endif
+
+    name_ = name;
+    owner_ = true;
+    base_ = (uint8_t*)base;
+    size_ = (size_t)size;
+
+    // 先初始化槽头，最后写 magic：读端看到 magic 时布局已完整
+    for (int i = 0; i < slot_count; i++) {
+        ShmSlotHeader* slot = new (base_ + header_bytes + slot_bytes * i) ShmSlotHeader();
+        slot->seq.store(0, std::memory_order_relaxed);
+    }
+    header_ = new (base_) ShmRingHeader();
+    header_->version = SHM_RING_VERSION;
+    header_->slot_count = (uint32_t)slot_count;
+    header_->header_bytes = (uint32_t)header_bytes;
+    header_->slot_bytes = slot_bytes;
+    header_->write_seq.store(0, std::memory_order_relaxed);
+    header_->closed.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = SHM_RING_MAGIC;
+
+    return 0;
+};
+
+int ShmFrameRing::Open(const std::string& name)
+{
+    Close();
+
+    std::string path = PlatformName(name);
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (!mapping)
+        return -1;
+    void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(mapping);
+        return -1;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    if (VirtualQuery(base, &info, sizeof(info)) == 0) {
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        return -1;
+    }
+    size = info.RegionSize;
+    mapping_ = mapping;
+#else
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ShmRingHeader)) {
+        close(fd);
+        return -1;
+    }
+    size = (size_t)st.st_size;
+    void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+#endif
+
+    name_ = name;
+    owner_ = false;
+    base_ = (uint8_t*)base;
+    size_ = size;
+    header_ = (ShmRingHeader*)base_;
+
+    // 检查环头：写端还没初始化完或版本不一致时拒绝
+    bool valid = header_->magic == SHM_RING_MAGIC && header_->version == SHM_RING_VERSION
+        && header_->slot_count >= 2
+        && header_->header_bytes + header_->slot_bytes * header_->slot_count <= size_;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid) {
+        printf("shared memory %s is not a frame ring\n", path.c_str());
+        Close();
+        return -1;
+    }
+
+    return 0;
+};
+
+void ShmFrameRing::Close()
+{
+    if (!base_)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(base_);
+    CloseHandle((HANDLE)mapping_);
+    mapping_ = nullptr;
+#else
+    munmap(base_, size_);
+    if (owner_)
+        shm_unlink(PlatformName(name_).c_str());
+#endif
+
+    base_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+    owner_ = false;
+};
+
+ShmSlotHeader* ShmFrameRing::Slot(uint64_t index) const
+{
+    uint64_t slot = index % header_->slot_count;
+    return (ShmSlotHeader*)(base_ + header_->header_bytes + header_->slot_bytes * slot);
+};
+
+int ShmFrameRing::Write(const AVFrame* frame, AVRational time_base)
+{
+    if (!header_ || !owner_)
+        return -1;
+
+    // 1. 按 64 字节对齐的行距计算各平面在槽内的位置，放不下的帧跳过
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    int linesize[4] = {};
+    if (av_image_fill_linesizes(linesize, format, frame->width) < 0)
+        return -1;
+    for (int i = 0; i < 4; i++)
+        linesize[i] = SHM_ALIGN_UP(linesize[i]);
+
+    uint64_t index = header_->write_seq.load(std::memory_order_relaxed);
+    ShmSlotHeader* slot = Slot(index);
+    uint8_t* planes = (uint8_t*)slot + SHM_SLOT_HEADER_BYTES;
+    uint8_t* data[4] = {};
+    int bytes = av_image_fill_pointers(data, format, frame->height, planes, linesize);
+    if (bytes < 0 || (uint64_t)bytes > header_->slot_bytes - SHM_SLOT_HEADER_BYTES)
+        return -2;
+
+    // 2. 标记正在写，写完后发布
+    slot->seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    av_image_copy(data, linesize, (const uint8_t**)frame->data, frame->linesize,
+        format, frame->width, frame->height);
+
+    int nb_planes = 0;
+    for (int i = 0; i < 4 && data[i]; i++)
+        nb_planes++;
+    slot->pts = frame->pts;
+    slot->time_base_num = time_base.num;
+    slot->time_base_den = time_base.den;
+    slot->format = frame->format;
+    slot->width = frame->width;
+    slot->height = frame->height;
+    slot->nb_planes = nb_planes;
+    for (int i = 0; i < 4; i++) {
+        slot->linesize[i] = i < nb_planes ? linesize[i] : 0;
+        slot->plane_offset[i] = i < nb_planes ? (uint32_t)(data[i] - (uint8_t*)slot) : 0;
+        uint8_t* end = (i + 1 < nb_planes) ? data[i + 1] : planes + bytes;
+        slot->plane_bytes[i] = i < nb_planes ? (uint32_t)(end - data[i]) : 0;
+    }
+
+    slot->seq.store(2 * index + 2, std::memory_order_release);
+    header_->write_seq.store(index + 1, std::memory_order_release);
+
+    return 0;
+};
+
+void ShmFrameRing::MarkClosed()
+{
+    if (header_ && owner_)
+        header_->closed.store(1, std::memory_order_release);
+};
+
+uint64_t ShmFrameRing::WriteSeq() const
+{
+    return header_ ? header_->write_seq.load(std::memory_order_acquire) : 0;
+};
+
+bool ShmFrameRing::WriterClosed() const
+{
+    return !header_ || header_->closed.load(std::memory_order_acquire) != 0;
+};
+
+int ShmFrameRing::Acquire(uint64_t index, ShmFrameView* view) const
+{
+    if (!header_)
+        return -1;
+
+    const ShmSlotHeader* slot = Slot(index);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq < 2 * index + 2)
+        return -2;  // 还没写完
+    if (seq != 2 * index + 2)
+        return -1;  // 已被后面的帧覆盖
+
+    view->index = index;
+    view->pts = slot->pts;
+    view->time_base = AVRational{ slot->time_base_num, slot->time_base_den };
+    view->format = slot->format;
+    view->width = slot->width;
+    view->height = slot->height;
+    view->nb_planes = slot->nb_planes < 4 ? slot->nb_planes : 4;
+    for (int i = 0; i < 4; i++) {
+        bool used = i < view->nb_planes
+            && slot->plane_offset[i] + (uint64_t)slot->plane_bytes[i] <= header_->slot_bytes;
+        view->data[i] = used ? (const uint8_t*)slot + slot->plane_offset[i] : nullptr;
+        view->linesize[i] = used ? slot->linesize[i] : 0;
+    }
+
+    // 读元数据期间被覆盖的话视图不可用
+    return Validate(*view) ? 0 : -1;
+};
+
+bool ShmFrameRing::Validate(const ShmFrameView& view) const
+{
+    if (!header_)
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return Slot(view.index)->seq.load(std::memory_order_relaxed) == 2 * view.index + 2;
+};
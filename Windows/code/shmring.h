@@ -0,0 +1,160 @@
+﻿#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include "libavutil/frame.h"
+}
+
+/*
+ * 共享内存帧环：写端进程把视频帧写进固定数量、固定大小的槽，
+ * 其他进程映射同一块内存直接读取，不经过管道 / 套接字，读端不需要复制。
+ *
+ * 共享内存名：Windows 为 "Local\<名字>"（CreateFileMapping），其他平台为 "/<名字>"（shm_open）。
+ *
+ * 内存布局（所有偏移相对映射起点，小端，结构体按自然对齐）：
+ *
+ *   [ShmRingHeader]                        header_bytes 字节
+ *   [槽 0][槽 1]...[槽 slot_count-1]        每个槽 slot_bytes 字节，槽 i 起点 = header_bytes + i * slot_bytes
+ *
+ *   每个槽：[ShmSlotHeader][平面数据]，平面 p 起点 = 槽起点 + plane_offset[p]，行距 linesize[p]（64 字节对齐）
+ *
+ * 同步（无锁，序号即帧号）：
+ *   - 第 n 帧（从 0 开始）写在槽 n % slot_count
+ *   - 写槽前 seq = 2n+1（奇数表示正在写），写完 seq = 2n+2，然后 write_seq = n+1
+ *   - 读端：读 write_seq 得到最新帧号；读槽前后各读一次 seq，两次都等于 2n+2 才说明读到的是完整的第 n 帧
+ *     （处理期间被写端覆盖则丢弃结果）；落后超过 slot_count-1 帧时跳到最新帧
+ */
+
+#define SHM_RING_MAGIC 0x524D5246u  // "FRMR"
+#define SHM_RING_VERSION 1
+#define SHM_RING_ALIGN 64           // 槽头 / 平面 / 行距的对齐
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory ring needs lock-free 64-bit atomics");
+
+/**
+ * @brief 环头（映射起点）
+ */
+struct ShmRingHeader {
+    uint32_t magic;                     // SHM_RING_MAGIC
+    uint32_t version;                   // SHM_RING_VERSION
+    uint32_t slot_count;                // 槽数
+    uint32_t header_bytes;              // 环头大小（槽 0 的偏移）
+    uint64_t slot_bytes;                // 每个槽的大小（含槽头）
+    std::atomic<uint64_t> write_seq;    // 已写完的帧数（下一帧的帧号）
+    std::atomic<uint32_t> closed;       // 写端已退出
+    uint32_t reserved;
+};
+
+/**
+ * @brief 槽头（每个槽的起点）
+ */
+struct ShmSlotHeader {
+    std::atomic<uint64_t> seq;          // 2n+1：正在写第 n 帧；2n+2：第 n 帧已写完
+    int64_t pts;                        // 帧 pts（time_base 为单位，AV_NOPTS_VALUE 表示没有）
+    int32_t time_base_num;
+    int32_t time_base_den;
+    int32_t format;                     // AVPixelFormat
+    int32_t width;
+    int32_t height;
+    int32_t nb_planes;
+    int32_t linesize[4];                // 各平面行距（字节）
+    uint32_t plane_offset[4];           // 各平面相对槽起点的偏移
+    uint32_t plane_bytes[4];            // 各平面字节数
+};
+
+/**
+ * @brief 读端看到的一帧（指针直接指向共享内存，Validate 通过前结果都不可信）
+ */
+struct ShmFrameView {
+    uint64_t index = 0;                 // 帧号
+    int64_t pts = 0;
+    AVRational time_base = { 0, 1 };
+    int format = -1;
+    int width = 0;
+    int height = 0;
+    int nb_planes = 0;
+    const uint8_t* data[4] = {};
+    int linesize[4] = {};
+};
+
+/**
+ * @brief 共享内存帧环的映射（写端 Create / 读端 Open）
+ *
+ * 写端只应有一个线程调用 Write；读端可以有多个进程，互不影响，也不影响写端。
+ */
+class ShmFrameRing
+{
+public:
+    ShmFrameRing() {};
+    ~ShmFrameRing();
+
+    ShmFrameRing(const ShmFrameRing&) = delete;
+    ShmFrameRing& operator=(const ShmFrameRing&) = delete;
+
+    /**
+     * @brief 写端：创建共享内存并初始化环头
+     *
+     * 同名内存还在使用时返回失败，不会在其他写端或读端底下重新初始化：
+     * Windows 上同名映射只在还有进程打开时存在；POSIX 上同名内存会一直留到 shm_unlink，
+     * 只替换已退出的写端留下的（closed 已置位或没有 magic），异常退出的写端留下的需要手动删除
+     * @param name 共享内存名（不含平台前缀）
+     * @param slot_count 槽数（至少 2）
+     * @param max_frame_bytes 单帧平面数据的最大字节数，更大的帧 Write 时跳过
+     * @return 成功返回0，失败返回-1
+     */
+    int Create(const std::string& name, int slot_count, int64_t max_frame_bytes);
+
+    /**
+     * @brief 读端：只读映射已存在的共享内存并检查环头
+     * @return 成功返回0，不存在或格式不对返回-1
+     */
+    int Open(const std::string& name);
+
+    void Close();
+
+    /**
+     * @brief 写端：把一帧写进下一个槽（拷贝平面数据）
+     * @return 成功返回0，帧超过槽大小返回-2，未创建返回-1
+     */
+    int Write(const AVFrame* frame, AVRational time_base);
+
+    /**
+     * @brief 写端：标记写端已退出（读端据此停止等待）
+     */
+    void MarkClosed();
+
+    // ================ 读端 ================
+
+    uint64_t WriteSeq() const;          // 已写完的帧数
+    bool WriterClosed() const;          // 写端是否已退出
+    int SlotCount() const { return header_ ? (int)header_->slot_count : 0; }
+
+    /**
+     * @brief 取得第 index 帧的视图（指向共享内存，不复制）
+     * @return 成功返回0；该帧还没写完返回-2；已被覆盖返回-1（应跳到更新的帧）
+     */
+    int Acquire(uint64_t index, ShmFrameView* view) const;
+
+    /**
+     * @brief 用完视图后调用：帧在此期间没有被覆盖时返回 true
+     */
+    bool Validate(const ShmFrameView& view) const;
+
+private:
+    ShmSlotHeader* Slot(uint64_t index) const;
+
+    std::string name_;
+    bool owner_ = false;                // 写端（退出时删除共享内存名）
+    uint8_t* base_ = nullptr;           // 映射起点
+    size_t size_ = 0;                   // 映射大小
+    ShmRingHeader* header_ = nullptr;
+#ifdef _WIN32
+    void* mapping_ = nullptr;           // CreateFileMapping / OpenFileMapping 的句柄
+#endif
+};
+
+#endif // SHMRING_H
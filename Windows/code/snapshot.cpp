@@ -0,0 +1,298 @@
+﻿#include "snapshot.h"
+#include "threadutil.h"
+#include "tracing.h"
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/time.h"
+}
+
+// 截图线程积压（队列中 + 正在编码）达到该帧数时丢弃连拍的帧
+#define SNAPSHOT_MAX_QUEUED 4
+// 截图线程取队列的超时（毫秒）
+#define SNAPSHOT_POP_TIMEOUT 100
+
+SnapshotWriter::SnapshotWriter()
+{
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    captured_ = registry.GetCounter("snapshot.captured");
+    dropped_ = registry.GetCounter("snapshot.dropped");
+    failed_ = registry.GetCounter("snapshot.failed");
+    encode_time_ = registry.GetHistogram("snapshot.encode_us");
+
+    converted_ = av_frame_alloc();
+    // 截图线程常驻：在渲染线程上第一次截图时创建线程会造成卡顿
+    thread_ = new std::thread(&SnapshotWriter::Run, this);
+};
+
+SnapshotWriter::~SnapshotWriter()
+{
+    // 空帧表示退出：截图线程处理完之前的帧后结束
+    jobs_.Push(Job());
+    thread_->join();
+    delete thread_;
+    thread_ = nullptr;
+
+    for (AVFrame* frame : free_)
+        av_frame_free(&frame);
+    free_.clear();
+    av_frame_free(&converted_);
+};
+
+void SnapshotWriter::SetOptions(const SnapshotOptions& options)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+};
+
+void SnapshotWriter::SetRequestListener(std::function<void()> listener)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    request_listener_ = std::move(listener);
+};
+
+int64_t SnapshotWriter::RequestOne(SnapshotCallback done)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t id = next_id_++;
+    waiting_[id] = std::move(done);
+    pending_ = (int)waiting_.size();
+
+    // 暂停时渲染循环在睡眠，唤醒它用当前画面完成截图
+    // （持锁调用：渲染端析构时取消通知，之后不会再被调用）
+    if (request_listener_)
+        request_listener_();
+
+    return id;
+};
+
+void SnapshotWriter::SetBurst(int every_n, SnapshotCallback done)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        burst_done_ = std::move(done);
+    }
+    burst_every_ = every_n > 0 ? every_n : 0;
+};
+
+void SnapshotWriter::ServePending(const AVFrame* shown, AVRational time_base)
+{
+    if (pending_ == 0 || !shown->buf[0])
+        return;
+
+    std::vector<int64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& it : waiting_) {
+            ids.push_back(it.first);
+            done_[it.first] = std::move(it.second);
+        }
+        waiting_.clear();
+        pending_ = 0;
+    }
+
+    for (int64_t id : ids)
+        Submit(shown, time_base, id, false);
+};
+
+void SnapshotWriter::OnPresent(const AVFrame* shown, AVRational time_base)
+{
+    ServePending(shown, time_base);
+
+    int every = burst_every_;
+    if (every == 0) {
+        burst_count_ = 0;
+        return;
+    }
+    if (++burst_count_ < every)
+        return;
+    burst_count_ = 0;
+
+    if (queued_ >= SNAPSHOT_MAX_QUEUED) {
+        dropped_->Add(1);  // 截图线程跟不上：丢弃这一张，不等待
+        return;
+    }
+
+    int64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+    }
+    Submit(shown, time_base, id, true);
+};
+
+void SnapshotWriter::Submit(const AVFrame* shown, AVRational time_base, int64_t id, bool burst)
+{
+    Job job;
+    job.id = id;
+    job.pts = shown->pts == AV_NOPTS_VALUE ? 0.0 : shown->pts * av_q2d(time_base);
+    job.burst = burst;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            job.frame = free_.back();
+            free_.pop_back();
+        }
+    }
+    if (!job.frame)
+        job.frame = av_frame_alloc();
+
+    // 渲染线程上唯一的开销：缓冲区引用计数加一（帧属性随之复制）
+    if (!job.frame || av_frame_ref(job.frame, shown) < 0) {
+        av_frame_free(&job.frame);
+        failed_->Add(1);
+        return;
+    }
+
+    queued_++;
+    jobs_.Push(job);
+};
+
+void SnapshotWriter::Run()
+{
+    SetCurrentThreadName("snapshot");
+
+    while (true) {
+        Job job;
+        if (jobs_.Pop(job, SNAPSHOT_POP_TIMEOUT) < 0)
+            continue;
+        if (!job.frame)
+            break;  // 析构
+
+        SnapshotResult result;
+        result.id = job.id;
+        Encode(job, result);
+
+        SnapshotCallback done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            av_frame_unref(job.frame);
+            free_.push_back(job.frame);
+            if (job.burst) {
+                done = burst_done_;
+            }
+            else {
+                auto it = done_.find(job.id);
+                if (it != done_.end()) {
+                    done = std::move(it->second);
+                    done_.erase(it);
+                }
+            }
+        }
+        queued_--;
+
+        if (done)
+            done(result);
+    }
+};
+
+void SnapshotWriter::Encode(const Job& job, SnapshotResult& result)
+{
+    TraceScope trace("snapshot encode");
+    int64_t t0 = av_gettime_relative();
+
+    SnapshotOptions options;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options = options_;
+    }
+
+    // 文件名：snapshot_<本地时间>_<编号>.<扩展名>
+    char stamp[32] = "";
+    time_t now = time(nullptr);
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+
+    char name[96];
+    snprintf(name, sizeof(name), "snapshot_%s_%06lld.%s", stamp, (long long)job.id,
+        options.format == SnapshotFormat::Png ? "png" : "jpg");
+
+    result.path = options.dir.empty() ? name : options.dir + "/" + name;
+    result.width = job.frame->width;
+    result.height = job.frame->height;
+    result.pts = job.pts;
+    result.ret = WriteImage(job.frame, options, result.path);
+    result.encode_us = av_gettime_relative() - t0;
+
+    if (result.ret == 0) {
+        captured_->Add(1);
+        encode_time_->Record(result.encode_us);
+    }
+    else {
+        failed_->Add(1);
+    }
+};
+
+int SnapshotWriter::WriteImage(const AVFrame* frame, const SnapshotOptions& options, const std::string& path)
+{
+    bool png = options.format == SnapshotFormat::Png;
+    AVPixelFormat format = png ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_YUVJ420P;
+
+    // 1. 转换为编码器的输入格式
+    const AVFrame* image = frame;
+    if (frame->format != format) {
+        if (converter_.Convert(frame, converted_, format) < 0)
+            return -1;
+        image = converted_;
+    }
+
+    // 2. 编码（单帧，编码器上下文每张新建：与编码本身相比开销可以忽略）
+    const AVCodec* codec = avcodec_find_encoder(png ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        printf("snapshot: %s encoder not found\n", png ? "png" : "mjpeg");
+        return -1;
+    }
+
+    AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+    AVFrame* input = av_frame_clone(image);
+    AVPacket* packet = av_packet_alloc();
+    int ret = -1;
+    if (codec_ctx && input && packet) {
+        codec_ctx->width = image->width;
+        codec_ctx->height = image->height;
+        codec_ctx->pix_fmt = format;
+        codec_ctx->time_base = AVRational{ 1, 25 };
+        if (!png) {
+            codec_ctx->color_range = AVCOL_RANGE_JPEG;
+            codec_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+            codec_ctx->global_quality = FF_QP2LAMBDA * options.jpeg_quality;
+            input->quality = codec_ctx->global_quality;
+        }
+        input->pts = 0;
+
+        if (avcodec_open2(codec_ctx, codec, NULL) >= 0
+            && avcodec_send_frame(codec_ctx, input) >= 0
+            && avcodec_send_frame(codec_ctx, NULL) >= 0
+            && avcodec_receive_packet(codec_ctx, packet) >= 0) {
+            ret = 0;
+        }
+        else {
+            printf("snapshot: encode failed\n");
+        }
+    }
+
+    // 3. 写文件
+    if (ret == 0) {
+        FILE* fp = fopen(path.c_str(), "wb");
+        if (!fp || fwrite(packet->data, 1, packet->size, fp) != (size_t)packet->size) {
+            printf("snapshot: write %s failed\n", path.c_str());
+            ret = -1;
+        }
+        if (fp)
+            fclose(fp);
+    }
+
+    av_packet_free(&packet);
+    av_frame_free(&input);
+    avcodec_free_context(&codec_ctx);
+
+    return ret;
+};
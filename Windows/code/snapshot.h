@@ -0,0 +1,147 @@
+﻿#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "frameconvert.h"
+#include "metrics.h"
+#include "queue.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include "libavutil/frame.h"
+}
+
+/**
+ * @brief 截图编码格式
+ */
+enum class SnapshotFormat {
+    Png,
+    Jpeg
+};
+
+/**
+ * @brief 截图设置
+ */
+struct SnapshotOptions {
+    SnapshotFormat format = SnapshotFormat::Png;
+    std::string dir = ".";      // 输出目录（需已存在）
+    int jpeg_quality = 3;       // JPEG 量化参数，2~31，越小质量越高
+};
+
+/**
+ * @brief 一次截图的结果（在截图线程上回调）
+ */
+struct SnapshotResult {
+    int64_t id = 0;             // RequestOne 返回的编号；连拍的编号也从同一序列分配
+    int ret = 0;                // 0 成功，-1 失败
+    std::string path;           // 输出文件路径
+    double pts = 0.0;           // 帧 pts（秒）
+    int width = 0;
+    int height = 0;
+    int64_t encode_us = 0;      // 转换 + 编码 + 写文件耗时
+};
+
+using SnapshotCallback = std::function<void(const SnapshotResult&)>;
+
+/**
+ * @brief 截图：渲染线程只给正在显示的帧加一个引用，转换、编码和写文件都在截图线程上完成
+ *
+ * - RequestOne / SetBurst 可在任意线程调用，结果通过回调异步返回（回调在截图线程上执行，应尽快返回）
+ * - 渲染线程：每次显示后调用 OnPresent，暂停时也要响应单张截图则在醒来后调用 ServePending；
+ *   没有截图请求时只有一次原子读；有请求时从空闲链表取空壳 av_frame_ref，再放入截图队列
+ * - 截图线程积压超过上限时丢弃连拍的帧（计入 snapshot.dropped），不反压渲染
+ * - 截图为显示的帧：解码端缩小过的视频截到的是缩小后的分辨率
+ *
+ * 指标：snapshot.captured / snapshot.dropped / snapshot.failed、snapshot.encode_us（直方图）
+ */
+class SnapshotWriter
+{
+public:
+    SnapshotWriter();
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void SetOptions(const SnapshotOptions& options);
+
+    /**
+     * @brief 设置有新请求时的通知（渲染端用来唤醒暂停中的渲染循环），持锁调用，应尽快返回且不能再调用本对象
+     */
+    void SetRequestListener(std::function<void()> listener);
+
+    /**
+     * @brief 截取当前显示的帧
+     * @param done 完成回调（可为空）
+     * @return 截图编号
+     */
+    int64_t RequestOne(SnapshotCallback done);
+
+    /**
+     * @brief 连拍：每显示 every_n 帧截一张，0 表示停止
+     * @param done 每张完成时的回调（可为空）
+     */
+    void SetBurst(int every_n, SnapshotCallback done);
+
+    // ================ 渲染线程 ================
+
+    /**
+     * @brief 是否有等待中的单张截图（原子读）
+     */
+    bool Pending() const { return pending_ > 0; }
+
+    /**
+     * @brief 用正在显示的帧完成等待中的单张截图（shown 没有数据时继续等待）
+     * @param time_base 帧 pts 的时间基
+     */
+    void ServePending(const AVFrame* shown, AVRational time_base);
+
+    /**
+     * @brief 每次显示后调用：处理单张截图与连拍计数
+     */
+    void OnPresent(const AVFrame* shown, AVRational time_base);
+
+private:
+    struct Job {
+        AVFrame* frame = nullptr;   // 帧的新引用
+        int64_t id = 0;
+        double pts = 0.0;           // 帧 pts（秒）
+        bool burst = false;
+    };
+
+    void Submit(const AVFrame* shown, AVRational time_base, int64_t id, bool burst);
+    void Run();                                 // 截图线程
+    void Encode(const Job& job, SnapshotResult& result);
+    int WriteImage(const AVFrame* frame, const SnapshotOptions& options, const std::string& path);
+
+    std::thread* thread_ = nullptr;
+    Queue<Job> jobs_;                           // 待编码的帧
+    std::atomic<int> queued_{ 0 };              // 队列中 + 正在编码的帧数
+
+    std::mutex mutex_;                          // 保护以下成员
+    SnapshotOptions options_;
+    std::map<int64_t, SnapshotCallback> waiting_; // 已请求、还没取帧的单张截图
+    std::map<int64_t, SnapshotCallback> done_;    // 已取帧、等待编码完成的单张截图回调
+    SnapshotCallback burst_done_;
+    std::vector<AVFrame*> free_;                // 空壳 AVFrame
+    std::function<void()> request_listener_;
+    int64_t next_id_ = 1;
+
+    std::atomic<int> pending_{ 0 };             // waiting_ 的大小
+    std::atomic<int> burst_every_{ 0 };         // 连拍间隔（帧）
+    int burst_count_ = 0;                       // 连拍计数（渲染线程）
+
+    FrameConverter converter_;                  // 截图线程的像素格式转换
+    AVFrame* converted_ = nullptr;
+
+    MetricCounter* captured_ = nullptr;
+    MetricCounter* dropped_ = nullptr;
+    MetricCounter* failed_ = nullptr;
+    LatencyHistogram* encode_time_ = nullptr;
+};
+
+#endif // SNAPSHOT_H
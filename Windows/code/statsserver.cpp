@@ -0,0 +1,283 @@
+﻿#include "statsserver.h"
+#include "maincontroller.h"
+#include "threadutil.h"
+#include "tracing.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define CLOSE_SOCKET closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define INVALID_SOCKET (-1)
+#define CLOSE_SOCKET close
+#endif
+
+#define STATS_PUBLISH_INTERVAL 1000 // 快照发布间隔（毫秒）
+#define STATS_SELECT_TIMEOUT 200    // 监听线程检查退出标志的间隔（毫秒）
+#define STATS_RECV_TIMEOUT 1000     // 读取请求的超时（毫秒）
+
+StatsServer::StatsServer(MainController* controller)
+    : controller_(controller),
+    listen_socket_((socket_t)INVALID_SOCKET)
+{};
+
+StatsServer::~StatsServer()
+{
+    Stop();
+};
+
+int StatsServer::Start(int port)
+{
+    if (started_)
+        return 0;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("StatsServer: WSAStartup failed\n");
+        return -1;
+    }
+#endif
+
+    listen_socket_ = (socket_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket_ == (socket_t)INVALID_SOCKET) {
+        printf("StatsServer: socket failed\n");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    // 只绑定回环地址，不对外暴露
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+
+    if (bind(listen_socket_, (sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(listen_socket_, 4) != 0) {
+        printf("StatsServer: bind 127.0.0.1:%d failed\n", port);
+        CLOSE_SOCKET(listen_socket_);
+        listen_socket_ = (socket_t)INVALID_SOCKET;
+        return -1;
+    }
+
+    // 先发布一次，保证启动后立即有内容可读
+    last_time_ = std::chrono::steady_clock::now();
+    std::atomic_store(&snapshot_, std::shared_ptr<const std::string>(new std::string(Collect())));
+
+    abort_ = false;
+    publish_thread_ = std::thread(&StatsServer::PublishLoop, this);
+    listen_thread_ = std::thread(&StatsServer::ListenLoop, this);
+    started_ = true;
+
+    printf("stats: http://127.0.0.1:%d/metrics\n", port);
+
+    return 0;
+};
+
+void StatsServer::Stop()
+{
+    if (!started_)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lk(abort_mtx_);
+        abort_ = true;
+    }
+    abort_cv_.notify_all();
+
+    if (publish_thread_.joinable())
+        publish_thread_.join();
+    if (listen_thread_.joinable())
+        listen_thread_.join();
+
+    CLOSE_SOCKET(listen_socket_);
+    listen_socket_ = (socket_t)INVALID_SOCKET;
+    started_ = false;
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+};
+
+void StatsServer::PublishLoop()
+{
+    SetCurrentThreadName("stats publish");
+
+    std::unique_lock<std::mutex> lk(abort_mtx_);
+    while (!abort_) {
+        abort_cv_.wait_for(lk, std::chrono::milliseconds(STATS_PUBLISH_INTERVAL));
+        if (abort_)
+            break;
+
+        lk.unlock();
+        std::atomic_store(&snapshot_, std::shared_ptr<const std::string>(new std::string(Collect())));
+        lk.lock();
+    }
+};
+
+void StatsServer::ListenLoop()
+{
+    SetCurrentThreadName("stats listen");
+
+    while (!abort_) {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(listen_socket_, &set);
+        timeval tv = { 0, STATS_SELECT_TIMEOUT * 1000 };
+
+        if (select((int)listen_socket_ + 1, &set, NULL, NULL, &tv) <= 0)
+            continue;
+
+        socket_t client = (socket_t)accept(listen_socket_, NULL, NULL);
+        if (client == (socket_t)INVALID_SOCKET)
+            continue;
+
+        HandleClient(client);
+        CLOSE_SOCKET(client);
+    }
+};
+
+void StatsServer::HandleClient(socket_t client)
+{
+    // 读请求行（只关心路径，其余头部忽略）
+#ifdef _WIN32
+    DWORD timeout = STATS_RECV_TIMEOUT;
+#else
+    timeval timeout = { STATS_RECV_TIMEOUT / 1000, (STATS_RECV_TIMEOUT % 1000) * 1000 };
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    char request[1024];
+    int n = recv(client, request, sizeof(request) - 1, 0);
+    if (n <= 0)
+        return;
+    request[n] = '\0';
+
+    std::string response;
+    if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        std::shared_ptr<const std::string> body = std::atomic_load(&snapshot_);
+        char header[160];
+        snprintf(header, sizeof(header),
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", body->size());
+        response = header + *body;
+    }
+    else {
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        int ret = send(client, response.data() + sent, (int)(response.size() - sent), 0);
+        if (ret <= 0)
+            break;
+        sent += ret;
+    }
+};
+
+/**
+ * @brief 追加一行 Prometheus 指标（带 TYPE 注释）
+ */
+static void AppendMetric(std::string& out, const std::string& name, const char* type,
+    const char* labels, double value)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "# TYPE %s %s\n%s%s %.15g\n",
+        name.c_str(), type, name.c_str(), labels, value);
+    out += line;
+};
+
+std::string StatsServer::Collect()
+{
+    std::string out;
+
+    // 1. 指标注册表：队列长度 / 字节、丢帧、欠载、解码耗时、音视频偏差、分配次数
+    for (const MetricValue& metric : controller_->GetStats()) {
+        std::string name = "player_" + metric.name;
+        for (char& c : name) {
+            if (c == '.')
+                c = '_';
+        }
+        AppendMetric(out, name, metric.counter ? "counter" : "gauge", "", (double)metric.value);
+    }
+
+    // 2. 解码帧率（两次发布之间的增量；切换文件时计数归零，按 0 处理）
+    PipelineStats stats = controller_->GetPipelineStats();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_time_).count();
+    double audio_fps = 0.0, video_fps = 0.0;
+    if (elapsed > 0) {
+        if (stats.audio_frames_decoded >= last_audio_frames_)
+            audio_fps = (stats.audio_frames_decoded - last_audio_frames_) / elapsed;
+        if (stats.video_frames_decoded >= last_video_frames_)
+            video_fps = (stats.video_frames_decoded - last_video_frames_) / elapsed;
+    }
+    last_audio_frames_ = stats.audio_frames_decoded;
+    last_video_frames_ = stats.video_frames_decoded;
+    last_time_ = now;
+
+    out += "# TYPE player_decode_fps gauge\n";
+    char line[160];
+    snprintf(line, sizeof(line), "player_decode_fps{stream=\"audio\"} %.3f\n", audio_fps);
+    out += line;
+    snprintf(line, sizeof(line), "player_decode_fps{stream=\"video\"} %.3f\n", video_fps);
+    out += line;
+
+    // 3. 各线程 CPU 时间、上下文切换与等待（按线程名汇总，进程启动以来）
+    std::vector<ThreadUsage> threads = SampleThreadUsage();
+    struct ThreadColumn {
+        const char* name;
+        const char* type;
+        const char* extra_label;
+        double(*value)(const ThreadUsage&);
+    };
+    static const ThreadColumn columns[] = {
+        { "player_thread_cpu_seconds_total", "counter", "",
+            [](const ThreadUsage& t) { return t.cpu_us / 1e6; } },
+        { "player_thread_context_switches_total", "counter", ",kind=\"voluntary\"",
+            [](const ThreadUsage& t) { return (double)t.voluntary_switches; } },
+        { "player_thread_context_switches_total", nullptr, ",kind=\"involuntary\"",
+            [](const ThreadUsage& t) { return (double)t.involuntary_switches; } },
+        { "player_thread_queue_wait_seconds_total", "counter", "",
+            [](const ThreadUsage& t) { return t.queue_wait_us / 1e6; } },
+        { "player_thread_poll_sleeps_total", "counter", "",
+            [](const ThreadUsage& t) { return (double)t.sleeps; } },
+        { "player_thread_alive", "gauge", "",
+            [](const ThreadUsage& t) { return (double)t.threads; } },
+    };
+    for (const ThreadColumn& column : columns) {
+        if (column.type) {
+            snprintf(line, sizeof(line), "# TYPE %s %s\n", column.name, column.type);
+            out += line;
+        }
+        for (const ThreadUsage& t : threads) {
+            std::string label = t.name;
+            for (char& c : label) {
+                if (c == ' ')
+                    c = '_';
+            }
+            snprintf(line, sizeof(line), "%s{thread=\"%s\"%s} %.15g\n",
+                column.name, label.c_str(), column.extra_label, column.value(t));
+            out += line;
+        }
+    }
+
+    // 4. 进程内存与播放状态
+    AppendMetric(out, "player_rss_bytes", "gauge", "", (double)ProcessRssBytes());
+    AppendMetric(out, "player_playing", "gauge", "", controller_->isStarted() ? 1.0 : 0.0);
+
+    return out;
+};
@@ -0,0 +1,74 @@
+﻿#ifndef STATSSERVER_H
+#define STATSSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class MainController;
+
+#ifdef _WIN32
+typedef uintptr_t socket_t;
+#else
+typedef int socket_t;
+#endif
+
+/**
+ * @brief 本地统计接口：在 127.0.0.1:<port>/metrics 以 Prometheus 文本格式输出播放器指标
+ *
+ * 两个线程：
+ *   - 发布线程每秒从 MainController 收集一次（GetStats / GetPipelineStats / SampleThreadUsage / 进程内存），
+ *     格式化后整体替换快照（原子交换 shared_ptr）
+ *   - 监听线程只读取已发布的快照回复请求，不接触播放流水线
+ *
+ * 输出内容：metrics.h 中的全部指标（名字加 player_ 前缀，点号换成下划线）、
+ * 各流解码帧率、各线程 CPU 时间 / 上下文切换 / 队列等待时间 / 轮询休眠次数、进程常驻内存。
+ */
+class StatsServer
+{
+public:
+    explicit StatsServer(MainController* controller);
+    ~StatsServer();
+
+    /**
+     * @brief 绑定 127.0.0.1:port 并启动发布 / 监听线程
+     * @return 成功返回0，失败返回-1
+     */
+    int Start(int port);
+
+    /**
+     * @brief 停止线程并关闭监听端口（析构时自动调用）
+     */
+    void Stop();
+
+private:
+    void PublishLoop();                 // 发布线程主循环
+    void ListenLoop();                  // 监听线程主循环
+    void HandleClient(socket_t client); // 回复一个 HTTP 请求
+    std::string Collect();              // 收集并格式化一次快照
+
+private:
+    MainController* controller_ = nullptr;
+    socket_t listen_socket_;            // 监听套接字
+    bool started_ = false;
+
+    std::thread publish_thread_;
+    std::thread listen_thread_;
+    std::atomic<bool> abort_{ false };
+    std::mutex abort_mtx_;              // 配合 abort_cv_ 让发布线程及时退出
+    std::condition_variable abort_cv_;
+
+    std::shared_ptr<const std::string> snapshot_; // 已发布的快照（std::atomic_load / atomic_store 访问）
+
+    // 发布线程私有：计算解码帧率
+    int64_t last_audio_frames_ = 0;
+    int64_t last_video_frames_ = 0;
+    std::chrono::steady_clock::time_point last_time_;
+};
+
+#endif // STATSSERVER_H
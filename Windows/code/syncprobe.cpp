@@ -0,0 +1,140 @@
+﻿#include "syncprobe.h"
+#include "synthmedia.h"
+#include <algorithm>
+#include <cmath>
+
+// 判定为蜂鸣的幅度（满幅的 10%）
+#define BEEP_THRESHOLD 0.1f
+// 蜂鸣前至少需要的静音时长（秒），避免把同一个蜂鸣的后续波峰当成新的开始
+#define BEEP_MIN_QUIET 0.01
+
+SyncProbe& SyncProbe::Instance()
+{
+    static SyncProbe instance;
+    return instance;
+};
+
+void SyncProbe::Start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flashes_.clear();
+    beeps_.clear();
+    last_flash_ = false;
+    quiet_ = BEEP_MIN_QUIET;
+    enabled_ = true;
+};
+
+void SyncProbe::Stop()
+{
+    enabled_ = false;
+};
+
+void SyncProbe::OnVideoPresent(const AVFrame* frame, double now)
+{
+    if (!Enabled())
+        return;
+
+    bool flash = IsSyncFlash(frame);
+    if (flash && !last_flash_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flashes_.push_back(now);
+    }
+    last_flash_ = flash;
+};
+
+void SyncProbe::AudioSample(float value, double time, double sample_period)
+{
+    if (fabsf(value) < BEEP_THRESHOLD) {
+        quiet_ += sample_period;
+        return;
+    }
+
+    if (quiet_ >= BEEP_MIN_QUIET) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        beeps_.push_back(time);
+    }
+    quiet_ = 0.0;
+};
+
+void SyncProbe::OnAudioS16(const int16_t* pcm, int samples, int channels, double start_time,
+    double sample_period)
+{
+    if (!Enabled())
+        return;
+
+    for (int i = 0; i < samples; i++)
+        AudioSample(pcm[i * channels] / 32768.0f, start_time + i * sample_period, sample_period);
+};
+
+void SyncProbe::OnAudioFrame(const AVFrame* frame, double start_time, double sample_period)
+{
+    if (!Enabled())
+        return;
+
+    int channels = frame->ch_layout.nb_channels;
+    for (int i = 0; i < frame->nb_samples; i++) {
+        float value = 0.0f;
+        switch (frame->format) {
+        case AV_SAMPLE_FMT_S16:  value = ((const int16_t*)frame->data[0])[i * channels] / 32768.0f; break;
+        case AV_SAMPLE_FMT_S16P: value = ((const int16_t*)frame->data[0])[i] / 32768.0f; break;
+        case AV_SAMPLE_FMT_FLT:  value = ((const float*)frame->data[0])[i * channels]; break;
+        case AV_SAMPLE_FMT_FLTP: value = ((const float*)frame->data[0])[i]; break;
+        default: return;
+        }
+        AudioSample(value, start_time + i * sample_period, sample_period);
+    }
+};
+
+SyncReport SyncProbe::Report(double max_offset)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    SyncReport report;
+    report.flashes = (int)flashes_.size();
+    report.beeps = (int)beeps_.size();
+
+    // 每个闪白配对时间最近的蜂鸣（两个列表都按时间递增）
+    std::vector<double> times, offsets;
+    size_t j = 0;
+    for (double flash : flashes_) {
+        while (j + 1 < beeps_.size() && fabs(beeps_[j + 1] - flash) <= fabs(beeps_[j] - flash))
+            j++;
+        if (j < beeps_.size() && fabs(beeps_[j] - flash) <= max_offset) {
+            times.push_back(flash);
+            offsets.push_back(beeps_[j] - flash);
+        }
+    }
+
+    report.matched = (int)offsets.size();
+    if (offsets.empty())
+        return report;
+
+    double sum = 0.0;
+    std::vector<double> abs_offsets;
+    for (double offset : offsets) {
+        sum += offset;
+        abs_offsets.push_back(fabs(offset));
+    }
+    std::sort(abs_offsets.begin(), abs_offsets.end());
+    report.mean_ms = sum / offsets.size() * 1000.0;
+    report.p95_ms = abs_offsets[(abs_offsets.size() - 1) * 95 / 100] * 1000.0;
+    report.max_ms = abs_offsets.back() * 1000.0;
+
+    // 最小二乘拟合 偏差 = a + b * 时间
+    if (offsets.size() >= 2) {
+        double mean_t = 0.0, mean_o = sum / offsets.size();
+        for (double t : times)
+            mean_t += t;
+        mean_t /= times.size();
+
+        double num = 0.0, den = 0.0;
+        for (size_t i = 0; i < times.size(); i++) {
+            num += (times[i] - mean_t) * (offsets[i] - mean_o);
+            den += (times[i] - mean_t) * (times[i] - mean_t);
+        }
+        if (den > 0)
+            report.drift_ms_per_min = num / den * 1000.0 * 60.0;
+    }
+
+    return report;
+};
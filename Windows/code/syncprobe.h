@@ -0,0 +1,90 @@
+﻿#ifndef SYNCPROBE_H
+#define SYNCPROBE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include "libavutil/frame.h"
+}
+
+/**
+ * @brief 一次同步精度测试的结果（毫秒；偏差为正表示声音晚于画面）
+ */
+struct SyncReport {
+    int flashes = 0;                // 检测到的闪白帧数
+    int beeps = 0;                  // 检测到的蜂鸣数
+    int matched = 0;                // 配对成功的标记数
+    double mean_ms = 0.0;           // 平均偏差（带符号）
+    double p95_ms = 0.0;            // 绝对偏差 p95
+    double max_ms = 0.0;            // 绝对偏差最大值
+    double drift_ms_per_min = 0.0;  // 偏差随播放时间的变化（线性拟合斜率，毫秒 / 分钟）
+};
+
+/**
+ * @brief 音视频同步精度探针（进程内唯一，默认关闭）
+ *
+ * 配合带同步标记的合成片段（synth:...,marks=N，见 synthmedia.h）使用：
+ *   - 视频输出端显示一帧后调用 OnVideoPresent：中央方块由黑变白时记录显示时刻
+ *   - 音频输出端把 PCM 交给设备时调用 OnAudio*：静音后出现蜂鸣时记录该样本的播放时刻
+ * 时刻取自 AVSync::SourceNowSec（系统时间或虚拟时钟），两端使用同一时间源。
+ * Report 按时间最近的原则把闪白和蜂鸣配对，得到每个标记的音视频偏差。
+ *
+ * 关闭时各回调只有一次原子读。
+ */
+class SyncProbe
+{
+public:
+    static SyncProbe& Instance();
+
+    void Start();   // 清空记录并开始检测
+    void Stop();    // 停止检测（记录保留到下次 Start）
+    bool Enabled() const { return enabled_.load(std::memory_order_relaxed); };
+
+    /**
+     * @brief 视频帧显示完成后调用
+     * @param now 显示完成的时刻（秒）
+     */
+    void OnVideoPresent(const AVFrame* frame, double now);
+
+    /**
+     * @brief 交错 S16 PCM 交给设备时调用（SDL 音频回调）
+     * @param start_time 第一个样本的播放时刻（秒）
+     * @param sample_period 相邻样本的播放间隔（秒）
+     */
+    void OnAudioS16(const int16_t* pcm, int samples, int channels, double start_time, double sample_period);
+
+    /**
+     * @brief 解码后的音频帧开始“播放”时调用（空输出端）
+     * 支持 S16 / S16P / FLT / FLTP，只检测第一个声道
+     */
+    void OnAudioFrame(const AVFrame* frame, double start_time, double sample_period);
+
+    /**
+     * @brief 配对并统计
+     * @param max_offset 配对允许的最大偏差（秒），应小于标记间隔的一半
+     */
+    SyncReport Report(double max_offset);
+
+private:
+    SyncProbe() {};
+
+    /**
+     * @brief 检测一个样本（只在音频线程调用）
+     */
+    void AudioSample(float value, double time, double sample_period);
+
+    std::atomic<bool> enabled_{ false };
+
+    // 只在各自输出线程访问的检测状态
+    bool last_flash_ = false;           // 上一帧方块是否为白
+    double quiet_ = 0.0;                // 连续静音时长（秒）
+
+    std::mutex mutex_;                  // 保护下面两个列表
+    std::vector<double> flashes_;       // 闪白显示时刻
+    std::vector<double> beeps_;         // 蜂鸣开始播放时刻
+};
+
+#endif // SYNCPROBE_H
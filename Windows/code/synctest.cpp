@@ -0,0 +1,64 @@
+﻿#include "synctest.h"
+#include "maincontroller.h"
+#include "synthmedia.h"
+#include "syncprobe.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// 测试片段：PCM 音频避免编码器延迟影响测量，标记间隔 1 秒
+#define SYNC_TEST_INPUT "synth:size=640x360,rate=30,dur=20,marks=1,acodec=pcm_s16le"
+#define SYNC_TEST_MARK_INTERVAL 1.0
+
+int RunSyncAccuracyTest(SinkType type, const std::vector<float>& speeds)
+{
+    if (type == SinkType::NullFast)
+        type = SinkType::NullPaced;
+
+    const char* mode = "sdl";
+    if (type == SinkType::NullPaced)
+        mode = "paced";
+    else if (type == SinkType::NullVirtual)
+        mode = "virtual";
+
+    std::string url, format_name;
+    if (ResolveMediaInput(SYNC_TEST_INPUT, url, format_name) < 0)
+        return -1;
+
+    MainController controller;
+    controller.setSinkType(type);
+
+    printf("sync test: %s (%s), offset > 0 means audio late\n", SYNC_TEST_INPUT, mode);
+    printf("%6s %8s %6s %8s %9s %8s %8s %13s\n",
+        "speed", "flashes", "beeps", "matched", "mean ms", "p95 ms", "max ms", "drift ms/min");
+
+    int ret = 0;
+    for (float speed : speeds) {
+        controller.setUrl(url.c_str(), format_name.c_str());
+        controller.setSpeed(speed);
+
+        SyncProbe::Instance().Start();
+        controller.start();
+        while (controller.isStarted() && !controller.isFinished())
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        bool played = controller.isStarted();
+        controller.stop();
+        SyncProbe::Instance().Stop();
+
+        if (!played) {
+            printf("sync test: failed to play %s\n", url.c_str());
+            ret = -1;
+            break;
+        }
+
+        // 标记在墙上时间中的间隔为 间隔 / 倍速，配对容差取其 40%
+        SyncReport report = SyncProbe::Instance().Report(0.4 * SYNC_TEST_MARK_INTERVAL / speed);
+        printf("%6.2f %8d %6d %8d %9.2f %8.2f %8.2f %13.3f\n",
+            speed, report.flashes, report.beeps, report.matched,
+            report.mean_ms, report.p95_ms, report.max_ms, report.drift_ms_per_min);
+    }
+
+    return ret;
+};
@@ -0,0 +1,25 @@
+﻿#ifndef SYNCTEST_H
+#define SYNCTEST_H
+
+#include "outputsink.h"
+#include <vector>
+
+/**
+ * @brief 音视频同步精度测试（--sync-test）
+ *
+ * 生成带同步标记的合成片段（每秒一次闪白 + 蜂鸣，见 synthmedia.h），按每个倍速完整播放一遍，
+ * 用 SyncProbe 记录闪白实际显示、蜂鸣实际播放的时刻，输出每个倍速下
+ * 偏差的均值、p95、最大值以及随播放时间的漂移（毫秒 / 分钟）。偏差为正表示声音晚于画面。
+ *
+ * - SinkType::Sdl       ：真实窗口和声卡；播放时刻按回调时刻 + 设备缓冲区时长估算，不含显示器延迟
+ * - SinkType::NullPaced ：空输出端实时播放，测量同步逻辑本身
+ * - SinkType::NullVirtual：同上，使用虚拟时钟，结果可复现且远快于实时
+ * （NullFast 不按时间播放，按 NullPaced 处理）
+ *
+ * @param type   输出端类型
+ * @param speeds 要测试的倍速列表
+ * @return 成功返回0，失败返回-1
+ */
+int RunSyncAccuracyTest(SinkType type, const std::vector<float>& speeds);
+
+#endif // SYNCTEST_H
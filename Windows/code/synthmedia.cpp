@@ -0,0 +1,528 @@
+﻿#include "synthmedia.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavdevice/avdevice.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/error.h>
+#include <libavutil/opt.h>
+#include <libavutil/parseutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/random_seed.h>
+}
+
+// 帧序号条码位数（每位一个方块，画在第一行方块里）
+#define COUNTER_BITS 32
+
+// ============================================================================
+//                                参数解析
+// ============================================================================
+
+int ParseSyntheticSpec(const char* text, SyntheticSpec& spec)
+{
+    std::string rest = text ? text : "";
+    size_t pos = 0;
+    while (pos <= rest.size()) {
+        size_t end = rest.find(',', pos);
+        if (end == std::string::npos)
+            end = rest.size();
+        std::string item = rest.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty())
+            continue;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            printf("synth: bad option '%s'\n", item.c_str());
+            return -1;
+        }
+        std::string key = item.substr(0, eq);
+        std::string value = item.substr(eq + 1);
+
+        if (key == "size") {
+            if (sscanf(value.c_str(), "%dx%d", &spec.width, &spec.height) != 2)
+                spec.width = 0;
+        }
+        else if (key == "rate") {
+            if (av_parse_ratio(&spec.frame_rate, value.c_str(), 1000000, 0, nullptr) < 0)
+                spec.frame_rate = AVRational{ 0, 1 };
+        }
+        else if (key == "vcodec")
+            spec.video_codec = value;
+        else if (key == "acodec")
+            spec.audio_codec = value;
+        else if (key == "gop")
+            spec.gop = atoi(value.c_str());
+        else if (key == "bf")
+            spec.b_frames = atoi(value.c_str());
+        else if (key == "ar")
+            spec.sample_rate = atoi(value.c_str());
+        else if (key == "ac")
+            spec.channels = atoi(value.c_str());
+        else if (key == "layout")
+            spec.channel_layout = value;
+        else if (key == "dur")
+            spec.duration = atof(value.c_str());
+        else if (key == "marks")
+            spec.marks = atof(value.c_str());
+        else {
+            printf("synth: unknown option '%s'\n", key.c_str());
+            return -1;
+        }
+    }
+
+    // 条码至少需要每位 2 个像素宽
+    if (spec.width < COUNTER_BITS * 2 || spec.height < 16 || spec.frame_rate.num <= 0 ||
+        spec.gop < 1 || spec.b_frames < 0 || spec.sample_rate <= 0 || spec.channels <= 0 ||
+        spec.duration <= 0 || spec.marks < 0) {
+        printf("synth: invalid parameters\n");
+        return -1;
+    }
+
+    return 0;
+};
+
+// ============================================================================
+//                                帧序号条码
+// ============================================================================
+
+/**
+ * 条码方块边长：占满一半宽度，方块越大越能经受有损编码
+ */
+static int CounterBlockSize(int width)
+{
+    return width / (COUNTER_BITS * 2);
+};
+
+static bool IsPlanar8BitYuv(int format)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((enum AVPixelFormat)format);
+    return desc && !(desc->flags & AV_PIX_FMT_FLAG_RGB) && (desc->flags & AV_PIX_FMT_FLAG_PLANAR) &&
+        desc->comp[0].depth == 8;
+};
+
+void DrawFrameCounter(AVFrame* frame, uint32_t index)
+{
+    int block = CounterBlockSize(frame->width);
+    if (block < 2 || frame->height < block || !IsPlanar8BitYuv(frame->format))
+        return;
+
+    for (int bit = 0; bit < COUNTER_BITS; bit++) {
+        // 高位在左；1 为白（235），0 为黑（16）
+        uint8_t value = (index >> (COUNTER_BITS - 1 - bit)) & 1 ? 235 : 16;
+        for (int y = 0; y < block; y++)
+            memset(frame->data[0] + y * frame->linesize[0] + bit * block, value, block);
+    }
+};
+
+int64_t ReadFrameCounter(const AVFrame* frame)
+{
+    int block = CounterBlockSize(frame->width);
+    if (block < 2 || frame->height < block || !IsPlanar8BitYuv(frame->format))
+        return -1;
+
+    // 读每个方块中心的亮度
+    uint32_t index = 0;
+    const uint8_t* row = frame->data[0] + (block / 2) * frame->linesize[0];
+    for (int bit = 0; bit < COUNTER_BITS; bit++)
+        index = (index << 1) | (row[bit * block + block / 2] >= 128 ? 1 : 0);
+
+    return index;
+};
+
+/**
+ * 同步标记方块：画面中央，边长为高度的 1/4（按色度子采样对齐）
+ */
+static void SyncFlashBox(const AVFrame* frame, int& x, int& y, int& size)
+{
+    size = (frame->height / 4) & ~3;
+    x = ((frame->width - size) / 2) & ~3;
+    y = ((frame->height - size) / 2) & ~3;
+};
+
+void DrawSyncFlash(AVFrame* frame, bool on)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    if (!IsPlanar8BitYuv(frame->format))
+        return;
+
+    int x, y, size;
+    SyncFlashBox(frame, x, y, size);
+
+    for (int plane = 0; plane < 3; plane++) {
+        int shift_w = plane ? desc->log2_chroma_w : 0;
+        int shift_h = plane ? desc->log2_chroma_h : 0;
+        // 亮度 235 / 16，色度取中性值（白 / 黑）
+        uint8_t value = plane ? 128 : (on ? 235 : 16);
+        for (int row = y >> shift_h; row < (y + size) >> shift_h; row++)
+            memset(frame->data[plane] + row * frame->linesize[plane] + (x >> shift_w), value, size >> shift_w);
+    }
+};
+
+bool IsSyncFlash(const AVFrame* frame)
+{
+    if (!IsPlanar8BitYuv(frame->format))
+        return false;
+
+    int x, y, size;
+    SyncFlashBox(frame, x, y, size);
+    if (size <= 0)
+        return false;
+
+    return frame->data[0][(y + size / 2) * frame->linesize[0] + x + size / 2] >= 128;
+};
+
+// ============================================================================
+//                                片段生成
+// ============================================================================
+
+namespace {
+
+/**
+ * 一路源：滤镜图（testsrc2 / sine）→ 编码器 → 输出流
+ */
+struct SynthStream {
+    AVFilterGraph* graph = nullptr;
+    AVFilterContext* sink = nullptr;
+    AVCodecContext* enc = nullptr;
+    AVStream* stream = nullptr;
+    AVFrame* frame = nullptr;
+    int64_t next_pts = 0;       // 下一帧 pts（编码器时间基），用于交错写入
+    int64_t frames = 0;         // 已送入编码器的帧数
+    double marks = 0.0;         // 同步标记间隔（秒，仅视频使用）
+    double frame_rate = 0.0;    // 帧率（仅视频使用）
+    bool finished = false;      // 编码器已冲刷完
+
+    ~SynthStream()
+    {
+        avfilter_graph_free(&graph);
+        avcodec_free_context(&enc);
+        av_frame_free(&frame);
+    };
+};
+
+/**
+ * 按描述创建只有输出端的源滤镜图，sink 为 buffersink / abuffersink
+ */
+int OpenSourceGraph(SynthStream& s, const char* desc, bool audio)
+{
+    s.graph = avfilter_graph_alloc();
+    if (!s.graph)
+        return -1;
+
+    const AVFilter* buffersink = avfilter_get_by_name(audio ? "abuffersink" : "buffersink");
+    if (avfilter_graph_create_filter(&s.sink, buffersink, "out", nullptr, nullptr, s.graph) < 0)
+        return -1;
+
+    // 滤镜图描述的最后一个输出连到 sink
+    AVFilterInOut* inputs = avfilter_inout_alloc();
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = s.sink;
+    inputs->pad_idx = 0;
+    inputs->next = nullptr;
+
+    AVFilterInOut* outputs = nullptr;
+    int ret = avfilter_graph_parse_ptr(s.graph, desc, &inputs, &outputs, nullptr);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret < 0)
+        return ret;
+
+    return avfilter_graph_config(s.graph, nullptr);
+};
+
+/**
+ * 创建编码器和输出流
+ */
+int OpenEncoder(SynthStream& s, AVFormatContext* oc, const char* codec_name)
+{
+    const AVCodec* codec = avcodec_find_encoder_by_name(codec_name);
+    if (!codec) {
+        printf("synth: encoder %s not found\n", codec_name);
+        return -1;
+    }
+
+    s.enc = avcodec_alloc_context3(codec);
+    s.stream = avformat_new_stream(oc, nullptr);
+    s.frame = av_frame_alloc();
+    if (!s.enc || !s.stream || !s.frame)
+        return -1;
+
+    return 0;
+};
+
+int FinishEncoder(SynthStream& s, AVFormatContext* oc)
+{
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        s.enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    int ret = avcodec_open2(s.enc, s.enc->codec, nullptr);
+    if (ret < 0)
+        return ret;
+
+    s.stream->time_base = s.enc->time_base;
+    return avcodec_parameters_from_context(s.stream->codecpar, s.enc);
+};
+
+/**
+ * 从编码器取出所有可用的包并写入文件
+ */
+int WritePackets(SynthStream& s, AVFormatContext* oc, AVPacket* pkt)
+{
+    while (true) {
+        int ret = avcodec_receive_packet(s.enc, pkt);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF) {
+            s.finished = true;
+            return 0;
+        }
+        if (ret < 0)
+            return ret;
+
+        av_packet_rescale_ts(pkt, s.enc->time_base, s.stream->time_base);
+        pkt->stream_index = s.stream->index;
+        ret = av_interleaved_write_frame(oc, pkt);
+        if (ret < 0)
+            return ret;
+    }
+};
+
+/**
+ * 从滤镜图取一帧送入编码器；滤镜图结束时冲刷编码器
+ */
+int EncodeNext(SynthStream& s, AVFormatContext* oc, AVPacket* pkt, bool video)
+{
+    int ret = av_buffersink_get_frame(s.sink, s.frame);
+    if (ret == AVERROR_EOF) {
+        ret = avcodec_send_frame(s.enc, nullptr);
+        if (ret < 0 && ret != AVERROR_EOF)
+            return ret;
+        return WritePackets(s, oc, pkt);
+    }
+    if (ret < 0)
+        return ret;
+
+    s.frame->pts = av_rescale_q(s.frame->pts, av_buffersink_get_time_base(s.sink), s.enc->time_base);
+    s.frame->pict_type = AV_PICTURE_TYPE_NONE;
+    if (video) {
+        ret = av_frame_make_writable(s.frame);
+        if (ret < 0)
+            return ret;
+        DrawFrameCounter(s.frame, (uint32_t)s.frames);
+        if (s.marks > 0) {
+            // 第 k 个标记（k >= 1）时刻所在的帧闪白，其余帧方块为黑色
+            int64_t k = llround(s.frames / s.frame_rate / s.marks);
+            DrawSyncFlash(s.frame, k >= 1 && s.frames == llround(k * s.marks * s.frame_rate));
+        }
+        s.next_pts = s.frame->pts + 1;
+    }
+    else {
+        s.next_pts = s.frame->pts + s.frame->nb_samples;
+    }
+    s.frames++;
+
+    ret = avcodec_send_frame(s.enc, s.frame);
+    av_frame_unref(s.frame);
+    if (ret < 0)
+        return ret;
+
+    return WritePackets(s, oc, pkt);
+};
+
+} // namespace
+
+int GenerateSyntheticClip(const SyntheticSpec& spec, const char* path)
+{
+    char err2str[256];
+    char desc[512];
+    bool raw = spec.video_codec == "rawvideo";
+
+    AVFormatContext* oc = nullptr;
+    int ret = avformat_alloc_output_context2(&oc, nullptr, raw ? "nut" : "matroska", path);
+    if (ret < 0 || !oc) {
+        printf("synth: cannot create output %s\n", path);
+        return -1;
+    }
+
+    SynthStream video, audio;
+    AVPacket* pkt = av_packet_alloc();
+    AVChannelLayout layout = {};
+
+    // ===== 1. 视频：testsrc2 → yuv420p → 编码器 =====
+    if ((ret = OpenEncoder(video, oc, spec.video_codec.c_str())) < 0)
+        goto end;
+    video.enc->width = spec.width;
+    video.enc->height = spec.height;
+    video.enc->pix_fmt = AV_PIX_FMT_YUV420P;
+    video.enc->time_base = av_inv_q(spec.frame_rate);
+    video.enc->framerate = spec.frame_rate;
+    video.enc->gop_size = spec.gop;
+    video.enc->max_b_frames = spec.b_frames;
+    // 约 0.2 bit/像素，足够保持条码清晰
+    video.enc->bit_rate = (int64_t)(spec.width * spec.height * av_q2d(spec.frame_rate) * 0.2);
+    if ((ret = FinishEncoder(video, oc)) < 0)
+        goto end;
+
+    snprintf(desc, sizeof(desc), "testsrc2=size=%dx%d:rate=%d/%d:duration=%g,format=yuv420p",
+        spec.width, spec.height, spec.frame_rate.num, spec.frame_rate.den, spec.duration);
+    if ((ret = OpenSourceGraph(video, desc, false)) < 0)
+        goto end;
+    video.marks = spec.marks;
+    video.frame_rate = av_q2d(spec.frame_rate);
+
+    // ===== 2. 音频：sine → 编码器采样格式 / 声道布局 → 编码器 =====
+    if (!spec.channel_layout.empty()) {
+        if (av_channel_layout_from_string(&layout, spec.channel_layout.c_str()) < 0) {
+            printf("synth: bad channel layout %s\n", spec.channel_layout.c_str());
+            ret = -1;
+            goto end;
+        }
+    }
+    else {
+        av_channel_layout_default(&layout, spec.channels);
+    }
+
+    if ((ret = OpenEncoder(audio, oc, spec.audio_codec.c_str())) < 0)
+        goto end;
+    audio.enc->sample_rate = spec.sample_rate;
+    audio.enc->sample_fmt = audio.enc->codec->sample_fmts ? audio.enc->codec->sample_fmts[0] : AV_SAMPLE_FMT_S16;
+    audio.enc->time_base = AVRational{ 1, spec.sample_rate };
+    audio.enc->bit_rate = 64000 * layout.nb_channels;
+    av_channel_layout_copy(&audio.enc->ch_layout, &layout);
+    if ((ret = FinishEncoder(audio, oc)) < 0)
+        goto end;
+
+    {
+        char layout_name[64];
+        av_channel_layout_describe(&layout, layout_name, sizeof(layout_name));
+        const char* format = av_get_sample_fmt_name(audio.enc->sample_fmt);
+        if (spec.marks > 0) {
+            // 每个标记时刻开始 50ms 蜂鸣，其余静音
+            snprintf(desc, sizeof(desc),
+                "aevalsrc=exprs='if(gte(t,%g)*lt(mod(t,%g),0.05),0.5*sin(2*PI*1000*t),0)'"
+                ":sample_rate=%d:duration=%g,aformat=sample_fmts=%s:channel_layouts=%s",
+                spec.marks, spec.marks, spec.sample_rate, spec.duration, format, layout_name);
+        }
+        else {
+            snprintf(desc, sizeof(desc),
+                "sine=frequency=440:sample_rate=%d:duration=%g,aformat=sample_fmts=%s:channel_layouts=%s",
+                spec.sample_rate, spec.duration, format, layout_name);
+        }
+    }
+    if ((ret = OpenSourceGraph(audio, desc, true)) < 0)
+        goto end;
+
+    // 固定帧长的编码器（如 aac 1024）要求每帧样本数一致
+    if (audio.enc->frame_size > 0 &&
+        !(audio.enc->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE))
+        av_buffersink_set_frame_size(audio.sink, audio.enc->frame_size);
+
+    // ===== 3. 写文件：按时间戳交错编码两路 =====
+    if (!(oc->oformat->flags & AVFMT_NOFILE)) {
+        if ((ret = avio_open(&oc->pb, path, AVIO_FLAG_WRITE)) < 0)
+            goto end;
+    }
+    if ((ret = avformat_write_header(oc, nullptr)) < 0)
+        goto end;
+
+    while (!video.finished || !audio.finished) {
+        bool pick_video = !video.finished && (audio.finished ||
+            av_compare_ts(video.next_pts, video.enc->time_base,
+                audio.next_pts, audio.enc->time_base) <= 0);
+
+        ret = pick_video ? EncodeNext(video, oc, pkt, true) : EncodeNext(audio, oc, pkt, false);
+        if (ret < 0)
+            goto end;
+    }
+
+    ret = av_write_trailer(oc);
+
+end:
+    if (ret < 0) {
+        av_strerror(ret, err2str, sizeof(err2str));
+        printf("synth: generate %s failed: %s\n", path, err2str);
+    }
+
+    av_channel_layout_uninit(&layout);
+    av_packet_free(&pkt);
+    if (oc && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+
+    return ret < 0 ? -1 : 0;
+};
+
+// ============================================================================
+//                                输入解析
+// ============================================================================
+
+int ResolveMediaInput(const char* input, std::string& url, std::string& format_name)
+{
+    format_name.clear();
+
+    if (strncmp(input, "lavfi:", 6) == 0) {
+        // lavfi 属于 libavdevice，使用前需要注册
+        avdevice_register_all();
+        url = input + 6;
+        format_name = "lavfi";
+        return 0;
+    }
+
+    if (strncmp(input, "synth:", 6) != 0) {
+        url = input;
+        return 0;
+    }
+
+    SyntheticSpec spec;
+    if (ParseSyntheticSpec(input + 6, spec) < 0)
+        return -1;
+
+    // 以参数文本的 FNV-1a 哈希作为缓存文件名
+    uint32_t hash = 2166136261u;
+    for (const char* p = input; *p; p++)
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+
+    char name[64];
+    snprintf(name, sizeof(name), "player_synth_%08x.%s", hash,
+        spec.video_codec == "rawvideo" ? "nut" : "mkv");
+
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::temp_directory_path(ec) / name;
+    url = path.string();
+
+    if (std::filesystem::exists(path, ec))
+        return 0;
+
+    // 先写到同目录下的唯一临时文件，成功后再改名：中途被杀或失败不会留下截断的缓存，
+    // 同时运行的两个进程也不会写同一个文件（后改名的覆盖先改名的，内容相同）
+    char tmp_name[96];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.%08x.tmp", name, av_get_random_seed());
+    std::filesystem::path tmp_path = path.parent_path() / tmp_name;
+
+    printf("synth: generating %s\n", url.c_str());
+    if (GenerateSyntheticClip(spec, tmp_path.string().c_str()) < 0) {
+        std::filesystem::remove(tmp_path, ec);
+        return -1;
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        // 另一个进程已经生成并正在使用同名文件（Windows 上无法覆盖）时直接用它
+        std::filesystem::remove(tmp_path, ec);
+        if (!std::filesystem::exists(path, ec)) {
+            printf("synth: rename to %s failed\n", url.c_str());
+            return -1;
+        }
+    }
+
+    return 0;
+};
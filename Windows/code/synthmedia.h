@@ -0,0 +1,91 @@
+﻿#ifndef SYNTHMEDIA_H
+#define SYNTHMEDIA_H
+
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/rational.h>
+}
+
+/**
+ * @brief 合成测试片段的参数
+ *
+ * 文本形式（逗号分隔，未给出的项取默认值）：
+ *   synth:size=1280x720,rate=30,vcodec=mpeg4,gop=30,bf=0,ar=48000,ac=2,acodec=aac,dur=10
+ *   - size / rate       ：分辨率与帧率（rate 可写成 30000/1001）
+ *   - vcodec / acodec   ：编码器名（vcodec=rawvideo 时生成不需要解码的原始视频）
+ *   - gop / bf          ：关键帧间隔与 B 帧数
+ *   - ar / ac / layout  ：采样率、声道数或声道布局名（如 layout=5.1，优先于 ac）
+ *   - dur               ：时长（秒）
+ *   - marks             ：同步标记间隔（秒）。每隔 marks 秒（从第 marks 秒起）视频中央方块闪白一帧，
+ *                         音频同一时刻开始 50ms 的 1kHz 蜂鸣，其余时间方块为黑色、音频静音
+ *                         （用于音视频同步精度测试，见 SyncProbe）
+ */
+struct SyntheticSpec {
+    int width = 1280;
+    int height = 720;
+    AVRational frame_rate = { 30, 1 };
+    std::string video_codec = "mpeg4";
+    int gop = 30;
+    int b_frames = 0;
+    int sample_rate = 48000;
+    int channels = 2;
+    std::string channel_layout;         // 空表示按声道数取默认布局
+    std::string audio_codec = "aac";
+    double duration = 10.0;
+    double marks = 0.0;                 // 同步标记间隔（秒），0 表示不加
+};
+
+/**
+ * @brief 解析 "synth:" 之后的参数文本
+ * @return 成功返回0，遇到未知项或非法值返回-1
+ */
+int ParseSyntheticSpec(const char* text, SyntheticSpec& spec);
+
+/**
+ * @brief 生成测试片段并编码写入文件
+ *
+ * 视频来自 testsrc2，音频来自 sine（440Hz），每帧左上角一行画出帧序号的 32 位条码
+ * （ReadFrameCounter 可读回），用于确认丢帧 / 重复帧和端到端对应关系。
+ * 容器：rawvideo 用 nut，其余用 matroska。
+ *
+ * @return 成功返回0，失败返回-1
+ */
+int GenerateSyntheticClip(const SyntheticSpec& spec, const char* path);
+
+/**
+ * @brief 在视频帧的亮度平面上画出帧序号条码（8 位平面 YUV 格式）
+ */
+void DrawFrameCounter(AVFrame* frame, uint32_t index);
+
+/**
+ * @brief 读回 DrawFrameCounter 画出的帧序号
+ * @return 帧序号；帧太小或格式不支持时返回-1
+ */
+int64_t ReadFrameCounter(const AVFrame* frame);
+
+/**
+ * @brief 画同步标记方块（画面中央、边长为高度 1/4 的正方形）：on 为白色，否则为黑色
+ */
+void DrawSyncFlash(AVFrame* frame, bool on);
+
+/**
+ * @brief 帧中央的同步标记方块是否为白色（8 位平面 YUV 格式，其它格式返回 false）
+ */
+bool IsSyncFlash(const AVFrame* frame);
+
+/**
+ * @brief 把输入描述转换为可以交给 MainController::setUrl 的路径和容器格式
+ *
+ * - "lavfi:<滤镜图>"：直接用 lavfi 设备打开（如 lavfi:testsrc2=size=640x360[out0];sine[out1]），
+ *                      原始帧，不经过编码
+ * - "synth:<参数>"  ：按参数生成编码片段，缓存在临时目录下（参数相同时直接复用）
+ * - 其他            ：普通文件路径，原样返回
+ *
+ * @return 成功返回0，生成片段失败返回-1
+ */
+int ResolveMediaInput(const char* input, std::string& url, std::string& format_name);
+
+#endif // SYNTHMEDIA_H
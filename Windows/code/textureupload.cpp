@@ -0,0 +1,198 @@
+﻿#include "textureupload.h"
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include "libavutil/imgutils.h"
+}
+
+namespace {
+
+/**
+ * FFmpeg 与 SDL 像素格式对照表
+ * SDL 的打包 RGB 格式按 32 位整数描述，小端机器上内存字节顺序相反（ARGB8888 在内存中为 B G R A）
+ */
+const struct {
+    AVPixelFormat av;
+    Uint32 sdl;
+} kFormatMap[] = {
+    { AV_PIX_FMT_YUV420P,  SDL_PIXELFORMAT_IYUV },
+    { AV_PIX_FMT_YUVJ420P, SDL_PIXELFORMAT_IYUV },
+    { AV_PIX_FMT_NV12,     SDL_PIXELFORMAT_NV12 },
+    { AV_PIX_FMT_NV21,     SDL_PIXELFORMAT_NV21 },
+    { AV_PIX_FMT_YUYV422,  SDL_PIXELFORMAT_YUY2 },
+    { AV_PIX_FMT_UYVY422,  SDL_PIXELFORMAT_UYVY },
+    { AV_PIX_FMT_YVYU422,  SDL_PIXELFORMAT_YVYU },
+    { AV_PIX_FMT_BGRA,     SDL_PIXELFORMAT_ARGB8888 },
+    { AV_PIX_FMT_RGBA,     SDL_PIXELFORMAT_ABGR8888 },
+    { AV_PIX_FMT_ARGB,     SDL_PIXELFORMAT_BGRA8888 },
+    { AV_PIX_FMT_ABGR,     SDL_PIXELFORMAT_RGBA8888 },
+    { AV_PIX_FMT_BGR0,     SDL_PIXELFORMAT_RGB888 },
+    { AV_PIX_FMT_RGB0,     SDL_PIXELFORMAT_BGR888 },
+    { AV_PIX_FMT_RGB24,    SDL_PIXELFORMAT_RGB24 },
+    { AV_PIX_FMT_BGR24,    SDL_PIXELFORMAT_BGR24 },
+    { AV_PIX_FMT_RGB565,   SDL_PIXELFORMAT_RGB565 },
+};
+
+/**
+ * 单个平面的拷贝描述
+ */
+struct PlaneCopy {
+    const uint8_t* src;
+    int src_stride;
+    uint8_t* dst;
+    int dst_stride;
+    int row_bytes;  // 每行有效字节数
+    int rows;       // 行数
+};
+
+/**
+ * 拷贝平面中 [begin, end) 行；两边行宽一致时整块拷贝
+ */
+void CopyRows(const PlaneCopy& plane, int begin, int end)
+{
+    if (begin >= end)
+        return;
+
+    const uint8_t* src = plane.src + (int64_t)begin * plane.src_stride;
+    uint8_t* dst = plane.dst + (int64_t)begin * plane.dst_stride;
+    if (plane.src_stride == plane.dst_stride && plane.row_bytes == plane.dst_stride) {
+        memcpy(dst, src, (size_t)plane.row_bytes * (end - begin));
+        return;
+    }
+
+    for (int row = begin; row < end; row++) {
+        memcpy(dst, src, plane.row_bytes);
+        src += plane.src_stride;
+        dst += plane.dst_stride;
+    }
+};
+
+/**
+ * 拷贝所有平面；大帧按行分段交给线程池，每段拷贝各平面中相同比例的行
+ */
+void CopyPlanes(const PlaneCopy* planes, int count, int64_t pixels, ThreadPool* pool)
+{
+    if (!pool || pixels < UPLOAD_PARALLEL_PIXELS) {
+        for (int i = 0; i < count; i++)
+            CopyRows(planes[i], 0, planes[i].rows);
+        return;
+    }
+
+    int bands = pool->ThreadCount() + 1;
+    pool->ParallelFor(bands, [&](int band) {
+        for (int i = 0; i < count; i++) {
+            int rows = planes[i].rows;
+            CopyRows(planes[i], (int)((int64_t)rows * band / bands),
+                (int)((int64_t)rows * (band + 1) / bands));
+        }
+        });
+};
+
+/**
+ * 纹理无法锁定时交给 SDL 拷贝
+ */
+int UpdateTexture(SDL_Texture* texture, Uint32 format, const AVFrame* frame)
+{
+    int ret = 0;
+    if (format == SDL_PIXELFORMAT_IYUV) {
+        ret = SDL_UpdateYUVTexture(texture, NULL,
+            frame->data[0], frame->linesize[0],
+            frame->data[1], frame->linesize[1],
+            frame->data[2], frame->linesize[2]);
+    }
+    else if (format == SDL_PIXELFORMAT_NV12 || format == SDL_PIXELFORMAT_NV21) {
+        ret = SDL_UpdateNVTexture(texture, NULL,
+            frame->data[0], frame->linesize[0],
+            frame->data[1], frame->linesize[1]);
+    }
+    else {
+        ret = SDL_UpdateTexture(texture, NULL, frame->data[0], frame->linesize[0]);
+    }
+
+    return ret < 0 ? -1 : 0;
+};
+
+} // namespace
+
+Uint32 SdlTextureFormat(int av_format)
+{
+    for (const auto& entry : kFormatMap) {
+        if (entry.av == av_format)
+            return entry.sdl;
+    }
+
+    return SDL_PIXELFORMAT_UNKNOWN;
+};
+
+std::vector<AVPixelFormat> RendererPixelFormats(SDL_Renderer* renderer)
+{
+    std::vector<AVPixelFormat> formats;
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) < 0)
+        return formats;
+
+    for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+        for (const auto& entry : kFormatMap) {
+            if (entry.sdl == info.texture_formats[i])
+                formats.push_back(entry.av);
+        }
+    }
+
+    return formats;
+};
+
+std::vector<AVPixelFormat> TexturePixelFormats()
+{
+    std::vector<AVPixelFormat> formats;
+    for (const auto& entry : kFormatMap)
+        formats.push_back(entry.av);
+
+    return formats;
+};
+
+int UploadFrameTexture(SDL_Texture* texture, const AVFrame* frame, ThreadPool* pool)
+{
+    Uint32 format = SdlTextureFormat(frame->format);
+    if (format == SDL_PIXELFORMAT_UNKNOWN)
+        return -1;
+
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) < 0)
+        return UpdateTexture(texture, format, frame);
+
+    int w = frame->width;
+    int h = frame->height;
+    int chroma_h = (h + 1) / 2;
+    uint8_t* dst = (uint8_t*)pixels;
+
+    PlaneCopy planes[3];
+    int count = 0;
+    if (format == SDL_PIXELFORMAT_IYUV) {
+        // 锁定的 IYUV 纹理内存布局：Y（pitch x h），随后 U、V（各 (pitch+1)/2 x (h+1)/2）
+        int chroma_pitch = (pitch + 1) / 2;
+        uint8_t* u = dst + (int64_t)pitch * h;
+        uint8_t* v = u + (int64_t)chroma_pitch * chroma_h;
+        planes[count++] = { frame->data[0], frame->linesize[0], dst, pitch, w, h };
+        planes[count++] = { frame->data[1], frame->linesize[1], u, chroma_pitch, (w + 1) / 2, chroma_h };
+        planes[count++] = { frame->data[2], frame->linesize[2], v, chroma_pitch, (w + 1) / 2, chroma_h };
+    }
+    else if (format == SDL_PIXELFORMAT_NV12 || format == SDL_PIXELFORMAT_NV21) {
+        // NV12 / NV21：Y（pitch x h），随后交错的 UV（2*((pitch+1)/2) x (h+1)/2）
+        int uv_pitch = 2 * ((pitch + 1) / 2);
+        planes[count++] = { frame->data[0], frame->linesize[0], dst, pitch, w, h };
+        planes[count++] = { frame->data[1], frame->linesize[1], dst + (int64_t)pitch * h,
+            uv_pitch, 2 * ((w + 1) / 2), chroma_h };
+    }
+    else {
+        // 打包格式：单个平面，每行字节数由 FFmpeg 按像素格式计算
+        planes[count++] = { frame->data[0], frame->linesize[0], dst, pitch,
+            av_image_get_linesize((AVPixelFormat)frame->format, w, 0), h };
+    }
+
+    CopyPlanes(planes, count, (int64_t)w * h, pool);
+    SDL_UnlockTexture(texture);
+
+    return 0;
+};
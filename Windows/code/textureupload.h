@@ -0,0 +1,52 @@
+﻿#ifndef TEXTUREUPLOAD_H
+#define TEXTUREUPLOAD_H
+
+#include "threadpool.h"
+#include <vector>
+
+extern "C" {
+#include "SDL.h"
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+}
+
+// 达到该像素数（4K）时才把平面拷贝分给线程池，更小的帧拷贝很快，分发开销反而更大
+#define UPLOAD_PARALLEL_PIXELS (3840 * 2160)
+
+/**
+ * @brief FFmpeg 像素格式对应的 SDL 纹理格式
+ *
+ * 支持 YUV420P（IYUV）、NV12 / NV21、打包 YUV 4:2:2（YUY2 / UYVY / YVYU）和常见 RGB 格式，
+ * 其他格式返回 SDL_PIXELFORMAT_UNKNOWN，需要先转换（见 frameconvert.h）
+ */
+Uint32 SdlTextureFormat(int av_format);
+
+/**
+ * @brief 渲染器能直接创建纹理的 FFmpeg 像素格式（按渲染器的偏好顺序）
+ *
+ * 只取 SDL_GetRendererInfo 报告的原生纹理格式：其他格式 SDL 虽然也能创建纹理，
+ * 但每次更新都会在渲染线程上做软件转换
+ */
+std::vector<AVPixelFormat> RendererPixelFormats(SDL_Renderer* renderer);
+
+/**
+ * @brief SdlTextureFormat 支持的全部 FFmpeg 像素格式，即显示端可能收到的帧格式
+ */
+std::vector<AVPixelFormat> TexturePixelFormats();
+
+/**
+ * @brief 把帧上传到格式对应的流式纹理（在渲染线程调用）
+ *
+ * 用 SDL_LockTexture 取得纹理的可写内存，按行拷贝各个平面（源与目标行宽不同也可以），
+ * 比 SDL_UpdateTexture 系列少一次驱动内部的中转拷贝；
+ * 帧达到 UPLOAD_PARALLEL_PIXELS 且给了线程池时，按行分成若干段并行拷贝。
+ * 纹理无法锁定时退回 SDL_UpdateYUVTexture / SDL_UpdateNVTexture / SDL_UpdateTexture。
+ *
+ * @param texture SDL_TEXTUREACCESS_STREAMING 纹理，格式为 SdlTextureFormat(frame->format)，尺寸与帧相同
+ * @param frame   要显示的帧
+ * @param pool    拷贝线程池，可为空（只在调用线程拷贝）
+ * @return 成功返回0，格式不支持或失败返回-1
+ */
+int UploadFrameTexture(SDL_Texture* texture, const AVFrame* frame, ThreadPool* pool);
+
+#endif // TEXTUREUPLOAD_H
@@ -0,0 +1,109 @@
+﻿#include "threadpool.h"
+
+/**
+ * @brief 构造函数，创建工作线程
+ * @param thread_count 工作线程数，0 表示 CPU 核数 - 1（调用线程也会干活）
+ */
+ThreadPool::ThreadPool(int thread_count)
+{
+    if (thread_count <= 0) {
+        int cores = (int)std::thread::hardware_concurrency();
+        thread_count = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+};
+
+/**
+ * @brief 析构函数，通知并等待所有工作线程退出
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+
+    for (auto& t : workers_) {
+        if (t.joinable())
+            t.join();
+    }
+};
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& fn)
+{
+    if (count <= 0)
+        return;
+
+    std::lock_guard<std::mutex> run_lk(run_mtx_);
+
+    // 1. 发布新批次
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        fn_ = &fn;
+        count_ = count;
+        next_.store(0);
+        finished_ = 0;
+        generation_++;
+    }
+    work_cv_.notify_all();
+
+    // 2. 调用线程也参与执行
+    RunTasks();
+
+    // 3. 等待所有任务完成，且没有工作线程还持有 fn_
+    std::unique_lock<std::mutex> lk(mtx_);
+    done_cv_.wait(lk, [this]() {
+        return finished_ == count_ && active_ == 0;
+        });
+    fn_ = nullptr;
+};
+
+void ThreadPool::WorkerLoop()
+{
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            work_cv_.wait(lk, [&]() {
+                return stop_ || generation_ != seen;
+                });
+            if (stop_)
+                return;
+            seen = generation_;
+            if (!fn_)
+                continue;       // 批次已经结束
+            active_++;
+        }
+
+        RunTasks();
+
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            active_--;
+        }
+        done_cv_.notify_all();
+    }
+};
+
+void ThreadPool::RunTasks()
+{
+    int done = 0;
+
+    // 原子地领取任务序号，直到领完
+    int i;
+    while ((i = next_.fetch_add(1)) < count_) {
+        (*fn_)(i);
+        done++;
+    }
+
+    if (done > 0) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        finished_ += done;
+    }
+    done_cv_.notify_all();
+};
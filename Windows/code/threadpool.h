@@ -0,0 +1,61 @@
+﻿#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 固定大小的线程池，提供阻塞式的并行 for
+ *
+ * 用法：
+ *   ThreadPool pool(4);
+ *   pool.ParallelFor(n, [&](int i) { ... });   // 返回时 n 个任务全部完成
+ *
+ * 调用线程也会参与执行任务；同一时刻只执行一个 ParallelFor，
+ * 多个线程同时调用时按顺序排队。
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int thread_count = 0);  // 0 表示使用 CPU 核数 - 1
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief 并行执行 fn(0) ... fn(count - 1)，全部完成后返回
+     * @param count 任务数量
+     * @param fn    任务函数，参数为任务序号
+     */
+    void ParallelFor(int count, const std::function<void(int)>& fn);
+
+    int ThreadCount() const { return (int)workers_.size(); } // 工作线程数（不含调用线程）
+
+private:
+    void WorkerLoop();          // 工作线程主循环
+    void RunTasks();            // 领取并执行当前批次的任务
+
+private:
+    std::vector<std::thread> workers_;      // 工作线程
+
+    std::mutex run_mtx_;                    // 保证同一时刻只有一个 ParallelFor
+    std::mutex mtx_;                        // 保护下面的批次状态
+    std::condition_variable work_cv_;       // 通知工作线程有新批次
+    std::condition_variable done_cv_;       // 通知调用线程批次完成
+
+    const std::function<void(int)>* fn_ = nullptr; // 当前批次的任务函数
+    int count_ = 0;                         // 当前批次任务数
+    std::atomic<int> next_{ 0 };            // 下一个待领取的任务序号
+    int finished_ = 0;                      // 已完成的任务数
+    int active_ = 0;                        // 正在处理当前批次的工作线程数
+    uint64_t generation_ = 0;               // 批次编号，用于唤醒工作线程
+    bool stop_ = false;                     // 析构时通知工作线程退出
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,334 @@
+﻿#include "threadutil.h"
+#include "allochook.h"
+#include "tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <cerrno>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+int64_t CurrentThreadCpuTimeUs()
+{
+#ifdef _WIN32
+    FILETIME create_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &create_time, &exit_time, &kernel_time, &user_time))
+        return 0;
+
+    // FILETIME 单位为 100ns
+    int64_t kernel = ((int64_t)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    int64_t user = ((int64_t)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+
+    return (kernel + user) / 10;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+};
+
+int64_t ProcessRssBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return (int64_t)counters.WorkingSetSize;
+#else
+    // statm 第二列为常驻页数
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+
+    long long size = 0, resident = 0;
+    int n = fscanf(fp, "%lld %lld", &size, &resident);
+    fclose(fp);
+    if (n != 2)
+        return 0;
+
+    return (int64_t)resident * sysconf(_SC_PAGESIZE);
+#endif
+};
+
+int64_t SystemMemoryBytes()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status))
+        return 0;
+
+    return (int64_t)status.ullTotalPhys;
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    if (pages <= 0)
+        return 0;
+
+    return (int64_t)pages * sysconf(_SC_PAGESIZE);
+#endif
+};
+
+// ============================================================================
+//                                线程资源统计
+// ============================================================================
+
+namespace {
+
+/**
+ * 单个登记线程的统计：等待时间由所属线程累加，CPU 与上下文切换由采样线程读取
+ */
+struct ThreadAccount {
+    const char* name = nullptr;
+#ifdef _WIN32
+    HANDLE handle = nullptr;            // 用于 GetThreadTimes 的线程句柄
+#else
+    pthread_t thread;                   // 用于 pthread_getcpuclockid
+    long tid = 0;                       // 内核线程 ID（/proc/self/task/<tid>）
+#endif
+    std::atomic<int64_t> queue_wait_us{ 0 };
+    std::atomic<int64_t> queue_waits{ 0 };
+    std::atomic<int64_t> sleep_us{ 0 };
+    std::atomic<int64_t> sleeps{ 0 };
+    const std::atomic<int64_t>* heap_allocs = nullptr;  // 所属线程的分配计数器（未启用时为空）
+    const std::atomic<int64_t>* library_allocs = nullptr; // 库内部分配计数器
+};
+
+/**
+ * 登记表。有意不释放：线程可能在静态对象析构之后才退出。
+ * 线程退出前要先拿到锁才能注销，所以持锁采样时 live 中的线程都还存活
+ */
+struct AccountRegistry {
+    std::mutex mutex;                               // 保护 live 与 retired
+    std::vector<ThreadAccount*> live;               // 存活线程
+    std::map<std::string, ThreadUsage> retired;     // 已退出线程的累计值（按线程名）
+};
+
+AccountRegistry& Accounts()
+{
+    static AccountRegistry* registry = new AccountRegistry;
+    return *registry;
+};
+
+/**
+ * 把登记线程的等待计数累加到 usage
+ */
+void AddWaits(const ThreadAccount* account, ThreadUsage& usage)
+{
+    usage.queue_wait_us += account->queue_wait_us.load(std::memory_order_relaxed);
+    usage.queue_waits += account->queue_waits.load(std::memory_order_relaxed);
+    usage.sleep_us += account->sleep_us.load(std::memory_order_relaxed);
+    usage.sleeps += account->sleeps.load(std::memory_order_relaxed);
+    if (account->heap_allocs)
+        usage.heap_allocs = std::max<int64_t>(usage.heap_allocs, 0) +
+            account->heap_allocs->load(std::memory_order_relaxed);
+    if (account->library_allocs)
+        usage.library_allocs = std::max<int64_t>(usage.library_allocs, 0) +
+            account->library_allocs->load(std::memory_order_relaxed);
+};
+
+/**
+ * 从其他线程读取存活线程的 CPU 时间与上下文切换次数（调用方持有登记表锁）
+ */
+void ReadLiveThread(const ThreadAccount* account, ThreadUsage& usage)
+{
+#ifdef _WIN32
+    FILETIME create_time, exit_time, kernel_time, user_time;
+    if (GetThreadTimes(account->handle, &create_time, &exit_time, &kernel_time, &user_time)) {
+        int64_t kernel = ((int64_t)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+        int64_t user = ((int64_t)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+        usage.cpu_us += (kernel + user) / 10;
+    }
+#else
+    clockid_t clock_id;
+    struct timespec ts;
+    if (pthread_getcpuclockid(account->thread, &clock_id) == 0 && clock_gettime(clock_id, &ts) == 0)
+        usage.cpu_us += (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%ld/status", account->tid);
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+        return;
+
+    char line[128];
+    long long value = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "voluntary_ctxt_switches: %lld", &value) == 1)
+            usage.voluntary_switches += value;
+        else if (sscanf(line, "nonvoluntary_ctxt_switches: %lld", &value) == 1)
+            usage.involuntary_switches += value;
+    }
+    fclose(fp);
+#endif
+};
+
+/**
+ * 线程退出时注销：把最终值并入同名的已退出条目
+ */
+struct AccountHolder {
+    ThreadAccount* account = nullptr;
+
+    ~AccountHolder()
+    {
+        if (!account)
+            return;
+
+        AccountRegistry& registry = Accounts();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        ThreadUsage& usage = registry.retired[account->name];
+        usage.name = account->name;
+        usage.cpu_us += CurrentThreadCpuTimeUs();
+#ifdef _WIN32
+        CloseHandle(account->handle);
+#else
+        struct rusage ru;
+        if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+            usage.voluntary_switches += ru.ru_nvcsw;
+            usage.involuntary_switches += ru.ru_nivcsw;
+        }
+#endif
+        AddWaits(account, usage);
+
+        registry.live.erase(std::find(registry.live.begin(), registry.live.end(), account));
+        delete account;
+    };
+};
+
+thread_local AccountHolder t_account;
+
+} // namespace
+
+void SetCurrentThreadName(const char* name)
+{
+    if (t_account.account)
+        return;
+
+    TraceSetThreadName(name);
+
+#ifdef _WIN32
+    // SetThreadDescription 从 Windows 10 1607 开始提供，动态查找以兼容旧系统
+    typedef HRESULT(WINAPI* SetThreadDescriptionFn)(HANDLE, PCWSTR);
+    static SetThreadDescriptionFn set_description = (SetThreadDescriptionFn)GetProcAddress(
+        GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription");
+    if (set_description) {
+        wchar_t wide_name[64];
+        if (MultiByteToWideChar(CP_UTF8, 0, name, -1, wide_name, 64) > 0)
+            set_description(GetCurrentThread(), wide_name);
+    }
+#else
+    // Linux 线程名最多15个字符，超出时 pthread_setname_np 直接失败，先截断
+    char short_name[16];
+    snprintf(short_name, sizeof(short_name), "%s", name);
+    pthread_setname_np(pthread_self(), short_name);
+#endif
+
+    ThreadAccount* account = new ThreadAccount;
+    account->name = name;
+    account->heap_allocs = ThreadHeapAllocCounter();
+    account->library_allocs = ThreadLibraryAllocCounter();
+#ifdef _WIN32
+    account->handle = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+#else
+    account->thread = pthread_self();
+    account->tid = (long)syscall(SYS_gettid);
+#endif
+
+    AccountRegistry& registry = Accounts();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.live.push_back(account);
+    t_account.account = account;
+};
+
+void AddThreadWait(WaitKind kind, int64_t wait_us)
+{
+    ThreadAccount* account = t_account.account;
+    if (!account)
+        return;
+
+    if (kind == WaitKind::Queue) {
+        account->queue_wait_us.fetch_add(wait_us, std::memory_order_relaxed);
+        account->queue_waits.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        account->sleep_us.fetch_add(wait_us, std::memory_order_relaxed);
+        account->sleeps.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+void ThreadSleepMs(int ms)
+{
+    ThreadWaitScope wait(WaitKind::Sleep);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+};
+
+void PreciseSleepUs(int64_t us)
+{
+    if (us <= 0)
+        return;
+
+#ifdef _WIN32
+    // 每个线程一个高精度计时器（调用它的都是常驻线程，不关闭句柄）
+    thread_local HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr,
+        CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (timer) {
+        LARGE_INTEGER due;
+        due.QuadPart = -us * 10;  // 负数表示相对时间，单位 100ns
+        if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+
+    // 旧系统：把系统计时器精度提到 1ms（进程退出时自动恢复）
+    static std::once_flag period_once;
+    std::call_once(period_once, [] { timeBeginPeriod(1); });
+    Sleep((DWORD)((us + 999) / 1000));  // 向上取整，宁可晚一点也不提前返回
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000);
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR);
+#endif
+};
+
+std::vector<ThreadUsage> SampleThreadUsage()
+{
+    AccountRegistry& registry = Accounts();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::map<std::string, ThreadUsage> merged = registry.retired;
+    for (const ThreadAccount* account : registry.live) {
+        ThreadUsage& usage = merged[account->name];
+        usage.name = account->name;
+        usage.threads++;
+        ReadLiveThread(account, usage);
+        AddWaits(account, usage);
+    }
+
+    std::vector<ThreadUsage> result;
+    for (auto& entry : merged)
+        result.push_back(entry.second);
+
+    return result;
+};
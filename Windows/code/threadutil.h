@@ -0,0 +1,125 @@
+﻿#ifndef THREADUTIL_H
+#define THREADUTIL_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 获取调用线程累计占用的 CPU 时间（用户态 + 内核态，微秒）
+ *
+ * Windows 使用 GetThreadTimes，其他平台使用 CLOCK_THREAD_CPUTIME_ID。
+ * 每次调用是一次系统调用，热路径上应隔一段时间再采样。
+ */
+int64_t CurrentThreadCpuTimeUs();
+
+/**
+ * @brief 获取进程当前常驻内存（字节），失败返回0
+ *
+ * Windows 使用 GetProcessMemoryInfo 的 WorkingSetSize，其他平台读取 /proc/self/statm。
+ */
+int64_t ProcessRssBytes();
+
+/**
+ * @brief 获取物理内存总量（字节），失败返回0
+ *
+ * Windows 使用 GlobalMemoryStatusEx，其他平台使用 sysconf(_SC_PHYS_PAGES)。
+ */
+int64_t SystemMemoryBytes();
+
+// ============================================================================
+//                     线程命名与资源统计（按线程名汇总）
+// ============================================================================
+
+/**
+ * @brief 同名线程的累计资源使用（SampleThreadUsage 返回）
+ *
+ * 已退出线程的最终值会并入同名条目，所以每次播放新建的解复用 / 解码线程
+ * 在整个进程生命周期内累计为一行。
+ */
+struct ThreadUsage {
+    std::string name;                   // 线程名
+    int threads = 0;                    // 当前存活的同名线程数
+    int64_t cpu_us = 0;                 // CPU 时间（用户态 + 内核态，微秒）
+    int64_t voluntary_switches = 0;     // 主动上下文切换（阻塞 / 休眠），Windows 上为0
+    int64_t involuntary_switches = 0;   // 被动上下文切换（被抢占），Windows 上为0
+    int64_t queue_wait_us = 0;          // 阻塞在队列等待中的时间（微秒）
+    int64_t queue_waits = 0;            // 队列等待次数
+    int64_t sleep_us = 0;               // 轮询休眠时间（微秒）
+    int64_t sleeps = 0;                 // 轮询休眠次数（每次都是一次唤醒）
+    int64_t heap_allocs = -1;           // 本仓库代码的堆分配次数（见 allochook.h），未启用计数时为 -1
+    int64_t library_allocs = -1;        // 已知的 FFmpeg 内部分配次数（LibraryAllocScope 内），未启用计数时为 -1
+};
+
+/**
+ * @brief 等待类型
+ */
+enum class WaitKind {
+    Queue,  // 阻塞在队列条件变量上
+    Sleep,  // 轮询循环中的固定休眠
+};
+
+/**
+ * @brief 设置调用线程的名字并登记资源统计（名字必须是字符串常量）
+ *
+ * 同时设置系统线程名（Linux pthread_setname_np，最多15个字符；
+ * Windows SetThreadDescription）和追踪文件中的线程名。
+ * 每个线程只有第一次调用生效，之后的调用直接返回，可以放在回调里。
+ */
+void SetCurrentThreadName(const char* name);
+
+/**
+ * @brief 给调用线程累加一次等待（未登记的线程忽略）
+ */
+void AddThreadWait(WaitKind kind, int64_t wait_us);
+
+/**
+ * @brief 休眠并计入调用线程的轮询休眠统计
+ */
+void ThreadSleepMs(int ms);
+
+/**
+ * @brief 高精度休眠（微秒），用于等到期时刻的最后几毫秒，代替让出 CPU 的忙等
+ *
+ * Linux 用 clock_nanosleep（误差约 0.1ms）；Windows 用高精度可等待计时器（Windows 10 1803 起），
+ * 更早的系统退回 timeBeginPeriod(1) + Sleep（按毫秒向上取整，不会提前返回）。不计入轮询休眠统计
+ */
+void PreciseSleepUs(int64_t us);
+
+/**
+ * @brief 采样所有登记线程的资源使用，按线程名排序
+ *
+ * 存活线程的 CPU 时间与上下文切换由采样线程直接读取
+ * （Linux 使用 pthread_getcpuclockid 与 /proc/self/task/<tid>/status，
+ * Windows 使用 GetThreadTimes），被采样线程不需要配合。
+ * 由统计接口每秒调用一次；每次调用对每个线程有几次系统调用。
+ */
+std::vector<ThreadUsage> SampleThreadUsage();
+
+/**
+ * @brief 作用域等待：析构时把经过的时间计入调用线程
+ */
+class ThreadWaitScope
+{
+public:
+    explicit ThreadWaitScope(WaitKind kind)
+        : kind_(kind),
+        start_(std::chrono::steady_clock::now())
+    {};
+
+    ~ThreadWaitScope()
+    {
+        AddThreadWait(kind_, std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+    };
+
+    ThreadWaitScope(const ThreadWaitScope&) = delete;
+    ThreadWaitScope& operator=(const ThreadWaitScope&) = delete;
+
+private:
+    WaitKind kind_;                                 // 等待类型
+    std::chrono::steady_clock::time_point start_;   // 开始时间
+};
+
+#endif // THREADUTIL_H
@@ -0,0 +1,164 @@
+﻿#include "tracing.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 每块事件数与每个线程的最大块数（每线程最多约 400 万个区间，超出后丢弃）
+#define TRACE_CHUNK_EVENTS 4096
+#define TRACE_MAX_CHUNKS 1024
+
+std::atomic<bool> g_trace_enabled{ false };
+
+namespace {
+
+struct TraceEvent {
+    const char* name;   // 区间名（字符串常量）
+    int64_t start_ns;   // 开始时间
+    int64_t dur_ns;     // 持续时间
+};
+
+/**
+ * 单个线程的事件缓冲区：只有所属线程写入，count 发布已写完的事件数
+ */
+struct TraceBuffer {
+    int tid = 0;
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<TraceEvent*> chunks[TRACE_MAX_CHUNKS] = {};
+    std::atomic<int64_t> count{ 0 };
+    std::atomic<int64_t> dropped{ 0 };
+};
+
+/**
+ * 所有线程缓冲区的登记表。有意不释放：
+ * 进程退出时可能仍有线程在写入，TraceStop 也可能在 atexit 中调用
+ */
+struct TraceRegistry {
+    std::mutex mutex;                   // 保护 buffers 与 path
+    std::vector<TraceBuffer*> buffers;
+    std::string path;                   // 输出文件
+    int64_t origin_ns = 0;              // TraceStart 时刻，之前的事件不输出
+};
+
+TraceRegistry& Registry()
+{
+    static TraceRegistry* registry = new TraceRegistry;
+    return *registry;
+};
+
+thread_local TraceBuffer* t_buffer = nullptr;
+thread_local const char* t_name = nullptr;
+
+TraceBuffer* ThreadBuffer()
+{
+    if (!t_buffer) {
+        TraceBuffer* buffer = new TraceBuffer;
+        buffer->name = t_name;
+
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer->tid = (int)registry.buffers.size() + 1;
+        registry.buffers.push_back(buffer);
+        t_buffer = buffer;
+    }
+
+    return t_buffer;
+};
+
+} // namespace
+
+void TraceRecord(const char* name, int64_t start_ns, int64_t end_ns)
+{
+    TraceBuffer* buffer = ThreadBuffer();
+    int64_t index = buffer->count.load(std::memory_order_relaxed);
+    int64_t chunk = index / TRACE_CHUNK_EVENTS;
+
+    if (chunk >= TRACE_MAX_CHUNKS) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent* events = buffer->chunks[chunk].load(std::memory_order_relaxed);
+    if (!events) {
+        events = new TraceEvent[TRACE_CHUNK_EVENTS];
+        buffer->chunks[chunk].store(events, std::memory_order_release);
+    }
+
+    TraceEvent& ev = events[index % TRACE_CHUNK_EVENTS];
+    ev.name = name;
+    ev.start_ns = start_ns;
+    ev.dur_ns = end_ns - start_ns;
+
+    // 先写事件再发布计数，TraceStop 只读取已发布的部分
+    buffer->count.store(index + 1, std::memory_order_release);
+};
+
+void TraceSetThreadName(const char* name)
+{
+    t_name = name;
+    if (t_buffer)
+        t_buffer->name = name;
+};
+
+void TraceStart(const char* path)
+{
+    TraceRegistry& registry = Registry();
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.path = path ? path : "trace.json";
+        registry.origin_ns = TraceNowNs();
+    }
+    g_trace_enabled = true;
+};
+
+int TraceStop()
+{
+    if (!g_trace_enabled.exchange(false))
+        return -1;
+
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    FILE* fp = fopen(registry.path.c_str(), "w");
+    if (!fp) {
+        printf("TraceStop: open %s failed\n", registry.path.c_str());
+        return -1;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    bool first = true;
+    int64_t events = 0;
+    int64_t dropped = 0;
+
+    for (TraceBuffer* buffer : registry.buffers) {
+        const char* name = buffer->name.load();
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", buffer->tid, name ? name : "thread");
+        first = false;
+
+        int64_t count = buffer->count.load(std::memory_order_acquire);
+        for (int64_t i = 0; i < count; i++) {
+            const TraceEvent& ev = buffer->chunks[i / TRACE_CHUNK_EVENTS]
+                .load(std::memory_order_acquire)[i % TRACE_CHUNK_EVENTS];
+            if (ev.start_ns < registry.origin_ns)
+                continue;
+
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                ev.name, buffer->tid,
+                (ev.start_ns - registry.origin_ns) / 1000.0, ev.dur_ns / 1000.0);
+            events++;
+        }
+        dropped += buffer->dropped.load();
+    }
+
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+
+    printf("trace: %lld events written to %s", (long long)events, registry.path.c_str());
+    if (dropped > 0)
+        printf(" (%lld dropped)", (long long)dropped);
+    printf("\n");
+
+    return 0;
+};
@@ -0,0 +1,87 @@
+﻿#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief 流水线线程活动追踪，导出为 Chrome trace-event JSON（可用 Perfetto / chrome://tracing 打开）
+ *
+ * 用法：
+ *   TraceStart("trace.json");            // 开始记录
+ *   { TraceScope trace("decode"); ... }  // 记录一个区间（名字必须是字符串常量）
+ *   TraceStop();                         // 停止记录并写出文件
+ *
+ * - 每个线程写自己的缓冲区（只有该线程写入，无锁），缓冲区按块增长
+ * - 未开启时 TraceScope 只有一次分支判断
+ * - 线程名通过 TraceSetThreadName 设置，显示为 Perfetto 中的轨道名
+ */
+
+extern std::atomic<bool> g_trace_enabled;
+
+/**
+ * @brief 追踪是否开启
+ */
+inline bool TraceEnabled()
+{
+    return g_trace_enabled.load(std::memory_order_relaxed);
+};
+
+/**
+ * @brief 追踪时间戳（纳秒，单调时钟）
+ */
+inline int64_t TraceNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+};
+
+/**
+ * @brief 记录一个已结束的区间（由 TraceScope 调用）
+ */
+void TraceRecord(const char* name, int64_t start_ns, int64_t end_ns);
+
+/**
+ * @brief 设置调用线程在追踪文件中的名字（字符串常量）
+ */
+void TraceSetThreadName(const char* name);
+
+/**
+ * @brief 开始追踪
+ * @param path 输出 JSON 文件路径（TraceStop 时写出）
+ */
+void TraceStart(const char* path);
+
+/**
+ * @brief 停止追踪并写出 JSON 文件
+ * @return 成功返回0，未开启或写文件失败返回-1
+ */
+int TraceStop();
+
+/**
+ * @brief 作用域区间：构造时记录开始时间，析构时写入缓冲区
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name)
+        : name_(name),
+        start_(TraceEnabled() ? TraceNowNs() : -1)
+    {};
+
+    ~TraceScope()
+    {
+        if (start_ >= 0)
+            TraceRecord(name_, start_, TraceNowNs());
+    };
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;  // 区间名
+    int64_t start_;     // 开始时间（纳秒），-1 表示未开启
+};
+
+#endif // TRACING_H
@@ -1,12 +1,62 @@
 ﻿#include "videooutput.h"
+#include "threadutil.h"
+#include "framelatency.h"
+#include "framepacing.h"
+#include "tracing.h"
+#include "metrics.h"
+#include "syncprobe.h"
+#include <cstdio>
 #include <thread>
 
-#define REFRESH_RATE 0.01  // 刷新间隔（秒）
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+}
+
+#define REFRESH_RATE 0.01  // 无法用事件唤醒时（注册事件失败 / 等待出错）的轮询间隔（秒）
+
+// 等待下一帧时单次最长睡眠（秒）：主时钟由音频回调不断校正，长等待分段进行
+#define FRAME_WAIT_MAX 0.1
+// 到期前最后这段时间（秒）不再交给 SDL_WaitEventTimeout（毫秒精度、可能多睡），改为高精度休眠（见 PreciseSleepUs）
+#define PRECISE_WAIT 0.002
+// 垂直同步时在目标 vblank 的前一个 vblank 之后多久提交（秒），保证不会赶上前一个 vblank
+#define VSYNC_RELEASE_MARGIN 0.001
+
+// 纹理上传线程池的最大线程数（加上渲染线程本身）：内存带宽有限，更多线程没有收益
+#define UPLOAD_POOL_THREADS 3
 
 // 固定窗口大小
 #define WINDOW_W 1280
 #define WINDOW_H 720
 
+// 指标叠加层布局（像素）
+#define OVERLAY_X 10        // 左上角
+#define OVERLAY_Y 10
+#define OVERLAY_ROW_H 16    // 行高
+#define OVERLAY_BAR_W 160   // 条形图满刻度宽度
+#define OVERLAY_PIXEL 2     // 数字点阵的放大倍数
+
+// 指标叠加层的行
+// type: 0 = 条形图从左开始，1 = 条形图从中间向两侧（有正负），2 = 只显示数值（计数器）
+struct OverlayRow {
+    const char* name;   // 指标名（见 metrics.h）
+    int type;
+    int64_t full;       // 满刻度
+    int64_t unit;       // 数值显示时的除数（微秒显示为毫秒）
+    Uint8 r, g, b;      // 色块颜色
+};
+// 队列满刻度与解复用 / 解码线程的背压阈值一致（帧队列按缓存时长显示）
+static const OverlayRow kOverlayRows[] = {
+    { "queue.audio_packet.depth",       0, 100,     1,    80, 160, 255 },
+    { "queue.video_packet.depth",       0, 100,     1,    80, 255, 120 },
+    { "queue.audio_frame.duration_us",  0, 1000000, 1000, 40, 100, 200 },
+    { "queue.video_frame.duration_us",  0, 400000,  1000, 40, 200, 80 },
+    { "avsync.drift_us",                1, 100000,  1000, 255, 255, 80 },  // ±100ms
+    { "video.frames_late",              2, 0,       1,    255, 80, 80 },
+    { "audio.underruns",                2, 0,       1,    255, 160, 40 },
+};
+static const int kOverlayRowCount = sizeof(kOverlayRows) / sizeof(kOverlayRows[0]);
+
 // ---------------------------------------------------------
 // 构造与析构
 // ---------------------------------------------------------
@@ -17,10 +67,31 @@ VideoOutput::VideoOutput(AVSync* avsync, AVFrameQueue* frame_queue,
     video_width_(video_width),
     video_height_(video_height),
     time_base_(time_base)
-{};
+{
+    upload_time_ = MetricsRegistry::Instance().GetHistogram("video.upload_us");
+    present_interval_ = MetricsRegistry::Instance().GetHistogram("video.present_interval_us");
+    vsync_period_ = MetricsRegistry::Instance().GetGauge("video.vsync_period_us");
+    frames_unsupported_ = MetricsRegistry::Instance().GetCounter("video.frames_unsupported");
+    // 叠加层每帧都要读这些指标：在这里查好指针，渲染线程上不再查注册表
+    for (int i = 0; i < kOverlayRowCount; i++) {
+        const OverlayRow& row = kOverlayRows[i];
+        overlay_counters_.push_back(row.type == 2 ? MetricsRegistry::Instance().GetCounter(row.name) : nullptr);
+        overlay_gauges_.push_back(row.type == 2 ? nullptr : MetricsRegistry::Instance().GetGauge(row.name));
+    }
+    shown_ = av_frame_alloc();
+};
 
 VideoOutput::~VideoOutput()
 {
+    if (frame_queue_)
+        frame_queue_->SetPushListener(nullptr);
+    if (snapshot_)
+        snapshot_->SetRequestListener(nullptr);
+    av_frame_free(&shown_);
+
+    delete upload_pool_;
+    upload_pool_ = nullptr;
+
     if (texture_) {
         SDL_DestroyTexture(texture_);
         texture_ = nullptr;
@@ -68,32 +139,156 @@ int VideoOutput::Init()
     // - win_: 关联的窗口
     // - -1: 使用第一个支持的渲染驱动
     // - SDL_RENDERER_ACCELERATED: 使用硬件加速
-    renderer_ = SDL_CreateRenderer(win_, -1, SDL_RENDERER_ACCELERATED);
+    // - SDL_RENDERER_PRESENTVSYNC: 可选，SDL_RenderPresent 与显示器刷新同步
+    renderer_ = SDL_CreateRenderer(win_, -1,
+        SDL_RENDERER_ACCELERATED | (vsync_ ? SDL_RENDERER_PRESENTVSYNC : 0));
     if (!renderer_) {
         printf("SDL_CreateRenderer failed: %s\n", SDL_GetError());
         return -1;
     }
 
-    // 4. 创建 YUV 纹理
+    // 垂直同步：以显示模式的刷新率作为名义周期，实际周期和相位由显示时刻估计
+    if (vsync_) {
+        SDL_DisplayMode mode;
+        double period = 0.0;
+        if (SDL_GetWindowDisplayMode(win_, &mode) == 0 && mode.refresh_rate > 0)
+            period = 1.0 / mode.refresh_rate;
+        vsync_estimator_.Reset(period);
+    }
+
+    // 4. 唤醒事件：新帧进入空队列、恢复播放、请求退出时打断渲染循环的等待
+    wake_event_ = SDL_RegisterEvents(1);
+    if (wake_event_ == (Uint32)-1)
+        printf("SDL_RegisterEvents failed, render loop falls back to polling\n");
+    SetQueueListener(nullptr);
+
+    // 5. 渲染器原生支持的像素格式：解码线程据此决定是否需要转换
+    display_formats_ = RendererPixelFormats(renderer_);
+    if (display_formats_.empty())
+        display_formats_.push_back(AV_PIX_FMT_YUV420P);
+
+    // 6. 创建 YUV 纹理（第一帧格式不同时会按帧的格式重建）
+    return CreateTexture(SDL_PIXELFORMAT_IYUV, video_width_, video_height_);
+};
+
+/**
+ * @brief 创建（或按新格式 / 尺寸重建）流式纹理
+ */
+int VideoOutput::CreateTexture(Uint32 format, int width, int height)
+{
+    if (texture_) {
+        SDL_DestroyTexture(texture_);
+        texture_ = nullptr;
+    }
+
     // 参数说明：
     // - renderer_: 关联的渲染器
-    // - SDL_PIXELFORMAT_IYUV: YUV420 格式（I420）
+    // - format: 与帧像素格式对应的 SDL 格式（IYUV / NV12 / RGB 等，见 textureupload.h）
     // - SDL_TEXTUREACCESS_STREAMING: 流式纹理，需要频繁更新
-    // - video_width_, video_height_: 纹理尺寸（视频原始尺寸）
-    texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_IYUV,
+    // - width, height: 纹理尺寸（视频原始尺寸）
+    texture_ = SDL_CreateTexture(renderer_, format,
         SDL_TEXTUREACCESS_STREAMING,
-        video_width_, video_height_);
+        width, height);
 
     if (!texture_) {
         printf("SDL_CreateTexture failed: %s\n", SDL_GetError());
+        texture_width_ = texture_height_ = 0;
+        texture_format_ = 0;
         return -1;
     }
 
-    return 0;  // 初始化成功
+    texture_format_ = format;
+    texture_width_ = width;
+    texture_height_ = height;
+
+    return 0;
+};
+
+/**
+ * @brief 切换到新的视频流（播放下一个文件时调用）
+ *
+ * 窗口和渲染器保持不变；只有分辨率变化时才重建纹理。
+ * 必须在创建窗口的线程上调用。
+ */
+int VideoOutput::Reconfigure(AVFrameQueue* frame_queue,
+    int video_width, int video_height, AVRational time_base)
+{
+    SetQueueListener(frame_queue);
+    video_width_ = video_width;
+    video_height_ = video_height;
+    time_base_ = time_base;
+    paused_ = false;
+    quit_ = false;
+    last_present_ = 0.0;
+    FramePacing::Instance().Break();
+    av_frame_unref(shown_);
+
+    // 清掉上一个文件的最后一帧
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+    SDL_RenderClear(renderer_);
+    SDL_RenderPresent(renderer_);
+
+    if (texture_ && texture_width_ == video_width_ && texture_height_ == video_height_) {
+        return 0;
+    }
+
+    return CreateTexture(texture_format_ ? texture_format_ : SDL_PIXELFORMAT_IYUV,
+        video_width_, video_height_);
+};
+
+void VideoOutput::RequestQuit()
+{
+    quit_ = true;
+    Wake();
+};
+
+/**
+ * @brief 换到新的帧队列（为空表示保持当前队列），并在队列上登记入队通知
+ *
+ * 渲染循环发现队列为空时置位 frame_wanted_ 后无限等待，解码线程的下一次 Push 发送唤醒事件
+ */
+void VideoOutput::SetQueueListener(AVFrameQueue* frame_queue)
+{
+    if (frame_queue && frame_queue != frame_queue_) {
+        frame_queue_->SetPushListener(nullptr);
+        frame_queue_ = frame_queue;
+    }
+    frame_wanted_ = false;
+
+    frame_queue_->SetPushListener([this]() {
+        if (frame_wanted_.exchange(false))
+            Wake();
+    });
+};
+
+/**
+ * @brief 向渲染循环发送唤醒事件（任意线程可调用）
+ */
+void VideoOutput::Wake()
+{
+    if (wake_event_ == (Uint32)-1)
+        return;
+
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = wake_event_;
+    SDL_PushEvent(&event);
+};
+
+void VideoOutput::SetSnapshotWriter(SnapshotWriter* writer)
+{
+    if (snapshot_)
+        snapshot_->SetRequestListener(nullptr);
+    snapshot_ = writer;
+    if (snapshot_)
+        snapshot_->SetRequestListener([this] { Wake(); });
 };
 
 void VideoOutput::DeInit()
 {
+    frame_queue_->SetPushListener(nullptr);
+    av_frame_unref(shown_);
+
     if (texture_) { SDL_DestroyTexture(texture_); texture_ = nullptr; }
     if (renderer_) { SDL_DestroyRenderer(renderer_); renderer_ = nullptr; }
     if (win_) { SDL_DestroyWindow(win_); win_ = nullptr; }
@@ -112,6 +307,11 @@ int VideoOutput::MainLoop()
         // 等待事件并刷新视频
         RefreshLoopWaitEvent(&event);
 
+        // 外部请求退出（切换文件 / 停止播放）
+        if (quit_) {
+            return 0;
+        }
+
         // 处理事件
         switch (event.type) {
         case SDL_KEYDOWN:
@@ -120,6 +320,13 @@ int VideoOutput::MainLoop()
                 printf("ESC pressed, exit\n");
                 return 0;  // 退出主循环
             }
+            // I 键切换指标叠加层
+            if (event.key.keysym.sym == SDLK_i) {
+                bool on = !overlay_;
+                overlay_ = on;
+                if (overlay_listener_)
+                    overlay_listener_(on);
+            }
             break;
 
         case SDL_QUIT:
@@ -135,43 +342,76 @@ int VideoOutput::MainLoop()
 };
 
 // ---------------------------------------------------------
-// 刷新循环：等待 SDL 事件，同时按固定间隔刷新画面
+// 刷新循环：显示到期的帧，然后睡到 下一帧到期 / 输入事件 / 唤醒事件 中最早的一个
 // ---------------------------------------------------------
 void VideoOutput::RefreshLoopWaitEvent(SDL_Event* event)
 {
-    double remain_time = 0.0;  // 需要休眠的时间（秒）
-
-    // 从系统获取新事件到事件队列
-    SDL_PumpEvents();
-
-    // 循环直到收到事件
-    while (!SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) {
-        // SDL_PeepEvents 参数说明：
-        // - event: 存储事件的位置
-        // - 1: 最多检查一个事件
-        // - SDL_GETEVENT: 检查事件但不从队列移除
-        // - SDL_FIRSTEVENT, SDL_LASTEVENT: 检查所有类型的事件
-
-        // 如果有需要休眠的时间，则休眠
-        if (remain_time > 0.0) {
-            std::this_thread::sleep_for(
-                std::chrono::milliseconds(int64_t(remain_time * 1000)));
+    double remain_time = 0.0;  // 距离下一帧到期的时间（秒），负数表示没有要等的帧
+
+    while (true) {
+        // 外部请求退出时不再等待事件
+        if (quit_) {
+            event->type = SDL_FIRSTEVENT;
+            return;
         }
 
-        // 刷新视频（可能更新 remain_time）
+        // 1. 显示到期的帧，计算下一次需要醒来的时间
         videoRefresh(remain_time);
 
-        // 再次获取新事件
-        SDL_PumpEvents();
+        // 2. 等待：刚显示了一帧时只取已到达的事件，接着看下一帧
+        int got = 0;
+        if (remain_time == 0.0) {
+            got = SDL_PollEvent(event);
+        }
+        else {
+            TraceScope trace("sync wait");
+            ThreadWaitScope wait(WaitKind::Sleep);
+            got = WaitEventUntil(event, remain_time);
+        }
+
+        // 3. 唤醒事件只用于打断等待，其他事件交给 MainLoop 处理
+        if (got && event->type != wake_event_)
+            return;
+    }
+};
+
+/**
+ * @brief 等待 SDL 事件，最多 remain_time 秒（负数表示一直等到有事件）
+ *
+ * 先用 SDL_WaitEventTimeout 睡到到期前 PRECISE_WAIT 秒（期间能被事件唤醒），
+ * 剩下的时间用 PreciseSleepUs 一次睡到到期（不再处理事件，也不占 CPU）：
+ * Linux 和 Windows 10 1803 起误差约 0.1ms，更早的 Windows 向上取整到毫秒，最多晚约 1ms
+ * @return 收到事件返回 1，到期返回 0
+ */
+int VideoOutput::WaitEventUntil(SDL_Event* event, double remain_time)
+{
+    // 没有唤醒事件时不能无限等待，退回按固定间隔轮询
+    if (remain_time < 0.0 && wake_event_ == (Uint32)-1)
+        remain_time = REFRESH_RATE;
+
+    if (remain_time < 0.0) {
+        if (SDL_WaitEvent(event))
+            return 1;
+        printf("SDL_WaitEvent failed: %s\n", SDL_GetError());
+        remain_time = REFRESH_RATE;
     }
 
-    // 循环结束：收到事件，事件已存储在 event 参数中
+    remain_time = std::min(remain_time, FRAME_WAIT_MAX);
+    int64_t deadline = av_gettime_relative() + (int64_t)(remain_time * 1000000);
+
+    int coarse_ms = (int)((remain_time - PRECISE_WAIT) * 1000);
+    if (coarse_ms > 0 && SDL_WaitEventTimeout(event, coarse_ms))
+        return 1;
+
+    PreciseSleepUs(deadline - av_gettime_relative());
+
+    return 0;
 };
 
 // ---------------------------------------------------------
 // 按比例缩放 + 居中绘制
 // ---------------------------------------------------------
-static SDL_Rect CalcLetterBoxRect(int video_w, int video_h)
+SDL_Rect CalcLetterBoxRect(int video_w, int video_h)
 {
     double window_w = WINDOW_W;
     double window_h = WINDOW_H;
@@ -195,18 +435,30 @@ static SDL_Rect CalcLetterBoxRect(int video_w, int video_h)
 // ---------------------------------------------------------
 void VideoOutput::videoRefresh(double& remain_time)
 {
-    // 1. 暂停状态：保持刷新节奏但不渲染
+    // 0. 单张截图：取正在显示的帧的引用（暂停时由请求唤醒，同样响应）
+    if (snapshot_)
+        snapshot_->ServePending(shown_, time_base_);
+
+    // 1. 暂停状态：不渲染，也不定时醒来，由 Resume() 的唤醒事件打断等待
     if (paused_) {
-        remain_time = REFRESH_RATE;  // 10ms 后再次检查
+        remain_time = -1.0;
+        last_present_ = 0.0;  // 暂停前后的两帧不计入显示间隔
+        FramePacing::Instance().Break();
         return;
     }
 
     // 2. 获取队列中的下一帧（不弹出）
     AVFrame* frame = frame_queue_->Front();
     if (!frame) {
-        // 队列为空，等待下一轮刷新
-        remain_time = REFRESH_RATE;
-        return;
+        // 队列为空：登记等待，解码线程下一次 Push 时发送唤醒事件；
+        // 登记后再查一次，登记之前刚入队的帧不会被漏掉
+        frame_wanted_ = true;
+        frame = frame_queue_->Front();
+        if (!frame) {
+            remain_time = -1.0;
+            return;
+        }
+        frame_wanted_ = false;
     }
 
     // 3. A/V 同步计算
@@ -218,61 +470,201 @@ void VideoOutput::videoRefresh(double& remain_time)
     // diff <= 0: 帧应该现在或过去显示（可以/应该立即显示）
     double diff = pts - avsync_->GetClock();
 
-    // 4. 如果帧还没到显示时间，计算需要等待的时间
-    if (diff > 0) {
-        // 限制最大等待时间为 REFRESH_RATE（10ms）
-        // 避免长时间阻塞事件处理
-        remain_time = (diff > REFRESH_RATE ? REFRESH_RATE : diff);
-        return;  // 不渲染，等待下一轮
+    // 4. 计算提交时刻（系统时间，媒体时间按倍速换算）：
+    //    - 默认：到期即提交
+    //    - 垂直同步且已锁定刷新相位：目标为离到期时刻最近的 vblank；SDL_RenderPresent 会阻塞到下一个 vblank，
+    //      所以在目标的前一个 vblank 之后提交，帧正好在目标 vblank 上屏（24fps@60Hz 为稳定的 2-3-2-3）
+    double now = av_gettime_relative() / 1000000.0;
+    double target = now + diff / avsync_->Speed();  // 按 pts 应显示的时刻
+    double release = target;
+    if (vsync_ && vsync_estimator_.Locked()) {
+        release = vsync_estimator_.NearestVblank(release)
+            - vsync_estimator_.Period() + VSYNC_RELEASE_MARGIN;
     }
+    if (release > now) {
+        remain_time = release - now;
+        return;  // 不渲染，睡到提交时刻（期间的输入事件会提前唤醒）
+    }
+
+    sync_metrics_.Record(diff);
 
     // 5. 计算渲染位置（Letterbox 缩放）
     SDL_Rect rect = CalcLetterBoxRect(video_width_, video_height_);
 
-    // 6. 更新 YUV 纹理
-    // 参数说明：
-    // - texture_: 目标纹理
-    // - NULL: 更新整个纹理（不是部分更新）
-    // - frame->data[0]: Y 平面数据
-    // - frame->linesize[0]: Y 平面行大小
-    // - frame->data[1]: U 平面数据
-    // - frame->linesize[1]: U 平面行大小
-    // - frame->data[2]: V 平面数据
-    // - frame->linesize[2]: V 平面行大小
-    SDL_UpdateYUVTexture(texture_, NULL,
-        frame->data[0], frame->linesize[0],
-        frame->data[1], frame->linesize[1],
-        frame->data[2], frame->linesize[2]);
-
-    // 7. 清屏（填充黑色背景，形成 Letterbox 的黑边）
+    // 6. 纹理格式 / 尺寸跟随帧（解码线程保证帧的格式在 display_formats_ 中）
+    Uint32 format = SdlTextureFormat(frame->format);
+    if (format != texture_format_ || frame->width != texture_width_ || frame->height != texture_height_) {
+        if (format == SDL_PIXELFORMAT_UNKNOWN || CreateTexture(format, frame->width, frame->height) < 0) {
+            // 无法显示的帧（如转换失败）：丢弃，继续下一帧；每种格式只提示一次，丢帧数见 video.frames_unsupported
+            if (frame->format != unsupported_format_) {
+                const char* name = av_get_pix_fmt_name((AVPixelFormat)frame->format);
+                printf("unsupported video frame format %s (%d), dropping frames\n",
+                    name ? name : "unknown", frame->format);
+                unsupported_format_ = frame->format;
+            }
+            frames_unsupported_->Add(1);
+            frame = frame_queue_->Pop(1);
+            frame_queue_->Recycle(frame);
+            remain_time = 0.0;
+            return;
+        }
+    }
+
+    // 7. 更新纹理：锁定纹理直接拷贝各个平面，4K 及以上分给线程池并行拷贝
+    {
+        TraceScope trace("texture upload");
+        if (!upload_pool_ && (int64_t)frame->width * frame->height >= UPLOAD_PARALLEL_PIXELS) {
+            int cores = (int)std::thread::hardware_concurrency();
+            upload_pool_ = new ThreadPool(std::max(1, std::min(UPLOAD_POOL_THREADS, cores - 1)));
+        }
+        int64_t t0 = av_gettime_relative();
+        UploadFrameTexture(texture_, frame, upload_pool_);
+        upload_time_->Record(av_gettime_relative() - t0);
+    }
+
+    // 8. 清屏（填充黑色背景，形成 Letterbox 的黑边）
     SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);  // 黑色，不透明
     SDL_RenderClear(renderer_);  // 清除渲染目标为当前绘制颜色
 
-    // 8. 渲染缩放后的图像
+    // 9. 渲染缩放后的图像
     // 参数说明：
     // - renderer_: 渲染器
     // - texture_: 源纹理
     // - NULL: 使用整个纹理
     // - &rect: 目标矩形（Letterbox 位置和大小）
-    SDL_RenderCopy(renderer_, texture_, NULL, &rect);
+    {
+        TraceScope trace("present");
+        SDL_RenderCopy(renderer_, texture_, NULL, &rect);
 
-    // 9. 显示到屏幕（双缓冲交换）
-    SDL_RenderPresent(renderer_);
+        // 指标叠加层画在视频之上
+        if (overlay_)
+            DrawOverlay();
 
-    // 10. 从队列弹出并释放已渲染的帧
+        // 10. 显示到屏幕（双缓冲交换；垂直同步时阻塞到 vblank）
+        SDL_RenderPresent(renderer_);
+    }
+    double present = av_gettime_relative() / 1000000.0;
+    OnPresented(present);
+    FramePacing::Instance().OnPresent(present, target, pts,
+        frame->duration * av_q2d(time_base_), avsync_->Speed());
+    StampPresent(frame);  // 记录该帧端到端延迟
+    if (SyncProbe::Instance().Enabled())
+        SyncProbe::Instance().OnVideoPresent(frame, avsync_->SourceNowSec());
+
+    // 11. 从队列弹出并释放已渲染的帧
     // 注意：这里先弹出再释放，确保帧不再使用
     frame = frame_queue_->Pop(1);  // 1ms 超时
     if (frame) {
-        av_frame_free(&frame);  // 释放帧资源
+        if (snapshot_) {
+            // 截图需要正在显示的帧：换下上一帧，引用转移到 shown_（不复制数据）
+            av_frame_unref(shown_);
+            av_frame_move_ref(shown_, frame);
+            snapshot_->OnPresent(shown_, time_base_);
+        }
+        frame_queue_->Recycle(frame);  // 归还帧（空壳回到队列的空闲链表）
     }
 
-    // 11. 设置下次刷新时间（立即刷新下一帧）
+    frames_presented_++;
+    cpu_time_us_ = CurrentThreadCpuTimeUs();
+
+    // 12. 设置下次刷新时间（立即刷新下一帧）
     remain_time = 0.0;
 };
 
+// ---------------------------------------------------------
+// 显示时刻：更新 vblank 估计，记录相邻两次显示的间隔
+// ---------------------------------------------------------
+void VideoOutput::OnPresented(double t)
+{
+    if (vsync_) {
+        vsync_estimator_.OnPresent(t);
+        if (vsync_estimator_.Locked())
+            vsync_period_->Set((int64_t)(vsync_estimator_.Period() * 1000000));
+    }
+
+    if (last_present_ > 0.0)
+        present_interval_->Record((int64_t)((t - last_present_) * 1000000));
+    last_present_ = t;
+};
+
 // ---------------------------------------------------------
 // 暂停控制
 // ---------------------------------------------------------
 void VideoOutput::Pause() { paused_ = true; };
-void VideoOutput::Resume() { paused_ = false; };
+void VideoOutput::Resume() { paused_ = false; Wake(); };
 bool  VideoOutput::isPaused() { return paused_; };
+
+// ---------------------------------------------------------
+// 指标叠加层：每行 色块 + 条形图 + 数值
+// （没有字体库，数值用 3x5 点阵绘制）
+// ---------------------------------------------------------
+
+// 0-9 与负号，每个字形 5 行 x 3 列，从最高位开始逐行排列
+static const uint16_t kDigitFont[11] = {
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF, 0x01C0
+};
+
+static void DrawNumber(SDL_Renderer* renderer, int x, int y, int64_t value)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%lld", (long long)value);
+
+    for (const char* p = text; *p; p++) {
+        int glyph = (*p == '-') ? 10 : (*p - '0');
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 3; col++) {
+                if (kDigitFont[glyph] & (1 << (14 - row * 3 - col))) {
+                    SDL_Rect px = { x + col * OVERLAY_PIXEL, y + row * OVERLAY_PIXEL,
+                        OVERLAY_PIXEL, OVERLAY_PIXEL };
+                    SDL_RenderFillRect(renderer, &px);
+                }
+            }
+        }
+        x += 4 * OVERLAY_PIXEL;
+    }
+};
+
+void VideoOutput::DrawOverlay()
+{
+    // 半透明背景
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 160);
+    SDL_Rect bg = { OVERLAY_X - 4, OVERLAY_Y - 4,
+        OVERLAY_BAR_W + 110, kOverlayRowCount * OVERLAY_ROW_H + 6 };
+    SDL_RenderFillRect(renderer_, &bg);
+
+    for (int i = 0; i < kOverlayRowCount; i++) {
+        const OverlayRow& row = kOverlayRows[i];
+        int y = OVERLAY_Y + i * OVERLAY_ROW_H;
+        int64_t value = overlay_counters_[i] ? overlay_counters_[i]->Get() : overlay_gauges_[i]->Get();
+
+        // 色块
+        SDL_SetRenderDrawColor(renderer_, row.r, row.g, row.b, 255);
+        SDL_Rect swatch = { OVERLAY_X, y, 10, 10 };
+        SDL_RenderFillRect(renderer_, &swatch);
+
+        // 条形图
+        int bar_x = OVERLAY_X + 16;
+        if (row.type == 0) {
+            int w = (int)(std::min<int64_t>(value, row.full) * OVERLAY_BAR_W / row.full);
+            SDL_Rect bar = { bar_x, y, w < 0 ? 0 : w, 10 };
+            SDL_RenderFillRect(renderer_, &bar);
+        }
+        else if (row.type == 1) {
+            int64_t v = std::max<int64_t>(-row.full, std::min<int64_t>(value, row.full));
+            int half = OVERLAY_BAR_W / 2;
+            int w = (int)(v * half / row.full);
+            SDL_Rect bar = { w < 0 ? bar_x + half + w : bar_x + half, y, w < 0 ? -w : w, 10 };
+            SDL_RenderFillRect(renderer_, &bar);
+            SDL_Rect center = { bar_x + half, y - 1, 1, 12 };
+            SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+            SDL_RenderFillRect(renderer_, &center);
+        }
+
+        // 数值（时长与偏差显示为毫秒）
+        SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+        DrawNumber(renderer_, bar_x + OVERLAY_BAR_W + 8, y, value / row.unit);
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+};
@@ -3,6 +3,11 @@
 
 #include "avframequeue.h"
 #include "avsync.h"
+#include "outputsink.h"
+#include "snapshot.h"
+#include "textureupload.h"
+#include "vsyncestimator.h"
+#include <atomic>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,10 +15,15 @@ extern "C" {
 }
 #endif
 
+/**
+ * @brief 计算视频在窗口内保持宽高比、居中显示的矩形（Letterbox）
+ */
+SDL_Rect CalcLetterBoxRect(int video_w, int video_h);
+
 /**
  * @brief 视频输出类：负责创建窗口、渲染帧、处理暂停状态和视频刷新逻辑。
  */
-class VideoOutput
+class VideoOutput : public VideoSink
 {
 public:
     /**
@@ -29,31 +39,80 @@ public:
 
     ~VideoOutput();
 
-    int Init();                        // 初始化 SDL、创建窗口/渲染器/纹理
-    void DeInit();                     // 释放 SDL 资源
+    int Init() override;               // 初始化 SDL、创建窗口/渲染器/纹理
+    void DeInit() override;            // 释放 SDL 资源
+
+    // 切换到新的视频流：保留窗口和渲染器，分辨率变化时才重建纹理
+    int Reconfigure(AVFrameQueue* frame_queue,
+        int video_width, int video_height, AVRational time_base) override;
+    void RequestQuit() override;       // 请求 MainLoop 退出（可在其他线程调用）
+
+    int MainLoop() override;           // 主事件循环（按 ESC / 关闭窗口退出）
+    void RefreshLoopWaitEvent(SDL_Event* event);   // 刷新循环：显示到期的帧，睡到下一帧到期 / 输入 / 唤醒事件
 
-    int MainLoop();                    // 主事件循环（按 ESC / 关闭窗口退出）
-    void RefreshLoopWaitEvent(SDL_Event* event);   // 刷新循环 + 等待事件
+    void Pause() override;             // 暂停播放（渲染循环在恢复前不再醒来）
+    void Resume() override;            // 恢复播放（可在其他线程调用）
+    bool isPaused() override;          // 是否暂停
 
-    void Pause();                      // 暂停播放
-    void Resume();                     // 恢复播放
-    bool isPaused();                   // 是否暂停
+    void SetOverlay(bool on) override { overlay_ = on; } // 显示 / 隐藏指标叠加层（窗口内按 I 键切换）
+    void SetOverlayListener(std::function<void(bool)> listener) override { overlay_listener_ = listener; }
+    void SetVsync(bool on) { vsync_ = on; }              // 垂直同步与按 vblank 排帧（Init 之前调用）
+    void SetSnapshotWriter(SnapshotWriter* writer) override; // 截图：保留正在显示的帧，请求到达时唤醒渲染循环
+    std::vector<AVPixelFormat> DisplayFormats() const override { return display_formats_; } // 渲染器原生支持的格式
+
+    int64_t FramesPresented() const override { return frames_presented_; } // 已显示帧数
+    int64_t CpuTimeUs() const override { return cpu_time_us_; }             // 渲染线程 CPU 时间
 
 private:
-    void videoRefresh(double& remain_time);  // 刷新一帧视频，执行同步与渲染逻辑
+    void videoRefresh(double& remain_time);  // 刷新一帧视频，执行同步与渲染逻辑；remain_time 返回距下一帧到期的秒数（负数表示等唤醒）
+    int WaitEventUntil(SDL_Event* event, double remain_time); // 等待事件或到期
+    void SetQueueListener(AVFrameQueue* frame_queue);        // 换队列并登记入队通知
+    void Wake();                             // 发送唤醒事件（任意线程）
+    void OnPresented(double t);              // 记录显示时刻（秒，系统时间）
+    int CreateTexture(Uint32 format, int width, int height); // 按格式和尺寸创建流式纹理
+    void DrawOverlay();                      // 在左上角绘制指标叠加层
 
 private:
     AVFrameQueue* frame_queue_ = nullptr;    // 视频帧队列
     SDL_Window* win_ = nullptr;              // 播放窗口
     SDL_Renderer* renderer_ = nullptr;       // SDL 渲染器
-    SDL_Texture* texture_ = nullptr;         // SDL YUV 纹理
+    SDL_Texture* texture_ = nullptr;         // SDL 流式纹理
+    Uint32 texture_format_ = 0;              // 当前纹理的 SDL 像素格式
+    std::vector<AVPixelFormat> display_formats_; // 渲染器原生支持的像素格式
 
     int video_width_ = 0;                    // 视频宽度
     int video_height_ = 0;                   // 视频高度
+    int texture_width_ = 0;                  // 当前纹理宽度
+    int texture_height_ = 0;                 // 当前纹理高度
     AVRational time_base_;                   // 时间基
     AVSync* avsync_ = nullptr;               // 音视频同步对象
 
-    bool paused_ = false;                    // 是否暂停播放
+    std::atomic<bool> paused_{ false };      // 是否暂停播放（控制台线程设置）
+    std::atomic<bool> frame_wanted_{ false };// 渲染循环因队列为空而等待，下一次入队需要唤醒
+    Uint32 wake_event_ = (Uint32)-1;         // SDL_RegisterEvents 注册的唤醒事件类型
+    std::atomic<bool> quit_{ false };        // 外部请求退出主循环
+    std::atomic<bool> overlay_{ false };     // 是否绘制指标叠加层
+    std::function<void(bool)> overlay_listener_; // 窗口内按 I 键切换叠加层后通知（渲染线程上调用）
+    std::vector<MetricCounter*> overlay_counters_; // 叠加层各行的指标（构造时查好，计数器行）
+    std::vector<MetricGauge*> overlay_gauges_;     // 仪表行
+
+    std::atomic<int64_t> frames_presented_{ 0 }; // 已显示帧数
+    std::atomic<int64_t> cpu_time_us_{ 0 };      // 渲染线程 CPU 时间（每次显示后采样）
+    VideoSyncMetrics sync_metrics_;              // 晚帧数与音视频偏差指标
+
+    ThreadPool* upload_pool_ = nullptr;          // 4K 及以上纹理上传的拷贝线程池（首次需要时创建）
+    LatencyHistogram* upload_time_ = nullptr;    // 每帧纹理上传耗时（video.upload_us）
+
+    bool vsync_ = false;                         // 垂直同步（创建渲染器时决定）
+    VsyncEstimator vsync_estimator_;             // 刷新周期与 vblank 相位估计
+    double last_present_ = 0.0;                  // 上一次显示的时刻（秒），0 表示没有
+    LatencyHistogram* present_interval_ = nullptr; // 相邻两次显示的间隔（video.present_interval_us）
+    MetricGauge* vsync_period_ = nullptr;          // 估计的刷新周期（video.vsync_period_us）
+    MetricCounter* frames_unsupported_ = nullptr;  // 无法显示而丢弃的帧数（video.frames_unsupported）
+    int unsupported_format_ = -1;                  // 上一次提示过的无法显示的格式（每种格式只提示一次）
+
+    SnapshotWriter* snapshot_ = nullptr;           // 截图（为空时不保留正在显示的帧）
+    AVFrame* shown_ = nullptr;                     // 正在显示的帧（截图取它的引用）
 };
 
 #endif // VIDEOOUTPUT_H
@@ -0,0 +1,65 @@
+﻿#include "vsyncestimator.h"
+#include <cmath>
+
+// 连续吻合多少次后认为锁定
+#define VSYNC_LOCK_SAMPLES 8
+// 显示时刻与预测 vblank 的偏差超过周期的该比例时重新开始
+#define VSYNC_MAX_ERROR 0.25
+// 每次用预测误差修正相位 / 周期的比例
+#define VSYNC_PHASE_GAIN 0.1
+#define VSYNC_PERIOD_GAIN 0.02
+// 两次显示相隔超过该周期数时只修正相位（间隔越长，周期误差越难分辨）
+#define VSYNC_MAX_GAP 8
+// 周期估计允许偏离名义周期的比例（防止跟踪到错误的倍数）
+#define VSYNC_PERIOD_TOLERANCE 0.05
+
+void VsyncEstimator::Reset(double period)
+{
+    nominal_ = period > 0.0 ? period : 1.0 / 60;
+    period_ = nominal_;
+    last_vblank_ = 0.0;
+    has_last_ = false;
+    matched_ = 0;
+};
+
+void VsyncEstimator::OnPresent(double t)
+{
+    if (!has_last_) {
+        last_vblank_ = t;
+        has_last_ = true;
+        return;
+    }
+
+    // 1. 距上一次 vblank 隔了几个周期，实际时刻与预测差多少
+    double n = std::round((t - last_vblank_) / period_);
+    double predicted = last_vblank_ + n * period_;
+    double err = t - predicted;
+    if (n < 1.0 || std::fabs(err) > period_ * VSYNC_MAX_ERROR) {
+        // 同一周期内显示了两次（没有同步），或者偏差过大：从这次重新开始
+        last_vblank_ = t;
+        matched_ = 0;
+        return;
+    }
+
+    // 2. 修正：周期按每个间隔平均分摊误差，相位向实际时刻靠近一部分
+    if (n <= VSYNC_MAX_GAP) {
+        period_ += VSYNC_PERIOD_GAIN * err / n;
+        double low = nominal_ * (1.0 - VSYNC_PERIOD_TOLERANCE);
+        double high = nominal_ * (1.0 + VSYNC_PERIOD_TOLERANCE);
+        period_ = period_ < low ? low : (period_ > high ? high : period_);
+    }
+    last_vblank_ = predicted + VSYNC_PHASE_GAIN * err;
+
+    if (matched_ < VSYNC_LOCK_SAMPLES)
+        matched_++;
+};
+
+bool VsyncEstimator::Locked() const
+{
+    return matched_ >= VSYNC_LOCK_SAMPLES;
+};
+
+double VsyncEstimator::NearestVblank(double t) const
+{
+    return last_vblank_ + std::round((t - last_vblank_) / period_) * period_;
+};
@@ -0,0 +1,43 @@
+﻿#ifndef VSYNCESTIMATOR_H
+#define VSYNCESTIMATOR_H
+
+/**
+ * @brief 根据 SDL_RenderPresent 返回的时刻估计显示器的刷新周期和 vblank 相位
+ *
+ * 开启垂直同步时，SDL_RenderPresent 阻塞到下一个 vblank 才返回，返回时刻就是（略晚于）vblank 时刻。
+ * 每次显示后调用 OnPresent：时刻落在预测的 vblank 附近时，用预测误差的一部分修正相位和周期；
+ * 偏差过大（没有真正同步、丢了 vblank、长时间暂停）时以该时刻重新开始，连续吻合若干次后才算锁定。
+ *
+ * 所有时间单位为秒，只在渲染线程使用。
+ */
+class VsyncEstimator
+{
+public:
+    /**
+     * @brief 重新开始估计
+     * @param period 名义刷新周期（来自显示模式的刷新率），无效时按 60Hz
+     */
+    void Reset(double period);
+
+    /**
+     * @brief 记录一次 SDL_RenderPresent 返回的时刻
+     */
+    void OnPresent(double t);
+
+    bool Locked() const;                        // 相位和周期是否可信
+    double Period() const { return period_; }  // 当前估计的刷新周期
+
+    /**
+     * @brief 离 t 最近的 vblank 时刻（按当前相位和周期外推）
+     */
+    double NearestVblank(double t) const;
+
+private:
+    double nominal_ = 1.0 / 60;     // 名义周期
+    double period_ = 1.0 / 60;      // 估计的周期
+    double last_vblank_ = 0.0;      // 最近一次 vblank 的估计时刻
+    bool has_last_ = false;
+    int matched_ = 0;               // 连续落在预测 vblank 附近的次数
+};
+
+#endif // VSYNCESTIMATOR_H